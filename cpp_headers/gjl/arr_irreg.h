@@ -5,18 +5,27 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <limits>
 //#include <math>
 #include <gjl/log_space.h>
+#include <gjl/time_grid.h>
 
 /*
  * class ArrIrreg -- "irregular" array. We record values in an array
- * at times that are separated by a constant factor. It could be
- * generalized to times separated by arbitrary values, which would
- * actually be irregular. The virtual array of times is managed by
- * class LogSpace. Some process generates times and values. We insert
- * a time and value into the irregular array if the process time exceeds
- * the next time in the virtual array.
+ * at times that are separated by a constant factor. The virtual array
+ * of times is managed by class LogSpace. Some process generates times
+ * and values. We insert a time and value into the irregular array if
+ * the process time exceeds the next time in the virtual array.
  *
+ * For times separated by arbitrary values, which are actually
+ * irregular, use gjl::TimeGrid as grid_t, and pass the grid to the
+ * constructor or set_grid(). Recording, merge and printing are the same.
+ *
+ * With keep_sum_squares(), the sum of squares of the values is kept too,
+ * giving the variance, standard error and a fit weight at each time.
+ * It is off by default, and then record_arr and merge cost what they
+ * did before. The variance is computed from the sums, (S2 - S*S/n)/(n-1),
+ * which loses precision when the spread is far smaller than the mean.
  */
 
 /*
@@ -27,33 +36,41 @@
  *  This macro evaluates current_time once. getval is evaluated each
  *  time the value is referenced.  But, in the current application, it
  *  has a constant value.
+ *
+ *  next_threshold() is a cached double, infinite once the array is
+ *  full, so on most steps this is one compare.
  */
 // + 1e-6 is important. I spent hours looking for the bug.
 #define ARR_IRREG_CHECK_RECORD(arr,current_time,getval)                      \
-  if (! (arr).over_max_ind()) {                                              \
+  {                                                                          \
     auto curtime = (current_time) + 1e-10;                                   \
-    while (curtime  >= (arr).get_next_time() && (! (arr).over_max_ind() ) )  \
+    while (curtime  >= (arr).next_threshold() && (! (arr).over_max_ind() ) ) \
       {                                                                      \
         (arr).record_arr((getval));                                          \
       }                                                                      \
   }
 
-template< typename data_t = double>
+template< typename data_t = double, typename grid_t = gjl::LogSpace<data_t> >
 class ArrIrreg {
 public:
+  typedef grid_t time_grid_t;
   ArrIrreg() {}
   ArrIrreg(data_t xa, data_t xb, size_t n) { set_xa_xb_n(xa,xb,n); }
+  explicit ArrIrreg(const grid_t& grid) { set_grid(grid); }
   inline void set_xa_xb_n(data_t xa, data_t xb, size_t n) { time_.set_xa_xb_n(xa,xb,n); init_arr();}
+  inline void set_grid(const grid_t& grid) { time_ = grid; init_arr();}
   inline void init_arr() {
     arr_.clear(); counts_.clear();
     arr_.resize(number_of_elements());
     counts_.resize(number_of_elements());
+    arr2_.assign(keep_sum_squares_ ? number_of_elements() : 0, 0);
     index_ = 0;
     highest_index_with_full_count_ = -1;
+    set_next_time_();
   }
   // only lowest_index = 0 is supported now.
   inline void set_lowest_index(int i) { time_.set_lowest_index_fixed_n(i);}
-  inline int lowest_index() const { return time_.lowest_index_fixed();}
+  inline int lowest_index() const { return time_.lowest_index();}
   inline int ind(int i) const { return i - time_.lowest_index();}
 
   inline int highest_index() const { return time_.highest_index(); }
@@ -61,16 +78,55 @@ public:
   inline data_t get_time(int i) const {return time_[i];}
   inline data_t get_arr(int i) {auto c = counts(i); if (c>0) return arrsum(i) / c; return 0;}
   inline void arr_sum_add_to(int i, data_t arrval) { arrsum(i) += arrval;}
-  inline void reset_index() { index_ = time_.lowest_index();}
+  inline void reset_index() { index_ = time_.lowest_index(); set_next_time_();}
 
   inline data_t& arrsum(int i) { return arr_[ind(i)];}
   inline size_t& counts(int i) { return counts_[ind(i)];}
+  // The arrays of sums and counts, starting at lowest_index()
+  inline data_t * arrsum_data() { return arr_.data();}
+  inline const data_t * arrsum_data() const { return arr_.data();}
+  inline size_t * counts_data() { return counts_.data();}
+  inline const size_t * counts_data() const { return counts_.data();}
+  inline const grid_t& time() const { return time_;}
+
+  // Keep sums of squares. This clears them, so call it before recording.
+  inline void keep_sum_squares(bool on = true) {
+    keep_sum_squares_ = on;
+    arr2_.assign(on ? arr_.size() : 0, 0);
+  }
+  inline bool has_sum_squares() const { return keep_sum_squares_;}
+  inline data_t& arrsum2(int i) { return arr2_[ind(i)];}
+  inline data_t * arrsum2_data() { return arr2_.data();}
+  inline const data_t * arrsum2_data() const { return arr2_.data();}
+  // Sample variance of the values recorded at time i. 0 with fewer than two,
+  // or without sums of squares.
+  inline data_t get_variance(int i) const {
+    const size_t c = counts_[ind(i)];
+    if (c < 2 || ! keep_sum_squares_) return 0;
+    const data_t s = arr_[ind(i)];
+    const data_t v = (arr2_[ind(i)] - s * s / c) / (c - 1);
+    return v > 0 ? v : 0;
+  }
+  // Standard error of the mean at time i
+  inline data_t get_stderr(int i) const {
+    const size_t c = counts_[ind(i)];
+    return c > 0 ? std::sqrt(get_variance(i) / c) : 0;
+  }
+  // 1 / stderr^2, the weight of the mean at time i in a fit. 0 if there is no error estimate.
+  inline data_t get_weight(int i) const {
+    const data_t e = get_stderr(i);
+    return e > 0 ? 1 / (e * e) : 0;
+  }
 
   inline data_t get_next_time() const {return time_[index_];}
+  // get_next_time(), or infinity once over_max_ind()
+  inline data_t next_threshold() const {return next_time_;}
 
   inline void record_arr(data_t val) {
+    if (keep_sum_squares_) arr2_[index_] += val * val;
     ++counts_[index_];
     arr_sum_add_to(index_++, val);
+    set_next_time_();
   }
 
   inline int number_of_elements() const {return time_.number_of_elements();}
@@ -80,11 +136,24 @@ public:
     return false;
   }
 
-  inline void merge(ArrIrreg<data_t>& other) {
-    for(int i=0; i< (int) arr_.size(); ++i) {
-      arr_sum_add_to(i,other.arrsum(i));
-      counts_[i] += other.counts(i);
+  inline void merge(const ArrIrreg<data_t,grid_t>& other) {
+    data_t *sums = arr_.data();
+    size_t *counts = counts_.data();
+    const data_t *osums = other.arrsum_data();
+    const size_t *ocounts = other.counts_data();
+    const size_t n = arr_.size();
+    for(size_t i=0; i < n; ++i) {
+      sums[i] += osums[i];
+      counts[i] += ocounts[i];
     }
+    if (! keep_sum_squares_) return;
+    if (! other.has_sum_squares()) {
+      std::cerr << "*** arr_irreg: cannot merge an array without sums of squares into one with them.\n";
+      abort();
+    }
+    data_t *sq = arr2_.data();
+    const data_t *osq = other.arrsum2_data();
+    for(size_t i=0; i < n; ++i) sq[i] += osq[i];
   }
 
   inline void print_arr(std::ostream& out = std::cout) {
@@ -106,6 +175,12 @@ public:
       out << time_[i] << " " << get_arr(i) << " " << counts(i) << "\n";
   }
 
+  // time, mean, standard error and count. Needs keep_sum_squares().
+  inline void print_arr_with_errors(std::ostream& out = std::cout) {
+    for(int i=0; i < (int) arr_.size(); ++i)
+      out << time_[i] << " " << get_arr(i) << " " << get_stderr(i) << " " << counts(i) << "\n";
+  }
+
   inline void print_log_arr_with_counts(std::ostream& out = std::cout) {
     for(int i=0; i < (int) arr_.size(); ++i) {
       auto t = time_[i];
@@ -143,9 +218,18 @@ public:
 private:
   std::vector<data_t> arr_;
   std::vector<size_t> counts_;
-  gjl::LogSpace<data_t> time_;
+  std::vector<data_t> arr2_;  // sums of squares, empty unless keep_sum_squares_
+  bool keep_sum_squares_ = false;
+  grid_t time_;
   int index_ = 0;
   int highest_index_with_full_count_ = -1;
+  data_t next_time_ = 0;
+
+  inline void set_next_time_() {
+    next_time_ = over_max_ind() ? (std::numeric_limits<data_t>::has_infinity ?
+                                   std::numeric_limits<data_t>::infinity() : std::numeric_limits<data_t>::max())
+      : time_[index_];
+  }
 };  /*** END class ArrIrreg  */
 
 #endif
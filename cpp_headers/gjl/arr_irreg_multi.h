@@ -0,0 +1,140 @@
+// -*-c++-*-
+#ifndef ARR_IRREG_MULTI_H
+#define ARR_IRREG_MULTI_H
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <limits>
+#include <gjl/log_space.h>
+#include <gjl/arr_irreg.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+ * class ArrIrregMulti -- K observables recorded on one ArrIrreg time grid.
+ *
+ * ArrIrregMulti<3> arr(1, 1e6, 300);
+ * std::array<double,3> v = {{ x * x, x, transits }};
+ * ARR_IRREG_CHECK_RECORD(arr, t, v);    // one check for all three
+ * arr.print_arr(out);                   // time, then the K means
+ * arr.column(0, a);                     // observable 0 as an ArrIrreg
+ *
+ * There is one LogSpace, one cursor and one count per time, shared by
+ * the observables, since they are always recorded together. The K sums
+ * of a time are contiguous, so record_arr is a K wide add that the
+ * compiler vectorizes, and the K columns of a row share a cache line.
+ * merge is a single loop over all sums and one over the counts.
+ */
+
+template <size_t K, typename data_t = double>
+class ArrIrregMulti {
+public:
+  typedef std::array<data_t,K> row_t;
+
+  ArrIrregMulti() {}
+  ArrIrregMulti(data_t xa, data_t xb, size_t n) { set_xa_xb_n(xa,xb,n); }
+  inline void set_xa_xb_n(data_t xa, data_t xb, size_t n) { time_.set_xa_xb_n(xa,xb,n); init_arr();}
+  inline void init_arr() {
+    sums_.assign(K * number_of_elements(), 0);
+    counts_.assign(number_of_elements(), 0);
+    index_ = 0;
+    set_next_time_();
+  }
+  inline void clear() { init_arr(); }
+
+  static constexpr size_t number_of_observables() { return K; }
+  inline int number_of_elements() const {return time_.number_of_elements();}
+  inline const gjl::LogSpace<data_t>& time() const { return time_;}
+  inline data_t get_time(int i) const {return time_[i];}
+  inline data_t& arrsum(int i, size_t k) { return sums_[K * i + k];}
+  inline data_t arrsum(int i, size_t k) const { return sums_[K * i + k];}
+  inline size_t& counts(int i) { return counts_[i];}
+  inline size_t counts(int i) const { return counts_[i];}
+  inline data_t get_arr(int i, size_t k) const { return counts_[i] > 0 ? arrsum(i,k) / counts_[i] : 0;}
+  // The K sums of time i
+  inline const data_t * row_data(int i) const { return sums_.data() + K * i;}
+
+  // The record interface, as in ArrIrreg. The K values are recorded together.
+  inline void reset_index() { index_ = 0; set_next_time_();}
+  inline data_t get_next_time() const {return time_[index_];}
+  inline data_t next_threshold() const {return next_time_;}
+  inline bool over_max_ind() const { return index_ >= number_of_elements(); }
+  inline void record_arr(const data_t *vals) {
+    data_t *s = sums_.data() + K * index_;
+    for(size_t k=0; k < K; ++k) s[k] += vals[k];
+    ++counts_[index_++];
+    set_next_time_();
+  }
+  inline void record_arr(const row_t& vals) { record_arr(vals.data()); }
+
+  inline bool is_same_shape(const ArrIrregMulti<K,data_t>& other) const {
+    return number_of_elements() == other.number_of_elements() && time_.xa() == other.time_.xa()
+      && time_.xb() == other.time_.xb();
+  }
+  inline void merge(const ArrIrregMulti<K,data_t>& other);
+
+  // Copy observable k into an ArrIrreg, for print_log_arr, result_file, ...
+  inline void column(size_t k, ArrIrreg<data_t>& arr) const;
+
+  inline void print_arr(std::ostream& out = std::cout) const { print_arr_(out, false); }
+  inline void print_arr_with_counts(std::ostream& out = std::cout) const { print_arr_(out, true); }
+
+private:
+  std::vector<data_t> sums_;  // K per time, time major
+  std::vector<size_t> counts_;
+  gjl::LogSpace<data_t> time_;
+  int index_ = 0;
+  data_t next_time_ = 0;
+
+  inline void set_next_time_() {
+    next_time_ = over_max_ind() ? (std::numeric_limits<data_t>::has_infinity ?
+                                   std::numeric_limits<data_t>::infinity() : std::numeric_limits<data_t>::max())
+      : time_[index_];
+  }
+  inline void print_arr_(std::ostream& out, bool with_counts) const;
+}; /*** END class ArrIrregMulti */
+
+template <size_t K, typename data_t>
+inline void ArrIrregMulti<K,data_t>::merge(const ArrIrregMulti<K,data_t>& other) {
+  if (! is_same_shape(other)) {
+    std::cerr << "*** arr_irreg_multi: cannot merge arrays of different shapes.\n";
+    abort();
+  }
+  data_t *a = sums_.data();
+  const data_t *b = other.sums_.data();
+  const size_t n = sums_.size();
+  for(size_t i=0; i < n; ++i) a[i] += b[i];
+  size_t *c = counts_.data();
+  const size_t *d = other.counts_.data();
+  for(size_t i=0; i < counts_.size(); ++i) c[i] += d[i];
+}
+
+template <size_t K, typename data_t>
+inline void ArrIrregMulti<K,data_t>::column(size_t k, ArrIrreg<data_t>& arr) const {
+  arr.set_xa_xb_n(time_.xa(), time_.xb(), number_of_elements());
+  data_t *sums = arr.arrsum_data();
+  size_t *counts = arr.counts_data();
+  for(int i=0; i < number_of_elements(); ++i) {
+    sums[i] = arrsum(i,k);
+    counts[i] = counts_[i];
+  }
+}
+
+template <size_t K, typename data_t>
+inline void ArrIrregMulti<K,data_t>::print_arr_(std::ostream& out, bool with_counts) const {
+  for(int i=0; i < number_of_elements(); ++i) {
+    out << time_[i];
+    for(size_t k=0; k < K; ++k) out << " " << get_arr(i,k);
+    if (with_counts) out << " " << counts_[i];
+    out << "\n";
+  }
+}
+
+#endif
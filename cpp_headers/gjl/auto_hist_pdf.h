@@ -0,0 +1,309 @@
+// -*-c++-*-
+#ifndef AUTO_HIST_PDF_H
+#define AUTO_HIST_PDF_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <gjl/hist_pdf.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+  class gjl::AutoHistPdf -- a histogram that finds its own range in one
+  pass. It has a fixed number of bins and stores no samples.
+
+  gjl::AutoHistPdf<> h(1000, 1e-6);  // 1000 bins, no narrower than 1e-6
+  for(...) h.add_count(x);
+  h.to_hist_pdf().print_pdf(out);
+
+  The bins lie on a grid anchored at zero: at level L, bin g is
+  [g w, (g+1) w) with w = finest_width * 2^L. With log spacing the grid is
+  in log10(x), and finest_width is in decades. The bins in use are a
+  window of n_bins consecutive grid bins. When a sample falls outside the
+  window, the window slides if the data still fits, and otherwise the
+  level goes up and pairs of bins are merged, until it fits. So the bins
+  are as narrow as they can be and still hold all the data.
+
+  Each sample's bin on the finest grid is computed once, and coarser bins
+  are found by shifting that integer, so a sample always lands in the
+  same bin at a given level. The final level is the smallest that holds
+  all the data. Thus the result does not depend on the order of the
+  samples, and merge() gives the same histogram as filling one
+  AutoHistPdf with all the samples.
+
+  NaN and infinite samples, and x <= 0 with log spacing, are not binned
+  and are counted in n_skipped(). |x| / finest_width must be less than
+  about 1e18.
+*/
+
+namespace gjl {
+
+template <typename cnt_t = double, typename bin_t = double>
+class AutoHistPdf {
+public:
+  AutoHistPdf() {}
+  AutoHistPdf(size_t n_bins, bin_t finest_width, bool uselog = false) { init(n_bins, finest_width, uselog); }
+  inline void init(size_t n_bins, bin_t finest_width, bool uselog = false);
+  inline void clear();
+
+  inline void add_count(bin_t x);
+  template <typename Iter>
+  inline void add_counts(Iter first, Iter last);
+  inline void merge(const AutoHistPdf<cnt_t,bin_t> & other);
+  inline void operator+=(const AutoHistPdf<cnt_t,bin_t> & other) { merge(other); }
+
+  inline size_t n_bins() const { return n_bins_; }
+  inline size_t n_counts() const { return n_counts_; }
+  inline size_t n_skipped() const { return n_skipped_; }
+  inline bool using_log() const { return using_log_; }
+  inline bin_t finest_width() const { return finest_width_; }
+  inline int level() const { return level_; }
+  // Width of the bins now, in the binning coordinate
+  inline bin_t width() const { return std::ldexp(finest_width_, level_); }
+
+  // Range of the bins that hold data
+  inline bin_t min() const { return maybe_exp(lo_bin_() * width()); }
+  inline bin_t max() const { return maybe_exp((hi_bin_() + 1) * width()); }
+  inline bin_t data_min() const { return maybe_exp(data_min_); }
+  inline bin_t data_max() const { return maybe_exp(data_max_); }
+
+  /*
+    A HistPdf with the bins that hold data, from min() to max(). Data min
+    and max and n_counts carry over. Skipped samples are not included.
+  */
+  inline void to_hist_pdf(HistPdf<cnt_t,bin_t> & h) const;
+  inline HistPdf<cnt_t,bin_t> to_hist_pdf() const { HistPdf<cnt_t,bin_t> h; to_hist_pdf(h); return h; }
+  inline void print_pdf(std::ostream& out = std::cout) const { to_hist_pdf().print_pdf(out); }
+
+private:
+  static const size_t block_size = 256;
+
+  size_t n_bins_ = 0;
+  bin_t finest_width_ = 1;
+  bin_t inv_finest_width_ = 1;
+  bool using_log_ = false;
+  int level_ = 0;
+  int64_t offset_ = 0; // grid index of counts_[0] at level_
+  std::vector<cnt_t> counts_;
+  size_t n_counts_ = 0;
+  size_t n_skipped_ = 0;
+  bin_t data_min_ = 0; // binning coordinate
+  bin_t data_max_ = 0;
+  int64_t fine_min_ = 0; // finest grid index of data_min_
+  int64_t fine_max_ = 0;
+
+  inline bin_t maybe_log(bin_t x) const { return using_log_ ? hist_pdf::histlog(x) : x; }
+  inline bin_t maybe_exp(bin_t x) const { return using_log_ ? hist_pdf::histexp(x) : x; }
+
+  // Index on the finest grid of y in the binning coordinate.
+  inline int64_t fine_index_(bin_t y) const {
+    double r = std::floor(y * inv_finest_width_);
+    r = r > -4e18 ? r : -4e18;
+    r = r < 4e18 ? r : 4e18;
+    return (int64_t) r;
+  }
+  inline bool can_bin_(bin_t y) const { return std::isfinite(y); }
+  inline int64_t lo_bin_() const { return fine_min_ >> level_; }
+  inline int64_t hi_bin_() const { return fine_max_ >> level_; }
+
+  inline void make_room_(int64_t fine_lo, int64_t fine_hi);
+  inline void coarsen_();
+  inline void slide_(int64_t new_offset);
+  inline void add_tally_(size_t n, bin_t dmin, bin_t dmax, int64_t fmin, int64_t fmax);
+}; /*** END class AutoHistPdf */
+
+template <typename cnt_t, typename bin_t>
+inline void AutoHistPdf<cnt_t,bin_t>::init(size_t n_bins, bin_t finest_width, bool uselog) {
+  if (n_bins < 2 || ! (finest_width > 0)) {
+    std::cerr << "*** auto_hist_pdf: need at least two bins and a positive width.\n";
+    abort();
+  }
+  n_bins_ = n_bins;
+  finest_width_ = finest_width;
+  inv_finest_width_ = 1 / finest_width;
+  using_log_ = uselog;
+  counts_.assign(n_bins_, 0);
+  clear();
+}
+
+template <typename cnt_t, typename bin_t>
+inline void AutoHistPdf<cnt_t,bin_t>::clear() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  level_ = 0;
+  offset_ = 0;
+  n_counts_ = 0;
+  n_skipped_ = 0;
+}
+
+// Merge pairs of bins: level up by one
+template <typename cnt_t, typename bin_t>
+inline void AutoHistPdf<cnt_t,bin_t>::coarsen_() {
+  const int64_t new_offset = offset_ >> 1;
+  // Bin i goes to j <= i, so this can be done in place, going up.
+  for(size_t i=0; i < n_bins_; ++i) {
+    const cnt_t c = counts_[i];
+    counts_[i] = 0;
+    counts_[((offset_ + (int64_t) i) >> 1) - new_offset] += c;
+  }
+  offset_ = new_offset;
+  ++level_;
+}
+
+template <typename cnt_t, typename bin_t>
+inline void AutoHistPdf<cnt_t,bin_t>::slide_(int64_t new_offset) {
+  const int64_t d = new_offset - offset_;
+  const int64_t n = n_bins_;
+  if (d > 0) {
+    for(int64_t i=0; i < n; ++i) counts_[i] = i + d < n ? counts_[i + d] : 0;
+  }
+  else if (d < 0) {
+    for(int64_t i=n-1; i >= 0; --i) counts_[i] = i + d >= 0 ? counts_[i + d] : 0;
+  }
+  offset_ = new_offset;
+}
+
+/*
+  Make the window hold the finest grid indices fine_lo to fine_hi, as
+  well as the data so far.
+*/
+template <typename cnt_t, typename bin_t>
+inline void AutoHistPdf<cnt_t,bin_t>::make_room_(int64_t fine_lo, int64_t fine_hi) {
+  const int64_t n = n_bins_;
+  if (n_counts_ > 0) {
+    fine_lo = std::min(fine_lo, fine_min_);
+    fine_hi = std::max(fine_hi, fine_max_);
+  }
+  while ((fine_hi >> level_) - (fine_lo >> level_) + 1 > n) coarsen_();
+  const int64_t lo = fine_lo >> level_;
+  const int64_t hi = fine_hi >> level_;
+  if (n_counts_ == 0) offset_ = lo - (n - (hi - lo + 1)) / 2; // center
+  else if (lo < offset_) slide_(hi - n + 1);                  // leave room below
+  else if (hi >= offset_ + n) slide_(lo);                     // leave room above
+}
+
+template <typename cnt_t, typename bin_t>
+inline void AutoHistPdf<cnt_t,bin_t>::add_tally_(size_t n, bin_t dmin, bin_t dmax,
+                                                  int64_t fmin, int64_t fmax) {
+  if (n == 0) return;
+  if (n_counts_ == 0) {
+    data_min_ = dmin;
+    data_max_ = dmax;
+    fine_min_ = fmin;
+    fine_max_ = fmax;
+  }
+  else {
+    if (dmin < data_min_) data_min_ = dmin;
+    if (dmax > data_max_) data_max_ = dmax;
+    if (fmin < fine_min_) fine_min_ = fmin;
+    if (fmax > fine_max_) fine_max_ = fmax;
+  }
+  n_counts_ += n;
+}
+
+template <typename cnt_t, typename bin_t>
+inline void AutoHistPdf<cnt_t,bin_t>::add_count(bin_t x) {
+  const bin_t y = maybe_log(x);
+  if (! can_bin_(y)) {
+    ++n_skipped_;
+    return;
+  }
+  const int64_t g = fine_index_(y);
+  const int64_t n = n_bins_;
+  if (n_counts_ == 0 || (g >> level_) < offset_ || (g >> level_) >= offset_ + n)
+    make_room_(g, g);
+  ++counts_[(g >> level_) - offset_];
+  add_tally_(1, y, y, g, g);
+}
+
+/*
+  Add all samples in [first,last), in blocks. The window is adjusted
+  once per block, for the range of the block.
+*/
+template <typename cnt_t, typename bin_t>
+template <typename Iter>
+inline void AutoHistPdf<cnt_t,bin_t>::add_counts(Iter first, Iter last) {
+  bin_t ys[block_size];
+  int64_t gs[block_size];
+  while (first != last) {
+    size_t n = 0;
+    size_t nskip = 0;
+    for(; n < block_size && first != last; ++first) {
+      const bin_t y = maybe_log(*first);
+      if (! can_bin_(y)) {
+        ++nskip;
+        continue;
+      }
+      ys[n] = y;
+      gs[n++] = fine_index_(y);
+    }
+    n_skipped_ += nskip;
+    if (n == 0) continue;
+    bin_t dmin = ys[0], dmax = ys[0];
+    int64_t gmin = gs[0], gmax = gs[0];
+    for(size_t i=1; i < n; ++i) {
+      dmin = ys[i] < dmin ? ys[i] : dmin;
+      dmax = ys[i] > dmax ? ys[i] : dmax;
+      gmin = gs[i] < gmin ? gs[i] : gmin;
+      gmax = gs[i] > gmax ? gs[i] : gmax;
+    }
+    const int64_t nb = n_bins_;
+    if (n_counts_ == 0 || (gmin >> level_) < offset_ || (gmax >> level_) >= offset_ + nb)
+      make_room_(gmin, gmax);
+    for(size_t i=0; i < n; ++i)
+      ++counts_[(gs[i] >> level_) - offset_];
+    add_tally_(n, dmin, dmax, gmin, gmax);
+  }
+}
+
+template <typename cnt_t, typename bin_t>
+inline void AutoHistPdf<cnt_t,bin_t>::merge(const AutoHistPdf<cnt_t,bin_t> & other) {
+  if (n_bins_ != other.n_bins_ || finest_width_ != other.finest_width_
+      || using_log_ != other.using_log_) {
+    std::cerr << "*** auto_hist_pdf: cannot merge histograms of different shapes.\n";
+    abort();
+  }
+  n_skipped_ += other.n_skipped_;
+  if (other.n_counts_ == 0) return;
+  while (level_ < other.level_) coarsen_();
+  make_room_(other.fine_min_, other.fine_max_);
+  const int shift = level_ - other.level_;
+  for(size_t i=0; i < n_bins_; ++i)
+    if (other.counts_[i] != 0)
+      counts_[((other.offset_ + (int64_t) i) >> shift) - offset_] += other.counts_[i];
+  add_tally_(other.n_counts_, other.data_min_, other.data_max_, other.fine_min_, other.fine_max_);
+}
+
+template <typename cnt_t, typename bin_t>
+inline void AutoHistPdf<cnt_t,bin_t>::to_hist_pdf(HistPdf<cnt_t,bin_t> & h) const {
+  if (n_counts_ == 0) {
+    h.init(n_bins_, maybe_exp(0), maybe_exp(n_bins_ * finest_width_));
+    h.use_log(using_log_);
+    h.clear();
+    return;
+  }
+  const int64_t lo = lo_bin_();
+  const int64_t hi = hi_bin_();
+  h.init(hi - lo + 1, min(), max());
+  h.use_log(using_log_);
+  h.clear();
+  for(int64_t g = lo; g <= hi; ++g)
+    h.add_to_counts(g - lo, counts_[g - offset_]);
+  hist_pdf::Tally<bin_t> t;
+  t.n_counts = n_counts_;
+  t.data_min = data_min_;
+  t.data_max = data_max_;
+  h.merge_tally(t);
+}
+
+} /*** END namespace gjl */
+
+#endif
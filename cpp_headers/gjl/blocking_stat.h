@@ -0,0 +1,184 @@
+// -*-c++-*-
+#ifndef BLOCKING_STAT_H
+#define BLOCKING_STAT_H
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <gjl/simp_stat.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+ * class gjl::BlockingStat
+ * Error of the mean of a correlated series, such as the observables of a
+ * Markov chain, by the blocking method of Flyvbjerg and Petersen.
+ *
+ * gjl::BlockingStat<> b;
+ * b.record(x);          // for each step, in order
+ * b.mean(); b.error(); b.tau_int();
+ *
+ * Level 0 holds the statistics of the samples. Level h + 1 holds those of
+ * the means of neighboring pairs at level h, so blocks of 2^(h+1) samples.
+ * Only a SimpStat and one unpaired value per level are kept, so memory is
+ * O(log N) and the series need not be stored.
+ *
+ * level_error(h), the naive error of the mean of the level h blocks,
+ * grows with h until the blocks are longer than the correlation time,
+ * and then stays flat. error() is level_error at the start of the
+ * plateau, see plateau_level(). tau_int() is the integrated
+ * autocorrelation time, (error() / level_error(0))^2 / 2, which is 1/2
+ * for independent samples.
+ *
+ * record(first,last) gives the same blocks as recording one at a time,
+ * and fills each level with SimpStat's batched record.
+ *
+ * merge() adds the statistics at each level. Blocks never straddle the
+ * two series, so merge independent chains, say one per thread; an
+ * unpaired value from each is paired across them.
+ */
+
+namespace gjl {
+
+template <typename data_t = double >
+class BlockingStat {
+
+public:
+  inline void record (data_t x) { push_(0, x); }
+
+  template <typename Iter>
+  inline void record (Iter first, Iter last);
+
+  inline void merge (const BlockingStat<data_t>& other);
+  inline void operator+= (const BlockingStat<data_t>& other) { merge(other); }
+
+  inline void clear () { levels_.clear(); pending_.clear(); has_pending_.clear(); }
+
+  inline double mean () const { return levels_.empty() ? 0 : levels_[0].mean(); }
+  inline double N () const { return levels_.empty() ? 0 : levels_[0].N(); }
+
+  inline size_t n_levels () const { return levels_.size(); }
+  inline const SimpStat<data_t>& level (size_t h) const { return levels_[h]; }
+  inline double level_n_blocks (size_t h) const { return levels_[h].N(); }
+  // Error of the mean, taking the blocks at level h to be independent
+  inline double level_error (size_t h) const {
+    return sqrt(levels_[h].variance() / (levels_[h].N() - 1));
+  }
+  // Error of level_error(h)
+  inline double level_error_error (size_t h) const {
+    return level_error(h) / sqrt(2 * (levels_[h].N() - 1));
+  }
+
+  inline void min_blocks (size_t n) { min_blocks_ = n; }
+  inline size_t min_blocks () const { return min_blocks_; }
+  inline size_t plateau_level () const;
+  inline double error () const { return levels_.empty() ? 0 : level_error(plateau_level()); }
+  inline double tau_int () const {
+    const double r = error() / level_error(0);
+    return r * r / 2;
+  }
+
+  // One line per level: level, number of blocks, error, error of the error
+  inline void print_levels (std::ostream& out = std::cout) const;
+
+private:
+  std::vector<SimpStat<data_t> > levels_;
+  std::vector<data_t> pending_;
+  std::vector<char> has_pending_;
+  size_t min_blocks_ = 64;
+
+  inline void add_level_ () {
+    levels_.emplace_back();
+    pending_.push_back(0);
+    has_pending_.push_back(0);
+  }
+  inline void push_ (size_t h, data_t x) {
+    for(;; ++h) {
+      if (h == levels_.size()) add_level_();
+      levels_[h].record(x);
+      if (! has_pending_[h]) {
+        pending_[h] = x;
+        has_pending_[h] = 1;
+        return;
+      }
+      x = (pending_[h] + x) / 2;
+      has_pending_[h] = 0;
+    }
+  }
+}; /*** END class BlockingStat */
+
+template <typename data_t>
+template <typename Iter>
+inline void BlockingStat<data_t>::record (Iter first, Iter last) {
+  const size_t block_size = SimpStat<data_t>::record_block_size;
+  data_t xs[block_size];
+  while (first != last) {
+    size_t n = 0;
+    for(; n < block_size && first != last; ++n, ++first)
+      xs[n] = *first;
+    // Each pass records a level and leaves the pair means in xs for the next
+    for(size_t h=0; n > 0; ++h) {
+      if (h == levels_.size()) add_level_();
+      levels_[h].record(xs, xs + n);
+      size_t i = 0, m = 0;
+      if (has_pending_[h]) {
+        xs[m++] = (pending_[h] + xs[0]) / 2;
+        i = 1;
+      }
+      for(; i + 1 < n; i += 2)
+        xs[m++] = (xs[i] + xs[i+1]) / 2;
+      has_pending_[h] = i < n;
+      if (i < n) pending_[h] = xs[i];
+      n = m;
+    }
+  }
+}
+
+template <typename data_t>
+inline void BlockingStat<data_t>::merge (const BlockingStat<data_t>& other) {
+  while (levels_.size() < other.levels_.size()) add_level_();
+  for(size_t h=0; h < other.levels_.size(); ++h)
+    levels_[h].merge(other.levels_[h]);
+  // Pair the unpaired values, from the top so a carry is not paired twice
+  for(size_t h = other.levels_.size(); h-- > 0; )
+    if (other.has_pending_[h]) {
+      if (has_pending_[h]) {
+        has_pending_[h] = 0;
+        push_(h + 1, (pending_[h] + other.pending_[h]) / 2);
+      }
+      else {
+        pending_[h] = other.pending_[h];
+        has_pending_[h] = 1;
+      }
+    }
+}
+
+/*
+  The first level whose error is not exceeded by that of the next by more
+  than the error bar of the next. Only levels with min_blocks() blocks
+  count. If there is no such level, the highest one that counts.
+*/
+template <typename data_t>
+inline size_t BlockingStat<data_t>::plateau_level () const {
+  size_t h = 0;
+  for(; h + 1 < levels_.size() && levels_[h+1].N() >= min_blocks_; ++h)
+    if (level_error(h+1) - level_error(h) < level_error_error(h+1)) return h;
+  return h;
+}
+
+template <typename data_t>
+inline void BlockingStat<data_t>::print_levels (std::ostream& out) const {
+  out << "# level n_blocks error error_of_error\n";
+  for(size_t h=0; h < levels_.size(); ++h)
+    out << h << " " << levels_[h].N() << " " << level_error(h) << " " << level_error_error(h) << "\n";
+}
+
+} /*** END namespace gjl */
+
+#endif
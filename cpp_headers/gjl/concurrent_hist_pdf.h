@@ -0,0 +1,330 @@
+// -*-c++-*-
+#ifndef CONCURRENT_HIST_PDF_H
+#define CONCURRENT_HIST_PDF_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <gjl/hist_pdf.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+  class gjl::ConcurrentHistPdf -- a HistPdf filled by many threads at once.
+
+  Each producer thread owns one shard of counts. A shard is written only by
+  its owner, so producers never contend and need no atomic read-modify-write.
+  Any thread may call snapshot() at any time to get a merged HistPdf
+  without stopping the producers.
+
+  ConcurrentHistPdf<> hist(HistPdf<>(100,0.1,1e7,true), omp_get_max_threads());
+  #pragma omp parallel
+  {
+    ...
+    hist.add_count(x);   // shard is omp_get_thread_num()
+  }
+  // in a monitoring thread, or after the parallel region
+  HistPdf<> h = hist.snapshot();
+  h.print_pdf(out);
+
+  How the reader gets a consistent view:
+  Each shard has two count buffers. The producer writes to the active one.
+  The reader asks the producer to swap buffers; the producer does so at the
+  start of its next add_count and acknowledges. The retired buffer is then
+  quiescent, and the reader folds it into the shard's published totals and
+  zeros it. If the producer is idle, it never answers, but then the reader
+  can copy the active buffer under a sequence lock without the producer
+  getting in the way. Either way, the counts and tallies in the snapshot of
+  each shard describe the same set of samples. Shards are not frozen at
+  the same instant.
+*/
+
+namespace gjl {
+
+template <typename cnt_t = double, typename bin_t = double>
+class ConcurrentHistPdf {
+public:
+  typedef HistPdf<cnt_t,bin_t> hist_t;
+  typedef typename hist_t::ind_t ind_t;
+
+  ConcurrentHistPdf() {}
+  ConcurrentHistPdf(const hist_t& shape, size_t n_shards) { init(shape, n_shards); }
+  ConcurrentHistPdf(const ConcurrentHistPdf&) = delete;
+  ConcurrentHistPdf& operator=(const ConcurrentHistPdf&) = delete;
+
+  inline void init(const hist_t& shape, size_t n_shards);
+  inline size_t n_shards() const { return shards_.size(); }
+  inline const hist_t& shape() const { return shape_; }
+
+  // Producers. Only one thread may write to a given shard.
+  inline void add_count(size_t shard, bin_t x);
+  template <typename Iter>
+  inline void add_counts(size_t shard, Iter first, Iter last);
+#ifdef _OPENMP
+  inline void add_count(bin_t x) { add_count(omp_get_thread_num(), x); }
+  template <typename Iter>
+  inline void add_counts(Iter first, Iter last) { add_counts(omp_get_thread_num(), first, last); }
+#endif
+
+  // Readers. These may be called at any time from any thread.
+  inline void snapshot(hist_t& h);
+  inline hist_t snapshot() { hist_t h; snapshot(h); return h; }
+
+  // Not thread safe. Call only when no producers are running.
+  inline void clear();
+
+private:
+  static const size_t cache_line = 64;
+
+  struct Buffer {
+    std::unique_ptr<std::atomic<cnt_t>[]> counts;
+    std::atomic<size_t> n_counts;
+    std::atomic<size_t> n_greater_than_max;
+    std::atomic<size_t> n_less_than_min;
+    std::atomic<bin_t> data_min;
+    std::atomic<bin_t> data_max;
+  };
+
+  /*
+    The padding keeps the line written by the producer (seq etc.), the line
+    written by the reader (swap_request) and neighboring shards apart.
+  */
+  struct Shard {
+    char pad0_[cache_line];
+    std::atomic<unsigned> seq;    // odd while the producer is writing
+    std::atomic<int> active;      // buffer the producer writes to
+    std::atomic<unsigned> n_swaps;
+    unsigned seq_local;           // producer's copy of seq
+    char pad1_[cache_line];
+    std::atomic<bool> swap_request;
+    char pad2_[cache_line];
+    Buffer buf[2];
+    // Owned by the reader
+    unsigned n_swaps_folded;
+    bool request_pending;
+    std::vector<cnt_t> published;
+    hist_pdf::Tally<bin_t> published_tally;
+    char pad3_[cache_line];
+  };
+
+  hist_t shape_;
+  size_t n_bins_ = 0;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::mutex read_mutex_;
+
+  static inline void increment_(std::atomic<cnt_t>& c) {
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+  static inline void zero_buffer_(Buffer& b, size_t n);
+  inline void begin_write_(Shard& s);
+  inline void end_write_(Shard& s) {
+    s.seq_local += 1;
+    s.seq.store(s.seq_local, std::memory_order_release);
+  }
+  inline void add_tally_(Buffer& b, const hist_pdf::Tally<bin_t>& t);
+  inline void read_buffer_(const Buffer& b, std::vector<cnt_t>& out, hist_pdf::Tally<bin_t>& t) const;
+  inline bool try_read_active_(Shard& s, unsigned q1, std::vector<cnt_t>& out,
+                               hist_pdf::Tally<bin_t>& t) const;
+  inline void read_shard_(Shard& s, std::vector<cnt_t>& out, hist_pdf::Tally<bin_t>& t);
+
+}; /*** END class ConcurrentHistPdf */
+
+template <typename cnt_t, typename bin_t>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::zero_buffer_(Buffer& b, size_t n) {
+  for(size_t i=0; i<n; ++i) b.counts[i].store(0, std::memory_order_relaxed);
+  b.n_counts.store(0, std::memory_order_relaxed);
+  b.n_greater_than_max.store(0, std::memory_order_relaxed);
+  b.n_less_than_min.store(0, std::memory_order_relaxed);
+  b.data_min.store(0, std::memory_order_relaxed);
+  b.data_max.store(0, std::memory_order_relaxed);
+}
+
+template <typename cnt_t, typename bin_t>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::init(const hist_t& shape, size_t n_shards) {
+  shape_ = shape;
+  shape_.clear();
+  n_bins_ = shape_.n_bins();
+  shards_.clear();
+  for(size_t k=0; k<n_shards; ++k) {
+    std::unique_ptr<Shard> s(new Shard);
+    s->seq.store(0);
+    s->active.store(0);
+    s->n_swaps.store(0);
+    s->seq_local = 0;
+    s->swap_request.store(false);
+    for(int j=0; j<2; ++j) {
+      s->buf[j].counts.reset(new std::atomic<cnt_t>[n_bins_]);
+      zero_buffer_(s->buf[j], n_bins_);
+    }
+    s->n_swaps_folded = 0;
+    s->request_pending = false;
+    s->published.assign(n_bins_, 0);
+    s->published_tally = hist_pdf::Tally<bin_t>();
+    shards_.push_back(std::move(s));
+  }
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+template <typename cnt_t, typename bin_t>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::clear() {
+  init(shape_, n_shards());
+}
+
+/*
+  Open the sequence lock, and swap buffers if the reader asked us to.
+  The acquire on swap_request makes the reader's zeroing of the buffer
+  we swap to visible here.
+*/
+template <typename cnt_t, typename bin_t>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::begin_write_(Shard& s) {
+  s.seq_local += 1;
+  s.seq.store(s.seq_local, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  if (s.swap_request.load(std::memory_order_acquire)) {
+    s.active.store(1 - s.active.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    s.swap_request.store(false, std::memory_order_relaxed);
+    s.n_swaps.store(s.n_swaps.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+}
+
+template <typename cnt_t, typename bin_t>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::add_tally_(Buffer& b, const hist_pdf::Tally<bin_t>& t) {
+  hist_pdf::Tally<bin_t> bt;
+  bt.n_counts = b.n_counts.load(std::memory_order_relaxed);
+  bt.n_greater_than_max = b.n_greater_than_max.load(std::memory_order_relaxed);
+  bt.n_less_than_min = b.n_less_than_min.load(std::memory_order_relaxed);
+  bt.data_min = b.data_min.load(std::memory_order_relaxed);
+  bt.data_max = b.data_max.load(std::memory_order_relaxed);
+  bt.merge(t);
+  b.n_counts.store(bt.n_counts, std::memory_order_relaxed);
+  b.n_greater_than_max.store(bt.n_greater_than_max, std::memory_order_relaxed);
+  b.n_less_than_min.store(bt.n_less_than_min, std::memory_order_relaxed);
+  b.data_min.store(bt.data_min, std::memory_order_relaxed);
+  b.data_max.store(bt.data_max, std::memory_order_relaxed);
+}
+
+template <typename cnt_t, typename bin_t>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::add_count(size_t shard, bin_t x) {
+  Shard& s = *shards_[shard];
+  begin_write_(s);
+  ind_t idx;
+  hist_pdf::Tally<bin_t> t;
+  shape_.index_block(&x, 1, &idx, t);
+  Buffer& b = s.buf[s.active.load(std::memory_order_relaxed)];
+  increment_(b.counts[idx]);
+  add_tally_(b, t);
+  end_write_(s);
+}
+
+/* Each block of samples goes in under one turn of the sequence lock */
+template <typename cnt_t, typename bin_t>
+template <typename Iter>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::add_counts(size_t shard, Iter first, Iter last) {
+  Shard& s = *shards_[shard];
+  const size_t block_size = hist_t::add_counts_block_size;
+  bin_t xs[block_size];
+  ind_t idx[block_size];
+  while (first != last) {
+    size_t n = 0;
+    for(; n < block_size && first != last; ++n, ++first)
+      xs[n] = *first;
+    hist_pdf::Tally<bin_t> t;
+    shape_.index_block(xs, n, idx, t);
+    begin_write_(s);
+    Buffer& b = s.buf[s.active.load(std::memory_order_relaxed)];
+    for(size_t i=0; i<n; ++i)
+      increment_(b.counts[idx[i]]);
+    add_tally_(b, t);
+    end_write_(s);
+  }
+}
+
+template <typename cnt_t, typename bin_t>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::read_buffer_(const Buffer& b, std::vector<cnt_t>& out,
+                                                         hist_pdf::Tally<bin_t>& t) const {
+  for(size_t i=0; i<n_bins_; ++i)
+    out[i] = b.counts[i].load(std::memory_order_relaxed);
+  t.n_counts = b.n_counts.load(std::memory_order_relaxed);
+  t.n_greater_than_max = b.n_greater_than_max.load(std::memory_order_relaxed);
+  t.n_less_than_min = b.n_less_than_min.load(std::memory_order_relaxed);
+  t.data_min = b.data_min.load(std::memory_order_relaxed);
+  t.data_max = b.data_max.load(std::memory_order_relaxed);
+}
+
+/*
+  Copy the active buffer plus the published totals into out and t, if the
+  producer is not writing meanwhile. Return false if it was.
+*/
+template <typename cnt_t, typename bin_t>
+inline bool ConcurrentHistPdf<cnt_t,bin_t>::try_read_active_(Shard& s, unsigned q1, std::vector<cnt_t>& out,
+                                                             hist_pdf::Tally<bin_t>& t) const {
+  if (q1 & 1) return false;
+  hist_pdf::Tally<bin_t> bt;
+  read_buffer_(s.buf[s.active.load(std::memory_order_relaxed)], out, bt);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (s.seq.load(std::memory_order_relaxed) != q1) return false;
+  for(size_t i=0; i<n_bins_; ++i) out[i] += s.published[i];
+  t = s.published_tally;
+  t.merge(bt);
+  return true;
+}
+
+/* Consistent copy of one shard into out and t. Called with read_mutex_ held. */
+template <typename cnt_t, typename bin_t>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::read_shard_(Shard& s, std::vector<cnt_t>& out,
+                                                        hist_pdf::Tally<bin_t>& t) {
+  if (! s.request_pending) {
+    s.request_pending = true;
+    s.swap_request.store(true, std::memory_order_release);
+  }
+  for(;;) {
+    // Load seq before n_swaps, so that a swap after we look at n_swaps changes seq.
+    unsigned q1 = s.seq.load(std::memory_order_acquire);
+    if (s.n_swaps.load(std::memory_order_acquire) != s.n_swaps_folded) {
+      // The producer swapped. The retired buffer is ours until we ask again.
+      Buffer& b = s.buf[1 - s.active.load(std::memory_order_relaxed)];
+      hist_pdf::Tally<bin_t> bt;
+      read_buffer_(b, out, bt);
+      for(size_t i=0; i<n_bins_; ++i) s.published[i] += out[i];
+      s.published_tally.merge(bt);
+      zero_buffer_(b, n_bins_);
+      ++s.n_swaps_folded;
+      s.request_pending = false;
+      // If the producer has since gone idle, include what it wrote after the swap.
+      if (try_read_active_(s, s.seq.load(std::memory_order_acquire), out, t)) return;
+      out = s.published;
+      t = s.published_tally;
+      return;
+    }
+    // The producer has not answered, maybe it is idle. Try to copy the active buffer.
+    if (try_read_active_(s, q1, out, t)) return;
+  }
+}
+
+template <typename cnt_t, typename bin_t>
+inline void ConcurrentHistPdf<cnt_t,bin_t>::snapshot(hist_t& h) {
+  std::lock_guard<std::mutex> lock(read_mutex_);
+  h = shape_;
+  std::vector<cnt_t> cnts(n_bins_);
+  for(size_t k=0; k<shards_.size(); ++k) {
+    hist_pdf::Tally<bin_t> t;
+    read_shard_(*shards_[k], cnts, t);
+    for(size_t i=0; i<n_bins_; ++i)
+      h.add_to_counts(i, cnts[i]);
+    h.merge_tally(t);
+  }
+}
+
+} /*** END namespace gjl */
+
+#endif
@@ -0,0 +1,188 @@
+// -*-c++-*-
+#ifndef COUNT_HIST_PDF_H
+#define COUNT_HIST_PDF_H
+
+#include <cstdint>
+#include <vector>
+#include <iostream>
+#include <gjl/hist_pdf.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+  class gjl::CountHistPdf -- a histogram of unweighted counts, kept as
+  integers.
+
+  gjl::CountHistPdf<> hist(100000, 0.1, 1e6, true);
+  hist.add_counts(v.begin(), v.end());
+  other.merge(hist);
+  hist.print_pdf(out);  // same text as HistPdf<>
+
+  Each bin is a uint32_t, half the size of a double, so twice as many
+  bins fit in cache while filling. A bin that wraps past 2^32 - 1
+  carries into a uint64_t high part, which is allocated on the first
+  carry. count(i), high * 2^32 + low, is a uint64_t.
+
+  Binning is done by a HistPdf<double,bin_t> that holds the shape, so
+  linear, log, fast log and custom bins all work as in HistPdf. Its
+  counts are never touched. Counts become doubles only in pdf(),
+  to_hist_pdf() and printing.
+
+  merge() is an integer add. When no bin carries, which is nearly
+  always, it is a plain loop that the compiler vectorizes.
+*/
+
+namespace gjl {
+
+template <typename bin_t = double>
+class CountHistPdf {
+public:
+  typedef HistPdf<double,bin_t> hist_t;
+  typedef typename hist_t::ind_t ind_t;
+
+  CountHistPdf() {}
+  CountHistPdf(size_t n_bins, bin_t min, bin_t max, bool uselog = false) : shape_(n_bins, min, max, uselog) {
+    clear();
+  }
+  explicit CountHistPdf(const std::vector<bin_t>& edges) : shape_(edges) { clear(); }
+  inline void use_fast_log(bool fastlog) { shape_.use_fast_log(fastlog); }
+
+  inline void clear() {
+    low_.assign(shape_.n_bins(), 0);
+    high_.clear();
+    tally_ = hist_pdf::Tally<bin_t>();
+  }
+
+  inline void add_count(bin_t x) {
+    ind_t idx;
+    hist_pdf::Tally<bin_t> t;
+    shape_.index_block(&x, 1, &idx, t);
+    increment_(idx);
+    tally_.merge(t);
+  }
+  template <typename Iter>
+  inline void add_counts(Iter first, Iter last);
+  // Add n to bin i, for merging counts kept elsewhere. The tallies are not changed.
+  inline void add_to_count(size_t i, uint64_t n);
+
+  inline bool is_same_shape(const CountHistPdf<bin_t>& other) const { return shape_.is_same_shape(other.shape_); }
+  inline void merge(const CountHistPdf<bin_t>& other);
+  inline bool operator==(const CountHistPdf<bin_t>& other) const;
+
+  inline const hist_t& shape() const { return shape_; }
+  inline size_t n_bins() const { return shape_.n_bins(); }
+  inline uint64_t count(size_t i) const {
+    return high_.empty() ? low_[i] : (high_[i] << 32) + low_[i];
+  }
+  inline const hist_pdf::Tally<bin_t>& tally() const { return tally_; }
+  inline size_t n_counts() const { return tally_.n_counts; }
+  inline size_t n_greater_than_max() const { return tally_.n_greater_than_max; }
+  inline size_t n_less_than_min() const { return tally_.n_less_than_min; }
+  inline bin_t center(size_t i) const { return shape_.center(i); }
+  inline bin_t pdf(size_t i) const { return count(i) / (n_counts() * shape_.bin_width(i)); }
+  inline size_t num_merged_hists() const { return num_merged_hists_; }
+  inline void increment_num_trials() { ++num_trials_; }
+  inline size_t num_trials() const { return num_trials_; }
+
+  // A HistPdf<> with our shape, counts and tallies
+  inline void to_hist_pdf(hist_t& h) const;
+  inline hist_t to_hist_pdf() const { hist_t h; to_hist_pdf(h); return h; }
+  inline void print_pdf(std::ostream& out = std::cout) const { to_hist_pdf().print_pdf(out); }
+  inline bool write_pdf(const std::string& filename) const { return to_hist_pdf().write_pdf(filename); }
+
+private:
+  hist_t shape_;
+  std::vector<uint32_t> low_;
+  std::vector<uint64_t> high_; // carries out of low_, allocated by the first one
+  hist_pdf::Tally<bin_t> tally_;
+  size_t num_merged_hists_ = 0;
+  size_t num_trials_ = 0;
+
+  inline void carry_(size_t i, uint64_t n) {
+    if (high_.empty()) high_.assign(low_.size(), 0);
+    high_[i] += n;
+  }
+  inline void increment_(size_t i) {
+    if (++low_[i] == 0) carry_(i, 1);
+  }
+}; /*** END class CountHistPdf */
+
+template <typename bin_t>
+template <typename Iter>
+inline void CountHistPdf<bin_t>::add_counts(Iter first, Iter last) {
+  const size_t block_size = hist_t::add_counts_block_size;
+  bin_t xs[block_size];
+  ind_t idx[block_size];
+  hist_pdf::Tally<bin_t> t;
+  uint32_t *low = low_.data();
+  while (first != last) {
+    size_t n = 0;
+    for(; n < block_size && first != last; ++n, ++first)
+      xs[n] = *first;
+    shape_.index_block(xs, n, idx, t);
+    for(size_t i=0; i < n; ++i)
+      if (++low[idx[i]] == 0) carry_(idx[i], 1);
+  }
+  tally_.merge(t);
+}
+
+template <typename bin_t>
+inline void CountHistPdf<bin_t>::add_to_count(size_t i, uint64_t n) {
+  const uint32_t lo = (uint32_t) n;
+  const uint32_t s = low_[i] + lo;
+  low_[i] = s;
+  const uint64_t c = (n >> 32) + (s < lo ? 1 : 0);
+  if (c != 0) carry_(i, c);
+}
+
+template <typename bin_t>
+inline void CountHistPdf<bin_t>::merge(const CountHistPdf<bin_t>& other) {
+  if (! is_same_shape(other)) {
+    std::cerr << "*** count_hist_pdf: cannot merge histograms of different shapes.\n";
+    abort();
+  }
+  const size_t n = low_.size();
+  uint32_t *a = low_.data();
+  const uint32_t *b = other.low_.data();
+  uint32_t any_carry = 0;
+  for(size_t i=0; i < n; ++i)
+    any_carry |= (uint32_t) (a[i] + b[i]) < a[i];
+  if (any_carry == 0 && other.high_.empty()) {
+    for(size_t i=0; i < n; ++i) a[i] += b[i];
+  }
+  else {
+    for(size_t i=0; i < n; ++i) add_to_count(i, other.count(i));
+  }
+  tally_.merge(other.tally_);
+  num_trials_ += other.num_trials_;
+  ++num_merged_hists_;
+}
+
+template <typename bin_t>
+inline bool CountHistPdf<bin_t>::operator==(const CountHistPdf<bin_t>& other) const {
+  if (! is_same_shape(other)) return false;
+  for(size_t i=0; i < low_.size(); ++i)
+    if (count(i) != other.count(i)) return false;
+  return true;
+}
+
+template <typename bin_t>
+inline void CountHistPdf<bin_t>::to_hist_pdf(hist_t& h) const {
+  h = shape_;
+  h.clear();
+  double *c = h.counts()->data();
+  for(size_t i=0; i < low_.size(); ++i) c[i] = count(i);
+  h.merge_tally(tally_);
+  h.num_merged_hists(num_merged_hists_);
+  h.num_trials(num_trials_);
+}
+
+} /*** END namespace gjl */
+
+#endif
@@ -0,0 +1,70 @@
+// -*-c++-*-
+#ifndef GJL_HIST_MERGER_H
+#define GJL_HIST_MERGER_H
+
+#include <string>
+#include <vector>
+#include <gjl/hist_pdf.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+ * class gjl::HistMerger -- merge any number of histogram result files
+ * into one HistPdf<>. A file may be the text written by
+ * HistPdf::print_pdf, with any lines before "#### Histogram", or the
+ * binary format of gjl/result_file.h.
+ *
+ *   gjl::HistMerger merger;
+ *   gjl::HistPdf<> total;
+ *   if (! merger.merge(files, total)) std::cerr << merger.error() << "\n";
+ *
+ * The files are split into contiguous runs, one per thread. Each thread
+ * streams its files into its own accumulator, holding one file at a time,
+ * and the accumulators are then added pairwise in a tree. Memory is
+ * n_threads histograms, whatever the number of files. The result does
+ * not depend on timing; for a given number of threads, the sums are
+ * always done in the same order.
+ *
+ * All files must have the shape of the first. Text files print the bin
+ * limits with 6 digits, so min and max bin are compared to a relative
+ * tolerance of 1e-5. Counts in text files are as exact as they were
+ * printed. If a text file has a line for every bin, lines go to bins in
+ * order. If zeros were not printed, each line goes to the bin holding
+ * its center. That is an error if the bins are too narrow for the
+ * 6 printed digits to tell which bin a center is in.
+ * Custom bins can only be read from binary files. A mismatch or
+ * a bad file stops the merge, and error() names the file and the reason.
+ */
+
+namespace gjl {
+
+  class HistMerger {
+  public:
+    HistMerger() {}
+    // Number of threads. 0, the default, means as many as OpenMP offers.
+    void n_threads(int n) { n_threads_ = n; }
+    int n_threads() const { return n_threads_; }
+
+    bool merge(const std::vector<std::string>& fnames, HistPdf<>& total);
+    // Read one file. This is merge of a single file.
+    bool read(const std::string& fname, HistPdf<>& hist);
+
+    const std::string& error() const { return error_; }
+
+    // File starts with the binary result file magic
+    static bool is_binary_file(const std::string& fname);
+
+  private:
+    int n_threads_ = 0;
+    std::string error_;
+  }; /*** END class HistMerger */
+
+}
+
+#endif
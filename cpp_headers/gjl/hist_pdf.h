@@ -7,6 +7,15 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <gjl/text_buffer.h>
 
 /*****************************************************
 * Copyright 2014 John Lapeyre                        *
@@ -59,6 +68,102 @@ namespace gjl {
     template <typename bin_t>
     inline bin_t histexp (const bin_t x) { return (pow(10.0,x));}
 
+    /*
+     * For positive doubles, the bits read as an integer increase with the
+     * value. Shifting off all but the top mantissa_bits of the mantissa
+     * leaves the exponent and a few mantissa bits: a key that is the index
+     * of a cell of nearly constant width on a log scale. Negative x give
+     * negative keys.
+     */
+    inline int64_t log_cell_key (const double x, const int mantissa_bits) {
+      int64_t bits;
+      memcpy(&bits, &x, sizeof(x));
+      return bits >> (52 - mantissa_bits);
+    }
+
+    // Only doubles are supported. This is never called.
+    template <typename bin_t>
+    inline int64_t log_cell_key (const bin_t x, const int mantissa_bits) { return 0; }
+
+    // Largest lookup table for fast log binning
+    const size_t max_log_cell_table_size = 1 << 16;
+
+    /*
+     * How add_weighted_count sums weights. compensated_summation keeps a
+     * Kahan-Neumaier correction for each bin and for the total. It costs
+     * a few more operations per weight, and the error no longer grows
+     * with the number of weights.
+     */
+    enum weight_summation_t { naive_summation, compensated_summation };
+
+    // sum += x, with the lost low order part accumulated in comp
+    template <typename T>
+    inline void neumaier_add (T& sum, T& comp, const T x) {
+      const T t = sum + x;
+      if (std::abs(sum) >= std::abs(x)) comp += (sum - t) + x;
+      else comp += (x - t) + sum;
+      sum = t;
+    }
+
+    /*
+     * Min and max of xs[0], ..., xs[n-1], n > 0. Each of 8 lanes keeps
+     * its own min and max, so the compiler may vectorize the main loop.
+     */
+    template <typename T>
+    inline void block_min_max (const T *xs, size_t n, T& mn, T& mx) {
+      const size_t nlanes = 8;
+      T lane_min[nlanes];
+      T lane_max[nlanes];
+      for(size_t j=0; j<nlanes; ++j) lane_min[j] = lane_max[j] = xs[0];
+      size_t i = 0;
+      for(; i + nlanes <= n; i += nlanes)
+        for(size_t j=0; j<nlanes; ++j) {
+          const T x = xs[i+j];
+          lane_min[j] = x < lane_min[j] ? x : lane_min[j];
+          lane_max[j] = x > lane_max[j] ? x : lane_max[j];
+        }
+      for(; i<n; ++i) {
+        const T x = xs[i];
+        lane_min[0] = x < lane_min[0] ? x : lane_min[0];
+        lane_max[0] = x > lane_max[0] ? x : lane_max[0];
+      }
+      mn = lane_min[0];
+      mx = lane_max[0];
+      for(size_t j=1; j<nlanes; ++j) {
+        if (lane_min[j] < mn) mn = lane_min[j];
+        if (lane_max[j] > mx) mx = lane_max[j];
+      }
+    }
+
+    /*
+     * Running tallies for a set of samples: number of samples, data min
+     * and max, and number falling outside the binned range.  min and max
+     * are in the binning coordinate, ie. log10 of the data for log spacing.
+     */
+    template <typename bin_t>
+    struct Tally {
+      size_t n_counts = 0;
+      size_t n_greater_than_max = 0;
+      size_t n_less_than_min = 0;
+      bin_t data_min = 0;
+      bin_t data_max = 0;
+
+      inline void merge(const Tally<bin_t> & other) {
+        if (other.n_counts == 0) return;
+        if (n_counts == 0) {
+          data_min = other.data_min;
+          data_max = other.data_max;
+        }
+        else {
+          if (other.data_min < data_min) data_min = other.data_min;
+          if (other.data_max > data_max) data_max = other.data_max;
+        }
+        n_counts += other.n_counts;
+        n_greater_than_max += other.n_greater_than_max;
+        n_less_than_min += other.n_less_than_min;
+      }
+    };
+
   }
 
 template <typename cnt_t = double, typename bin_t = double>
@@ -69,12 +174,26 @@ public:
   inline explicit HistPdf(size_t n);
   inline HistPdf(size_t n, bin_t min, bin_t max);
   inline HistPdf(size_t n, bin_t min, bin_t max, bool uselog );
+  inline explicit HistPdf(const std::vector<bin_t> & edges);
   inline void constructor_helper();
   //  inline void init(size_t n, bin_t min, bin_t max, bool uselog = false);
   inline void init(size_t n, bin_t min, bin_t max);
-
-  inline void copy_shape(const HistPdf<cnt_t,bin_t>  &other)
-  {init(other.n_bins(), other.min(), other.max(), other.using_log());}
+  /*
+    Bins with arbitrary edges. edges holds the n+1 bin edges, in increasing
+    order, in the data coordinate. Log spacing is turned off.
+  */
+  inline void init(const std::vector<bin_t> & edges);
+
+  inline void copy_shape(const HistPdf<cnt_t,bin_t>  &other) {
+    if (other.using_custom_bins()) init(other.custom_bins());
+    else {
+      n_bins_ = other.n_bins();
+      lin_min_ = other.min();
+      lin_max_ = other.max();
+      use_log(other.using_log());
+      num_merged_hists_ = 0;
+    }
+  }
 
   // But this will not, as is, copy uselog !
   /*
@@ -84,38 +203,66 @@ public:
 
   inline bin_t pdf_integral () const;
   inline bin_t weighted_pdf_integral () const;
+  // Average width with custom bins
   inline bin_t width() const { return width_; }
+  // Width of bin i in the data coordinate
+  inline double bin_width(ind_t i) const {
+    if (using_custom_bins_) return custom_bins_[i+1] - custom_bins_[i];
+    if (using_log_) return log_widths_[i];
+    return width_;
+  }
 
   inline bin_t min() const { return maybe_exp(min_); }
   inline bin_t max() const { return maybe_exp(max_); }
+  // min and max as passed to init. min() may differ in the last bits with log spacing.
+  inline bin_t init_min() const { return lin_min_; }
+  inline bin_t init_max() const { return lin_max_; }
   inline bin_t data_max() const { return maybe_exp(data_max_); }
   inline bin_t data_min() const { return maybe_exp(data_min_); }
 
-  inline bin_t center(ind_t i) const { return maybe_exp(min_ + i * width_ + width_/2);}
-
-  inline double logwidth(ind_t i) const {
-    return hist_pdf::histexp(min_ + width_ * (i+1))*(1-hist_pdf::histexp(-width_));}
-  inline bin_t pdf(ind_t i) const {
-    if (using_log_) {
-      double lw = logwidth(i);
-      return counts_[i] / (n_counts_ * lw);
-    }
-    return counts_[i] / (n_counts_ * width_);
+  // With log spacing, centers and widths come from tables made in constructor_helper
+  inline bin_t center(ind_t i) const {
+    if (using_custom_bins_) return (custom_bins_[i] + custom_bins_[i+1]) / 2;
+    if (using_log_) return log_centers_[i];
+    return min_ + i * width_ + width_/2;
   }
+
+  inline double logwidth(ind_t i) const { return log_widths_[i]; }
+  inline bin_t pdf(ind_t i) const { return count(i) / (n_counts_ * bin_width(i)); }
   inline size_t n_counts () const { return n_counts_; }
-  inline cnt_t  n_weighted_counts () const { return n_weighted_counts_; }
+  inline cnt_t  n_weighted_counts () const { return n_weighted_counts_ + n_weighted_comp_; }
   inline size_t n_bins () const { return n_bins_; }
   inline size_t n_greater_than_max() const { return n_greater_than_max_; }
   inline void n_greater_than_max(size_t n) const { n_greater_than_max_ = n; }
   inline size_t n_less_than_min() const { return n_less_than_min_; }
   inline size_t num_merged_hists() const { return num_merged_hists_;}
-  inline bin_t weighted_pdf (ind_t i) const { return counts_[i] / (n_weighted_counts_ * width_);}
-  inline std::vector<cnt_t> * counts () { return & counts_; }  // why cant i use this ?
+  inline void num_merged_hists(size_t n) { num_merged_hists_ = n;}
+  inline void n_weighted_counts(cnt_t w) { n_weighted_counts_ = w; n_weighted_comp_ = 0;}
+  inline bin_t weighted_pdf (ind_t i) const { return count(i) / (n_weighted_counts() * bin_width(i));}
+  // Sum of squared weights in bin i, from add_weighted_count. Zero if there were none.
+  inline cnt_t sum_weights_squared (ind_t i) const { return sumw2_.empty() ? 0 : sumw2_[i]; }
+  // Standard error of weighted_pdf(i)
+  inline bin_t weighted_pdf_error (ind_t i) const {
+    return std::sqrt(sum_weights_squared(i)) / (n_weighted_counts() * bin_width(i));
+  }
+  inline bool has_weights () const { return ! sumw2_.empty(); }
+  // The sums of squared weights, n_bins of them, or nullptr if there were no weights
+  inline const cnt_t * sum_weights_squared_data () const { return sumw2_.empty() ? nullptr : sumw2_.data(); }
+  // Add w[i] to the sum of squared weights of bin i, for all bins
+  inline void add_sum_weights_squared (const cnt_t *w) {
+    if (sumw2_.size() != n_bins_) sumw2_.assign(n_bins_, 0);
+    for(size_t i=0; i<n_bins_; ++i) sumw2_[i] += w[i];
+  }
+  inline void weight_summation (hist_pdf::weight_summation_t w) { fold_weight_comp_(); weight_summation_ = w; }
+  inline hist_pdf::weight_summation_t weight_summation () const { return weight_summation_; }
+  // With compensated weights, the corrections are first added to the counts.
+  inline std::vector<cnt_t> * counts () { fold_weight_comp_(); return & counts_; }  // why cant i use this ?
+  inline const cnt_t * counts_data () const { return counts_.data(); }
   /*
     Use & so it can be used as an rvalue. Google code standards doesn't like
     this. Use as an lvalue would be clumsy now use add_to_counts
   */
-  inline cnt_t count(ind_t i) const { return counts_[i];}
+  inline cnt_t count(ind_t i) const { return weight_comp_.empty() ? counts_[i] : counts_[i] + weight_comp_[i];}
   std::ostream& print_pdf_long_header (std::ostream& out) const;
   inline std::ostream& print_pdf_long_line (std::ostream& out, cnt_t count, bin_t cent, bin_t pdf) const;
   std::ostream& print_pdf_long (std::ostream& out) const;
@@ -125,11 +272,22 @@ public:
   void print_pdf (std::ostream& out) const;
   inline void print_pdf () const { this->print_pdf(std::cout);}
 
-  void print_pdf(std::string& filename) {
-    std::ofstream out;
-    out.open(filename);
-    print_pdf(out);
-    out.close();
+  void print_pdf(std::string& filename) { write_pdf(filename); }
+
+  /*
+    The text of print_pdf, appended to buf. Write a large histogram this
+    way, with write_pdf or buf.write_file, rather than through an ostream.
+    Keep buf to reuse its memory for the next file.
+  */
+  void format_pdf(TextBuffer& buf) const;
+  bool write_pdf(const std::string& filename, TextBuffer& buf) const {
+    buf.clear();
+    format_pdf(buf);
+    return buf.write_file(filename);
+  }
+  bool write_pdf(const std::string& filename) const {
+    TextBuffer buf(64 * n_bins_ + 1024);
+    return write_pdf(filename, buf);
   }
 
   void print_pdf(const char *filename) {
@@ -147,9 +305,27 @@ public:
   template <typename ...Tail>
   inline void add_count(double head, Tail&&... tail);
   inline void add_count();
-  inline void add_count(const std::vector<double> &vect) {for(size_t i=0; i<vect.size(); ++i) add_count(vect[i]);}
+  inline void add_count(const std::vector<double> &vect) { add_counts(vect.begin(), vect.end()); }
+  template <typename Iter>
+  inline void add_counts(Iter first, Iter last);
+  /*
+    As add_counts, with the input split across n_threads threads (0 means
+    omp_get_max_threads()). Each thread fills private counts, which are
+    added in a tree. The result is the same as add_counts. Iter must be
+    random access. Without OpenMP, this is add_counts.
+  */
+  template <typename Iter>
+  inline void add_counts_parallel(Iter first, Iter last, int n_threads = 0);
   // Don't know a good way to do varargs here.
   inline void add_weighted_count(bin_t x, cnt_t weight);
+  /*
+    Add the samples in [first,last) with weights *wfirst, ... Same result
+    as add_weighted_count on each. Weighted counts use the bins of
+    add_count, with log spacing, fast log binning or custom bins. n_counts
+    is the number of samples, and n_weighted_counts the sum of weights.
+  */
+  template <typename Iter, typename IterW>
+  inline void add_weighted_counts(Iter first, Iter last, IterW wfirst);
 
   // for merging histograms, add_count is for adding a data point
   inline void add_to_counts(size_t i, bin_t x) { counts_[i] += x; }
@@ -157,6 +333,33 @@ public:
 
   inline bool using_log () const { return using_log_ ; }
 
+  /*
+    Fast log binning. Find the bin without calling log10 on each sample.
+    The exponent and top mantissa bits of x give a cell index. A table
+    gives the lowest bin in each cell, and the cells are narrower than the
+    bins, so one compare with the next bin edge finds the bin. Out of
+    range counts are decided by comparing x with the linear min and max.
+    Only data min and max go through log10, and only when they change.
+
+    A sample lands in the same bin as with log10, unless it is within a few
+    ulps of a bin edge, where the log10 path itself is at the mercy of
+    rounding. Fast binning is only turned on for bin_t = double and if the
+    table is not larger than hist_pdf::max_log_cell_table_size. Call after
+    use_log(true).
+  */
+  inline void use_fast_log(bool fastlog);
+  inline bool using_fast_log () const { return using_fast_log_; }
+
+  // Bin index of x (not transformed) by fast log binning.
+  inline ind_t fast_log_bin_index(bin_t x) const {
+    int64_t c = hist_pdf::log_cell_key(x, log_cell_bits_) - log_cell_key_lo_;
+    c = c >= 0 ? c : 0;
+    c = c <= log_cell_top_ ? c : log_cell_top_;
+    ind_t i = log_cell_table_[c];
+    // Use & rather than && to avoid a branch; it is mispredicted near edges.
+    return i + ((unsigned) (x >= bins_[i+1]) & (unsigned) (i + 1 < n_bins_));
+  }
+
   inline void use_log(bool uselog) {
     using_log_ = uselog;
     min_ = maybe_log(lin_min_);
@@ -175,7 +378,10 @@ public:
       merge(*it);
   }
 
+  // Set edge idx of the custom bins. With custom bins in use, this remakes the search tree.
   inline void set_bin_val(size_t idx, bin_t r);
+  inline bool using_custom_bins () const { return using_custom_bins_; }
+  inline const std::vector<bin_t>& custom_bins () const { return custom_bins_; }
 
   inline void fit_to_data_min_max(double fraction);
   inline void fit_to_data_min_max() {fit_to_data_min_max(0);}
@@ -193,10 +399,56 @@ public:
   inline const std::string& hist_name() const { return hist_name_; }
   inline bool is_hist_name_enabled() const { return is_hist_name_enabled_; }
 
-  inline size_t find_index(bin_t x);
+  // Index of the custom bin containing x
+  inline size_t find_index(bin_t x) const;
 
   inline void increment_num_trials() { ++num_trials_; }
   inline size_t num_trials() const { return num_trials_; }
+  inline void num_trials(size_t n) { num_trials_ = n; }
+
+  // Transform x to the binning coordinate, ie log10(x) for log spacing
+  inline bin_t to_internal(bin_t x) const { return maybe_log(x); }
+  // Back from the binning coordinate
+  inline bin_t from_internal(bin_t x) const { return maybe_exp(x); }
+
+  /*
+    Bin index of x, where x is already in the binning coordinate (see maybe_log).
+    Out of range values go to the first or last bin, as in add_count.
+  */
+  inline ind_t bin_index_internal(bin_t x) const {
+    bin_t r = (x - min_) * inv_width_;
+    r = r >= 0 ? r : 0; // NaN goes to 0, too
+    r = r <= top_bin_ ? r : top_bin_;
+    return (ind_t) r;
+  }
+
+  /*
+    Bin index of x with custom bins. The interior edges are stored in
+    Eytzinger (breadth first) order, padded with infinity to a full tree
+    of depth custom_depth_. The descent makes custom_depth_ compares with
+    no branches, and the top levels of the tree share a few cache lines.
+    After the descent, k - 2^depth is the number of interior edges <= x.
+  */
+  inline ind_t custom_bin_index(bin_t x) const {
+    const bin_t *tree = custom_tree_.data();
+    size_t k = 1;
+    for(int j=0; j < custom_depth_; ++j) {
+#ifdef __GNUC__
+      __builtin_prefetch(tree + 16 * k);
+#endif
+      k = 2 * k + (tree[k] <= x);
+    }
+    ind_t i = (ind_t) (k - (size_t(1) << custom_depth_));
+    return i < n_bins_ ? i : n_bins_ - 1;
+  }
+
+  inline void index_block(bin_t *xs, size_t n, ind_t *idx, hist_pdf::Tally<bin_t> & t) const;
+
+  inline hist_pdf::Tally<bin_t> tally() const;
+  inline void merge_tally(const hist_pdf::Tally<bin_t> & t);
+
+  // add_counts works on blocks of this many samples
+  static const size_t add_counts_block_size = 256;
 
 private:
 
@@ -204,13 +456,22 @@ private:
   size_t n_counts_ = 0; // total counts in all bins
   size_t n_greater_than_max_ = 0;
   size_t n_less_than_min_ = 0;
-  cnt_t n_weighted_counts_;
+  cnt_t n_weighted_counts_ = 0;
+  cnt_t n_weighted_comp_ = 0; // compensation, with compensated_summation
+  hist_pdf::weight_summation_t weight_summation_ = hist_pdf::naive_summation;
+  std::vector<cnt_t> sumw2_; // sum of squared weights. Allocated by the first weighted count.
+  std::vector<cnt_t> weight_comp_; // compensation for each bin, with compensated_summation
   size_t num_merged_hists_ = 0;
   size_t num_trials_ = 0; // a convenience for the application
 
   std::vector<cnt_t> counts_;
-  std::vector<bin_t> bins_;
+  std::vector<bin_t> bins_; // bin edges, linear coordinate. Only with log spacing.
+  std::vector<bin_t> log_centers_;
+  std::vector<bin_t> log_widths_;
   std::vector<bin_t> custom_bins_;
+  std::vector<bin_t> custom_tree_; // interior custom edges in Eytzinger order, 1-based
+  int custom_depth_ = 0;
+  bool using_custom_bins_ = false;
 
   bin_t max_ = 1;
   bin_t min_ = 0;
@@ -219,10 +480,20 @@ private:
   bin_t lin_min_ = 0;
 
   bin_t width_ = 0;
+  bin_t inv_width_ = 0; // multiply rather than divide in add_count
+  bin_t top_bin_ = 0; // n_bins_ - 1, as bin_t
   bin_t data_max_ = 0;
   bin_t data_min_ = 0;
 
   bool using_log_ = false;
+  bool using_fast_log_ = false;
+  std::vector<ind_t> log_cell_table_; // lowest bin in each cell. For fast log binning.
+  int64_t log_cell_key_lo_ = 0;
+  int64_t log_cell_top_ = 0;
+  int log_cell_bits_ = 0;
+  // data min and max in the linear coordinate. Only kept up with fast log binning.
+  bin_t lin_data_min_ = 0;
+  bin_t lin_data_max_ = 0;
 
   std::string filename_ = "";
 
@@ -237,6 +508,18 @@ private:
   //  inline bin_t histlog (const bin_t x) const { return log10(x); }
   //  inline bin_t histexp (const bin_t x) const { return (pow(10.0,x));}
 
+  template <typename Iter>
+  inline void add_counts_to_(Iter first, Iter last, cnt_t *counts, hist_pdf::Tally<bin_t> & t) const;
+
+  inline void add_weights_(const ind_t *idx, const cnt_t *w, size_t n);
+  // Add the corrections for compensated weights to the counts
+  inline void fold_weight_comp_() {
+    for(size_t i=0; i < weight_comp_.size(); ++i) counts_[i] += weight_comp_[i];
+    weight_comp_.clear();
+    n_weighted_counts_ += n_weighted_comp_;
+    n_weighted_comp_ = 0;
+  }
+
   inline bin_t maybe_log (const bin_t x) const {
     if (using_log_) return hist_pdf::histlog(x);
     else return x;
@@ -251,6 +534,15 @@ private:
   inline bin_t data_max_internal() const { return data_max_; }
   inline bin_t data_min_internal() const { return data_min_; }
 
+  inline void make_custom_tree_();
+  inline size_t fill_custom_tree_(size_t i, size_t k, const std::vector<bin_t> & sorted);
+
+  inline void sync_lin_data_min_max_() {
+    if (! using_fast_log_) return;
+    lin_data_min_ = hist_pdf::histexp(data_min_);
+    lin_data_max_ = hist_pdf::histexp(data_max_);
+  }
+
 }; /*** END class HistPdf */
 
 /*
@@ -261,10 +553,62 @@ private:
 template <typename cnt_t, typename bin_t>
 inline void HistPdf<cnt_t,bin_t>::constructor_helper() {
   width_ = (max_- min_)/n_bins_;
+  inv_width_ = 1 / width_;
+  top_bin_ = n_bins_ > 0 ? n_bins_ - 1 : 0;
   counts_.resize(n_bins_,0);
+  sumw2_.clear();
+  weight_comp_.clear();
   bins_.resize(n_bins_+1,0);
   custom_bins_.resize(n_bins_+1,0);
+  custom_tree_.clear();
+  custom_depth_ = 0;
+  using_custom_bins_ = false;
   n_counts_ = 0;
+  if (using_log_) {
+    log_centers_.resize(n_bins_);
+    log_widths_.resize(n_bins_);
+    for(size_t i=0; i < n_bins_; ++i) {
+      log_centers_[i] = hist_pdf::histexp(min_ + i * width_ + width_/2);
+      log_widths_[i] = hist_pdf::histexp(min_ + width_ * (i+1))*(1-hist_pdf::histexp(-width_));
+    }
+    for(size_t i=0; i <= n_bins_; ++i)
+      bins_[i] = hist_pdf::histexp(min_ + i * width_);
+  }
+  else {
+    log_centers_.clear();
+    log_widths_.clear();
+  }
+  if (using_fast_log_) use_fast_log(true); // remake table
+}
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf<cnt_t,bin_t>::use_fast_log(bool fastlog) {
+  using_fast_log_ = false;
+  log_cell_table_.clear();
+  if (! fastlog || ! using_log_ || n_bins_ == 0 || sizeof(bin_t) != sizeof(double)
+      || ! (bins_[0] > 0) ) return;
+  // Fewest mantissa bits that make cells no wider than half a bin, so
+  // that a cell never holds two edges, even with rounded edges.
+  int nbits = 0;
+  while (nbits < 52 && log10(1 + pow(2.0,-nbits)) > width_ / 2) ++nbits;
+  const int64_t key_lo = hist_pdf::log_cell_key(bins_[0], nbits);
+  const int64_t key_hi = hist_pdf::log_cell_key(bins_[n_bins_], nbits);
+  if (key_hi - key_lo + 1 > (int64_t) hist_pdf::max_log_cell_table_size) return;
+  log_cell_bits_ = nbits;
+  log_cell_key_lo_ = key_lo;
+  log_cell_top_ = key_hi - key_lo;
+  log_cell_table_.resize(log_cell_top_ + 1);
+  ind_t i = 0;
+  for(int64_t c = 0; c <= log_cell_top_; ++c) {
+    // Smallest double in the cell
+    int64_t bits = (key_lo + c) << (52 - nbits);
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    while (i + 1 < n_bins_ && x >= bins_[i+1]) ++i;
+    log_cell_table_[c] = i;
+  }
+  using_fast_log_ = true;
+  sync_lin_data_min_max_();
 }
 
 template <typename cnt_t, typename bin_t>
@@ -297,6 +641,55 @@ inline void HistPdf<cnt_t,bin_t>::init(size_t n_bins, bin_t min, bin_t max) {
   num_merged_hists_ = 0;
 }
 
+template <typename cnt_t, typename bin_t>
+inline HistPdf<cnt_t,bin_t>::HistPdf(const std::vector<bin_t> & edges) {
+  init(edges);
+}
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf<cnt_t,bin_t>::init(const std::vector<bin_t> & edges) {
+  if (edges.size() < 2) {
+    std::cerr << "*** hist_pdf: custom bins need at least two edges.\n";
+    abort();
+  }
+  for(size_t i=1; i < edges.size(); ++i)
+    if (! (edges[i] > edges[i-1])) {
+      std::cerr << "*** hist_pdf: custom bin edges must be increasing.\n";
+      abort();
+    }
+  n_bins_ = edges.size() - 1;
+  using_log_ = false;
+  lin_min_ = min_ = edges.front();
+  lin_max_ = max_ = edges.back();
+  constructor_helper();
+  custom_bins_ = edges;
+  using_custom_bins_ = true;
+  make_custom_tree_();
+  num_merged_hists_ = 0;
+}
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf<cnt_t,bin_t>::make_custom_tree_() {
+  std::vector<bin_t> interior(custom_bins_.begin() + 1, custom_bins_.end() - 1);
+  custom_depth_ = 0;
+  while ((size_t(1) << custom_depth_) - 1 < interior.size()) ++custom_depth_;
+  interior.resize((size_t(1) << custom_depth_) - 1, std::numeric_limits<bin_t>::infinity());
+  custom_tree_.resize(interior.size() + 1);
+  fill_custom_tree_(0, 1, interior);
+}
+
+// In-order walk of the tree rooted at k, taking sorted values from i
+template <typename cnt_t, typename bin_t>
+inline size_t HistPdf<cnt_t,bin_t>::fill_custom_tree_(size_t i, size_t k,
+                                                      const std::vector<bin_t> & sorted) {
+  if (k < custom_tree_.size()) {
+    i = fill_custom_tree_(i, 2 * k, sorted);
+    custom_tree_[k] = sorted[i++];
+    i = fill_custom_tree_(i, 2 * k + 1, sorted);
+  }
+  return i;
+}
+
 template <typename cnt_t, typename bin_t>
 inline HistPdf<cnt_t,bin_t>::HistPdf(size_t n) {
   n_bins_ = n;
@@ -309,11 +702,24 @@ inline HistPdf<cnt_t,bin_t>::HistPdf(size_t n) {
 
 template <typename cnt_t, typename bin_t>
 inline void HistPdf<cnt_t,bin_t>::add_count(bin_t x) {
+  if (using_fast_log_) {
+    ++counts_[fast_log_bin_index(x)];
+    ++n_counts_;
+    if ( n_counts_ == 1 ) {
+      lin_data_min_ = lin_data_max_ = x;
+      data_min_ = data_max_ = hist_pdf::histlog(x);
+    }
+    else {
+      // lin_data_max_ may be rounded, so check the log, too.
+      if ( x > lin_data_max_ ) { lin_data_max_ = x; data_max_ = std::max(data_max_, hist_pdf::histlog(x)); }
+      if ( x < lin_data_min_ ) { lin_data_min_ = x; data_min_ = std::min(data_min_, hist_pdf::histlog(x)); }
+    }
+    if ( x > lin_max_ ) ++n_greater_than_max_;
+    if ( x < lin_min_ ) ++n_less_than_min_;
+    return;
+  }
   x = maybe_log(x);
-  auto bin_idx = (int)((x - min_) / width_);
-  if ( bin_idx < 0 ) bin_idx = 0;
-  if ( bin_idx >= (int) counts_.size() ) bin_idx = (int) counts_.size() - 1;
-  ++counts_[bin_idx];
+  ++counts_[using_custom_bins_ ? custom_bin_index(x) : bin_index_internal(x)];
   ++n_counts_;
   if ( n_counts_ == 1 ) {
     data_min_ = x;
@@ -330,6 +736,177 @@ inline void HistPdf<cnt_t,bin_t>::add_count(bin_t x) {
 template <typename cnt_t, typename bin_t>
 inline void HistPdf<cnt_t,bin_t>::add_count() { }
 
+/*
+  Compute bin indices idx of the n (at most add_counts_block_size)
+  samples in xs and add them to the tallies t. The counts are not
+  touched; the caller increments whatever counts array it likes. xs
+  may be overwritten.
+
+  The index loop has no branches, so it vectorizes. min and max are
+  kept in several independent lanes, because the compiler will not
+  vectorize a floating point min reduction.
+*/
+template <typename cnt_t, typename bin_t>
+inline void HistPdf<cnt_t,bin_t>::index_block(bin_t *xs, size_t n, ind_t *idx,
+                                              hist_pdf::Tally<bin_t> & t) const {
+  if (n == 0) return;
+  size_t ngt = 0;
+  size_t nlt = 0;
+  if (using_fast_log_) { // xs stay linear
+    const bin_t lo = lin_min_;
+    const bin_t hi = lin_max_;
+    for(size_t i=0; i<n; ++i) {
+      const bin_t x = xs[i];
+      idx[i] = fast_log_bin_index(x);
+      ngt += x > hi;
+      nlt += x < lo;
+    }
+  }
+  else if (using_custom_bins_) {
+    // As custom_bin_index, but descend the tree one level at a time for
+    // all samples, so that the loads for different samples overlap.
+    const bin_t *tree = custom_tree_.data();
+    for(size_t i=0; i<n; ++i) idx[i] = 1;
+    for(int j=0; j < custom_depth_; ++j)
+      for(size_t i=0; i<n; ++i)
+        idx[i] = 2 * idx[i] + (tree[idx[i]] <= xs[i]);
+    const ind_t first_leaf = ind_t(1) << custom_depth_;
+    const ind_t top = n_bins_ - 1;
+    const bin_t lo = min_;
+    const bin_t hi = max_;
+    for(size_t i=0; i<n; ++i) {
+      const bin_t x = xs[i];
+      const ind_t k = idx[i] - first_leaf;
+      idx[i] = k < top ? k : top;
+      ngt += x > hi;
+      nlt += x < lo;
+    }
+  }
+  else {
+    if (using_log_)
+      for(size_t i=0; i<n; ++i) xs[i] = hist_pdf::histlog(xs[i]);
+    const bin_t lo = min_;
+    const bin_t hi = max_;
+    for(size_t i=0; i<n; ++i) {
+      const bin_t x = xs[i];
+      idx[i] = bin_index_internal(x);
+      ngt += x > hi;
+      nlt += x < lo;
+    }
+  }
+  bin_t bmin, bmax;
+  hist_pdf::block_min_max(xs, n, bmin, bmax);
+  if (using_fast_log_) {
+    bmin = hist_pdf::histlog(bmin);
+    bmax = hist_pdf::histlog(bmax);
+  }
+  hist_pdf::Tally<bin_t> bt;
+  bt.n_counts = n;
+  bt.n_greater_than_max = ngt;
+  bt.n_less_than_min = nlt;
+  bt.data_min = bmin;
+  bt.data_max = bmax;
+  t.merge(bt);
+}
+
+/*
+  Add all samples in [first,last). Gives the same result as calling
+  add_count on each sample, but is much faster for large inputs.
+*/
+template <typename cnt_t, typename bin_t>
+template <typename Iter>
+inline void HistPdf<cnt_t,bin_t>::add_counts(Iter first, Iter last) {
+  hist_pdf::Tally<bin_t> t;
+  add_counts_to_(first, last, counts_.data(), t);
+  merge_tally(t);
+}
+
+// Bin [first,last) into counts, which has our shape, and add to the tallies t
+template <typename cnt_t, typename bin_t>
+template <typename Iter>
+inline void HistPdf<cnt_t,bin_t>::add_counts_to_(Iter first, Iter last, cnt_t *counts,
+                                                 hist_pdf::Tally<bin_t> & t) const {
+  bin_t xs[add_counts_block_size];
+  ind_t idx[add_counts_block_size];
+  while (first != last) {
+    size_t n = 0;
+    for(; n < add_counts_block_size && first != last; ++n, ++first)
+      xs[n] = *first;
+    index_block(xs, n, idx, t);
+    for(size_t i=0; i<n; ++i)
+      ++counts[idx[i]];
+  }
+}
+
+template <typename cnt_t, typename bin_t>
+template <typename Iter>
+inline void HistPdf<cnt_t,bin_t>::add_counts_parallel(Iter first, Iter last, int n_threads) {
+#ifdef _OPENMP
+  const size_t n = last - first;
+  if (n_threads <= 0) n_threads = omp_get_max_threads();
+  // Not worth a thread for less than a few blocks
+  if ((size_t) n_threads > n / (4 * add_counts_block_size))
+    n_threads = n / (4 * add_counts_block_size);
+  if (n_threads <= 1) {
+    add_counts(first, last);
+    return;
+  }
+  std::vector<std::vector<cnt_t> > counts(n_threads);
+  std::vector<hist_pdf::Tally<bin_t> > tallies(n_threads);
+  // The team may be smaller than n_threads, with OMP_THREAD_LIMIT,
+  // OMP_DYNAMIC or nesting, so the slices are cut for the team we get.
+#pragma omp parallel num_threads(n_threads)
+  {
+    const int id = omp_get_thread_num();
+    const int team = omp_get_num_threads();
+    counts[id].assign(n_bins_, 0); // allocated and touched by the thread that uses it
+    add_counts_to_(first + n * id / team, first + n * (id + 1) / team,
+                   counts[id].data(), tallies[id]);
+    // Tree: 0 += 1, 2 += 3, ...; then 0 += 2, ...
+    for(int stride = 1; stride < team; stride *= 2) {
+#pragma omp barrier
+      if (id % (2 * stride) == 0 && id + stride < team) {
+        cnt_t *mine = counts[id].data();
+        const cnt_t *other = counts[id + stride].data();
+        for(size_t i=0; i < n_bins_; ++i) mine[i] += other[i];
+        tallies[id].merge(tallies[id + stride]);
+      }
+    }
+  }
+  for(size_t i=0; i < n_bins_; ++i) counts_[i] += counts[0][i];
+  merge_tally(tallies[0]);
+#else
+  add_counts(first, last);
+#endif
+}
+
+template <typename cnt_t, typename bin_t>
+inline hist_pdf::Tally<bin_t> HistPdf<cnt_t,bin_t>::tally() const {
+  hist_pdf::Tally<bin_t> t;
+  t.n_counts = n_counts_;
+  t.n_greater_than_max = n_greater_than_max_;
+  t.n_less_than_min = n_less_than_min_;
+  t.data_min = data_min_;
+  t.data_max = data_max_;
+  return t;
+}
+
+/*
+  Add tallies of samples that have been binned elsewhere into counts
+  of the same shape as ours.
+*/
+template <typename cnt_t, typename bin_t>
+inline void HistPdf<cnt_t,bin_t>::merge_tally(const hist_pdf::Tally<bin_t> & t) {
+  auto mine = tally();
+  mine.merge(t);
+  n_counts_ = mine.n_counts;
+  n_greater_than_max_ = mine.n_greater_than_max;
+  n_less_than_min_ = mine.n_less_than_min;
+  data_min_ = mine.data_min;
+  data_max_ = mine.data_max;
+  sync_lin_data_min_max_();
+}
+
 template <typename cnt_t, typename bin_t>
 template <typename ...Tail>
 
@@ -339,30 +916,67 @@ void HistPdf<cnt_t,bin_t>::add_count(double head, Tail&&... tail)
   add_count(std::forward<Tail>(tail)...);
 }
 
+// Add the weights w to bins idx, as weight_summation_ says
 template <typename cnt_t, typename bin_t>
-inline void HistPdf<cnt_t,bin_t>::add_weighted_count(bin_t x, cnt_t weight) {
-  auto bin_idx = (int)((x - min_) / width_);
-  if ( bin_idx < 0 ) bin_idx = 0;
-  if ( bin_idx >= (int) counts_.size() ) bin_idx = (int) counts_.size() - 1;
-  counts_[bin_idx] += weight;
-  ++n_counts_;
-  n_weighted_counts_ += weight;
-  if ( n_counts_ == 1 ) {
-    data_min_ = x;
-    data_max_ = x;
+inline void HistPdf<cnt_t,bin_t>::add_weights_(const ind_t *idx, const cnt_t *w, size_t n) {
+  if (sumw2_.size() != n_bins_) sumw2_.assign(n_bins_, 0);
+  cnt_t *sumw2 = sumw2_.data();
+  for(size_t i=0; i<n; ++i)
+    sumw2[idx[i]] += w[i] * w[i];
+  if (weight_summation_ == hist_pdf::naive_summation) {
+    cnt_t *counts = counts_.data();
+    cnt_t total = 0;
+    for(size_t i=0; i<n; ++i) {
+      counts[idx[i]] += w[i];
+      total += w[i];
+    }
+    n_weighted_counts_ += total;
+    return;
   }
-  else {
-    if ( x > data_max_ ) data_max_ = x;
-    if ( x < data_min_ ) data_min_ = x;
+  if (weight_comp_.size() != n_bins_) weight_comp_.assign(n_bins_, 0);
+  cnt_t *counts = counts_.data();
+  cnt_t *comp = weight_comp_.data();
+  for(size_t i=0; i<n; ++i) {
+    hist_pdf::neumaier_add(counts[idx[i]], comp[idx[i]], w[i]);
+    hist_pdf::neumaier_add(n_weighted_counts_, n_weighted_comp_, w[i]);
   }
-  if ( x > max_ ) ++n_greater_than_max_;
-  if ( x < min_ ) ++n_less_than_min_;
+}
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf<cnt_t,bin_t>::add_weighted_count(bin_t x, cnt_t weight) {
+  ind_t idx;
+  hist_pdf::Tally<bin_t> t;
+  index_block(&x, 1, &idx, t);
+  add_weights_(&idx, &weight, 1);
+  merge_tally(t);
+}
+
+template <typename cnt_t, typename bin_t>
+template <typename Iter, typename IterW>
+inline void HistPdf<cnt_t,bin_t>::add_weighted_counts(Iter first, Iter last, IterW wfirst) {
+  bin_t xs[add_counts_block_size];
+  cnt_t ws[add_counts_block_size];
+  ind_t idx[add_counts_block_size];
+  hist_pdf::Tally<bin_t> t;
+  while (first != last) {
+    size_t n = 0;
+    for(; n < add_counts_block_size && first != last; ++n, ++first, ++wfirst) {
+      xs[n] = *first;
+      ws[n] = *wfirst;
+    }
+    index_block(xs, n, idx, t);
+    add_weights_(idx, ws, n);
+  }
+  merge_tally(t);
 }
 
 template <typename cnt_t, typename bin_t>
 inline void HistPdf<cnt_t,bin_t>::clear() {
   n_counts_ = 0;
   n_weighted_counts_ = 0;
+  n_weighted_comp_ = 0;
+  sumw2_.clear();
+  weight_comp_.clear();
   n_greater_than_max_ = 0;
   n_less_than_min_ = 0;
   num_merged_hists_ = 0;
@@ -387,13 +1001,8 @@ inline void HistPdf<cnt_t,bin_t>::fill(Iter begin, Iter stop) {
 template <typename cnt_t, typename bin_t>
 bin_t HistPdf<cnt_t,bin_t>::pdf_integral () const {
   bin_t sum=0;
-  if (using_log_) {
-    for (ind_t i=0; i<n_bins_; ++i)
-      sum += logwidth(i) * pdf(i);
-  }
-  else
-    for (ind_t i=0; i<n_bins_; ++i)
-      sum += width_ * pdf(i);
+  for (ind_t i=0; i<n_bins_; ++i)
+    sum += bin_width(i) * pdf(i);
   return sum;
 }
 
@@ -401,7 +1010,7 @@ template <typename cnt_t, typename bin_t>
 bin_t HistPdf<cnt_t,bin_t>::weighted_pdf_integral () const {
   bin_t sum=0;
   for (ind_t i=0; i<n_bins_; ++i)
-    sum += width_ * weighted_pdf(i);
+    sum += bin_width(i) * weighted_pdf(i);
   return sum;
 }
 
@@ -421,7 +1030,7 @@ inline std::ostream& HistPdf<cnt_t,bin_t>::print_pdf_long_line (std::ostream& ou
                                                          bin_t cent, bin_t pdf) const {
     if ( count > 0 )
       out << log10(cent) << " " << log10(pdf) << " " <<
-        cent << " " << pdf << " " << count << std::endl;
+        cent << " " << pdf << " " << count << "\n";
     return out;
 }
 
@@ -429,7 +1038,7 @@ template <typename cnt_t, typename bin_t>
 std::ostream& HistPdf<cnt_t,bin_t>::print_pdf_long (std::ostream& out) const {
   this->print_pdf_long_header(out);
   for(ind_t i=0; i < counts_.size(); ++i)
-    print_pdf_long_line(out, this->counts_[i], this->center(i), this->pdf(i));
+    print_pdf_long_line(out, this->count(i), this->center(i), this->pdf(i));
   return out;
 }
 
@@ -448,6 +1057,7 @@ inline void HistPdf<cnt_t,bin_t>::print_pdf_header (std::ostream& out) const {
   out << "# num_merged_hists " << num_merged_hists() << "\n";
   out << "# num_trials " << num_trials() << "\n";
   out << "# Log spacing = " << (using_log() ? "true" : "false") << "\n";
+  if ( using_custom_bins() ) out << "# Custom bins = true\n";
   out << "#\n# center pdf counts\n";
   out << "#\n";
 }
@@ -456,16 +1066,31 @@ template <typename cnt_t, typename bin_t>
 inline void HistPdf<cnt_t,bin_t>::print_pdf_line (std::ostream& out, cnt_t count,
                                                            bin_t cent, bin_t pdf) const {
   if ( handle_printing_zeros_ == print_zeros || count > 0 )
-      out <<  cent << " " << pdf << " " << count << std::endl;
+      out <<  cent << " " << pdf << " " << count << "\n";
   else if (handle_printing_zeros_ == print_commented_out_zeros)
-    out <<  "# " << cent << " " << pdf << " " << count << std::endl;
+    out <<  "# " << cent << " " << pdf << " " << count << "\n";
 }
 
 template <typename cnt_t, typename bin_t>
 void HistPdf<cnt_t,bin_t>::print_pdf (std::ostream& out) const {
   this->print_pdf_header(out);
   for(ind_t i=0; i < counts_.size(); ++i)
-    print_pdf_line(out, this->counts_[i], this->center(i), this->pdf(i));
+    print_pdf_line(out, this->count(i), this->center(i), this->pdf(i));
+}
+
+template <typename cnt_t, typename bin_t>
+void HistPdf<cnt_t,bin_t>::format_pdf (TextBuffer& buf) const {
+  std::ostringstream header;
+  this->print_pdf_header(header);
+  buf << header.str();
+  buf.reserve(buf.size() + 64 * counts_.size());
+  for(ind_t i=0; i < counts_.size(); ++i) {
+    const cnt_t count = this->count(i);
+    if ( handle_printing_zeros_ == print_zeros || count > 0 )
+      buf << center(i) << ' ' << pdf(i) << ' ' << count << '\n';
+    else if (handle_printing_zeros_ == print_commented_out_zeros)
+      buf << "# " << center(i) << ' ' << pdf(i) << ' ' << count << '\n';
+  }
 }
 
 template <typename cnt_t, typename bin_t>
@@ -473,9 +1098,12 @@ bool HistPdf<cnt_t,bin_t>::is_same_shape(const HistPdf<cnt_t,bin_t> & other) con
   if ( n_bins() != other.n_bins()
        || using_log() != other.using_log()
        || max() != other.max()
-       || min() != other.min())
+       || min() != other.min()
+       || using_custom_bins() != other.using_custom_bins())
     return false;
-  else return true;
+  if ( using_custom_bins() && custom_bins() != other.custom_bins() )
+    return false;
+  return true;
 }
 
 template <typename cnt_t, typename bin_t>
@@ -504,42 +1132,42 @@ inline void HistPdf<cnt_t,bin_t>::merge(const HistPdf<cnt_t,bin_t>  &other) {
   }
   for(size_t i=0; i<n_bins_; ++i)
     add_to_counts(i,other.count(i));
-  this->n_counts_ += other.n_counts();
-  this->n_greater_than_max_ += other.n_greater_than_max();
+  if (other.has_weights()) add_sum_weights_squared(other.sumw2_.data());
+  n_weighted_counts_ += other.n_weighted_counts();
+  merge_tally(other.tally());
   this->num_trials_ += other.num_trials_;
-  double omin = other.data_min_internal();
-  double omax = other.data_max_internal();
-  if (omin < this->data_min()) this->data_min_ = omin;
-  if (omax > this->data_max()) this->data_max_ = omax;
   ++num_merged_hists_;
 }
 
+/*
+  With custom bins in use, this is custom_bin_index. Otherwise, bisect
+  the edges set so far with set_bin_val.
+*/
 template <typename cnt_t, typename bin_t>
-inline size_t HistPdf<cnt_t,bin_t>::find_index(bin_t x) {
+inline size_t HistPdf<cnt_t,bin_t>::find_index(bin_t x) const {
+  if (using_custom_bins_) return custom_bin_index(x);
   size_t upper = n_bins_ ;
   size_t lower = 0 ;
-
-  while (upper - lower > 1)
-    {
-      size_t mid = (upper + lower) / 2 ;
-      //      std::cerr << mid << "\n";
-      //      std::cerr << " val " << bins_[mid] << "\n";
-      if (x >= custom_bins_[mid])
-        {
-          lower = mid ;
-        }
-      else
-        {
-          upper = mid ;
-        }
-    }
-  std::cerr << lower << "\n";
+  while (upper - lower > 1) {
+    size_t mid = (upper + lower) / 2 ;
+    if (x >= custom_bins_[mid])
+      lower = mid ;
+    else
+      upper = mid ;
+  }
   return lower;
 }
 
 template <typename cnt_t, typename bin_t>
 inline void HistPdf<cnt_t,bin_t>::set_bin_val(size_t idx, bin_t r) {
   custom_bins_[idx] = r;
+  if (using_custom_bins_) {
+    lin_min_ = min_ = custom_bins_.front();
+    lin_max_ = max_ = custom_bins_.back();
+    width_ = (max_ - min_) / n_bins_;
+    inv_width_ = 1 / width_;
+    make_custom_tree_();
+  }
 }
 
 } /*** END namespace gjl */
@@ -0,0 +1,341 @@
+// -*-c++-*-
+#ifndef HIST_PDF_2D_H
+#define HIST_PDF_2D_H
+
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <gjl/hist_pdf.h>
+#include <gjl/text_buffer.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+  class gjl::HistPdf2D -- 2-d histogram and probability density.
+
+  gjl::HistPdf2D<> hist(100, -50, 50, 100, -50, 50);
+  hist.add_count(x, y);
+  hist.add_counts(xs.begin(), xs.end(), ys.begin()); // pairs (xs[i], ys[i])
+  hist.print_pdf(out);
+  hist.to_image(image);  // a gjl::image::DataImage heat map
+
+  Each axis is a HistPdf<double,bin_t> whose counts are not used, and
+  bins with its index_block: linear or log10 spacing, and samples out
+  of range go to the first or last bin and are tallied. Counts are stored
+  row major, x slow and y fast, as in gjl::Vector2D: count(i,j) is
+  counts()[i * n_bins_y() + j].
+
+  add_counts finds the indices of a block of samples before incrementing
+  any count, as in HistPdf. add_counts_parallel gives each thread its own
+  counts and adds them in a tree.
+
+  print_pdf writes a header in the style of HistPdf, then a line
+  "center_x center_y pdf counts" per bin, with a blank line after each
+  row of x, for gnuplot's splot. The zero printing modes are those of
+  HistPdf.
+*/
+
+namespace gjl {
+
+template <typename cnt_t = double, typename bin_t = double>
+class HistPdf2D {
+public:
+  typedef HistPdf<double,bin_t> axis_t;  // only the shape is used
+  typedef hist_pdf::Tally<bin_t> tally_t;
+
+  HistPdf2D() {}
+  HistPdf2D(size_t nx, bin_t xmin, bin_t xmax, size_t ny, bin_t ymin, bin_t ymax,
+            bool xlog = false, bool ylog = false) {
+    init(nx, xmin, xmax, ny, ymin, ymax, xlog, ylog);
+  }
+  inline void init(size_t nx, bin_t xmin, bin_t xmax, size_t ny, bin_t ymin, bin_t ymax,
+                   bool xlog = false, bool ylog = false);
+  inline void clear();
+
+  inline void add_count(bin_t x, bin_t y);
+  // Add the pairs (*xfirst, *yfirst), ... for all of [xfirst,xlast)
+  template <typename IterX, typename IterY>
+  inline void add_counts(IterX xfirst, IterX xlast, IterY yfirst);
+  template <typename IterX, typename IterY>
+  inline void add_counts_parallel(IterX xfirst, IterX xlast, IterY yfirst, int n_threads = 0);
+
+  inline bool is_same_shape(const HistPdf2D<cnt_t,bin_t>& other) const {
+    return x_.is_same_shape(other.x_) && y_.is_same_shape(other.y_);
+  }
+  inline void merge(const HistPdf2D<cnt_t,bin_t>& other);
+  inline bool operator==(const HistPdf2D<cnt_t,bin_t>& other) const {
+    return is_same_shape(other) && counts_ == other.counts_;
+  }
+  inline bool operator!=(const HistPdf2D<cnt_t,bin_t>& other) const { return ! (*this == other); }
+
+  inline size_t n_bins_x() const { return x_.n_bins(); }
+  inline size_t n_bins_y() const { return y_.n_bins(); }
+  inline const axis_t& x_axis() const { return x_; }
+  inline const axis_t& y_axis() const { return y_; }
+  inline bool using_log_x() const { return x_.using_log(); }
+  inline bool using_log_y() const { return y_.using_log(); }
+  inline size_t n_counts() const { return tx_.n_counts; }
+  // Tallies of each coordinate. Data min and max are in the binning coordinate.
+  inline const tally_t& x_tally() const { return tx_; }
+  inline const tally_t& y_tally() const { return ty_; }
+  inline bin_t data_min_x() const { return x_.from_internal(tx_.data_min); }
+  inline bin_t data_max_x() const { return x_.from_internal(tx_.data_max); }
+  inline bin_t data_min_y() const { return y_.from_internal(ty_.data_min); }
+  inline bin_t data_max_y() const { return y_.from_internal(ty_.data_max); }
+
+  inline cnt_t count(size_t i, size_t j) const { return counts_[i * y_.n_bins() + j]; }
+  inline const std::vector<cnt_t>& counts() const { return counts_; }
+  inline cnt_t * counts_data() { return counts_.data(); }
+  inline bin_t center_x(size_t i) const { return x_.center(i); }
+  inline bin_t center_y(size_t j) const { return y_.center(j); }
+  inline bin_t pdf(size_t i, size_t j) const {
+    return count(i,j) / (n_counts() * x_.bin_width(i) * y_.bin_width(j));
+  }
+  inline cnt_t max_count() const {
+    cnt_t m = 0;
+    for(size_t k=0; k < counts_.size(); ++k) m = counts_[k] > m ? counts_[k] : m;
+    return m;
+  }
+
+  inline size_t num_merged_hists() const { return num_merged_hists_; }
+  inline void increment_num_trials() { ++num_trials_; }
+  inline size_t num_trials() const { return num_trials_; }
+
+  inline void zero_printing_off() { handle_printing_zeros_ = do_not_print_zeros; }
+  inline void zero_printing_on() { handle_printing_zeros_ = print_zeros; }
+  inline void zero_printing_commented() { handle_printing_zeros_ = print_commented_out_zeros; }
+
+  inline void print_pdf_header(std::ostream& out) const;
+  inline void format_pdf(TextBuffer& buf) const;
+  inline void print_pdf(std::ostream& out = std::cout) const {
+    TextBuffer buf;
+    format_pdf(buf);
+    buf.write(out);
+  }
+  inline bool write_pdf(const std::string& filename) const {
+    TextBuffer buf(48 * counts_.size() + 1024);
+    format_pdf(buf);
+    return buf.write_file(filename);
+  }
+
+  /*
+    Heat map of the counts. image_t is gjl::image::DataImage, or a class
+    like it. Pixel (i, n_bins_y() - 1 - j) is bin (i,j), so y is up. The
+    hue is scaled to the largest count, or to its log with log_scale,
+    and empty bins are black.
+  */
+  template <typename image_t>
+  inline void to_image(image_t& image, bool log_scale = false) const;
+
+private:
+  typedef typename axis_t::ind_t ind_t;
+  static const size_t block_size = axis_t::add_counts_block_size;
+
+  axis_t x_;
+  axis_t y_;
+  std::vector<cnt_t> counts_;
+  tally_t tx_;
+  tally_t ty_;
+  size_t num_merged_hists_ = 0;
+  size_t num_trials_ = 0;
+
+  enum handle_printing_zeros_t { print_zeros, do_not_print_zeros, print_commented_out_zeros };
+  handle_printing_zeros_t handle_printing_zeros_ = do_not_print_zeros;
+
+  template <typename IterX, typename IterY>
+  inline void add_counts_to_(IterX xfirst, IterX xlast, IterY yfirst, cnt_t *counts,
+                             tally_t& tx, tally_t& ty) const;
+}; /*** END class HistPdf2D */
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf2D<cnt_t,bin_t>::init(size_t nx, bin_t xmin, bin_t xmax,
+                                         size_t ny, bin_t ymin, bin_t ymax, bool xlog, bool ylog) {
+  x_ = axis_t(nx, xmin, xmax, xlog);
+  y_ = axis_t(ny, ymin, ymax, ylog);
+  counts_.assign(nx * ny, 0);
+  clear();
+  num_merged_hists_ = 0;
+  num_trials_ = 0;
+}
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf2D<cnt_t,bin_t>::clear() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  tx_ = tally_t();
+  ty_ = tally_t();
+}
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf2D<cnt_t,bin_t>::add_count(bin_t x, bin_t y) {
+  ind_t ix, iy;
+  x_.index_block(&x, 1, &ix, tx_);
+  y_.index_block(&y, 1, &iy, ty_);
+  ++counts_[ix * y_.n_bins() + iy];
+}
+
+template <typename cnt_t, typename bin_t>
+template <typename IterX, typename IterY>
+inline void HistPdf2D<cnt_t,bin_t>::add_counts_to_(IterX xfirst, IterX xlast, IterY yfirst,
+                                                   cnt_t *counts, tally_t& tx, tally_t& ty) const {
+  bin_t xs[block_size];
+  bin_t ys[block_size];
+  ind_t ix[block_size];
+  ind_t iy[block_size];
+  const size_t ny = y_.n_bins();
+  while (xfirst != xlast) {
+    size_t n = 0;
+    for(; n < block_size && xfirst != xlast; ++n, ++xfirst, ++yfirst) {
+      xs[n] = *xfirst;
+      ys[n] = *yfirst;
+    }
+    x_.index_block(xs, n, ix, tx);
+    y_.index_block(ys, n, iy, ty);
+    for(size_t i=0; i < n; ++i)
+      ++counts[ix[i] * ny + iy[i]];
+  }
+}
+
+template <typename cnt_t, typename bin_t>
+template <typename IterX, typename IterY>
+inline void HistPdf2D<cnt_t,bin_t>::add_counts(IterX xfirst, IterX xlast, IterY yfirst) {
+  add_counts_to_(xfirst, xlast, yfirst, counts_.data(), tx_, ty_);
+}
+
+/*
+  As HistPdf::add_counts_parallel. The iterators must be random access.
+  The result is the same as add_counts for any number of threads.
+*/
+template <typename cnt_t, typename bin_t>
+template <typename IterX, typename IterY>
+inline void HistPdf2D<cnt_t,bin_t>::add_counts_parallel(IterX xfirst, IterX xlast, IterY yfirst,
+                                                        int n_threads) {
+#ifdef _OPENMP
+  const size_t n = xlast - xfirst;
+  if (n_threads <= 0) n_threads = omp_get_max_threads();
+  if ((size_t) n_threads > n / (4 * block_size))
+    n_threads = n / (4 * block_size);
+  if (n_threads <= 1) {
+    add_counts(xfirst, xlast, yfirst);
+    return;
+  }
+  const size_t nbins = counts_.size();
+  std::vector<std::vector<cnt_t> > counts(n_threads);
+  std::vector<tally_t> tx(n_threads), ty(n_threads);
+  // Slices are cut for the team we get, which may be smaller than n_threads
+#pragma omp parallel num_threads(n_threads)
+  {
+    const int id = omp_get_thread_num();
+    const int team = omp_get_num_threads();
+    counts[id].assign(nbins, 0);
+    const size_t first = n * id / team;
+    add_counts_to_(xfirst + first, xfirst + n * (id + 1) / team, yfirst + first,
+                   counts[id].data(), tx[id], ty[id]);
+    for(int stride = 1; stride < team; stride *= 2) {
+#pragma omp barrier
+      if (id % (2 * stride) == 0 && id + stride < team) {
+        cnt_t *mine = counts[id].data();
+        const cnt_t *other = counts[id + stride].data();
+        for(size_t i=0; i < nbins; ++i) mine[i] += other[i];
+        tx[id].merge(tx[id + stride]);
+        ty[id].merge(ty[id + stride]);
+      }
+    }
+  }
+  for(size_t i=0; i < nbins; ++i) counts_[i] += counts[0][i];
+  tx_.merge(tx[0]);
+  ty_.merge(ty[0]);
+#else
+  (void) n_threads;
+  add_counts(xfirst, xlast, yfirst);
+#endif
+}
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf2D<cnt_t,bin_t>::merge(const HistPdf2D<cnt_t,bin_t>& other) {
+  if (! is_same_shape(other)) {
+    std::cerr << "*** hist_pdf_2d: cannot merge histograms of different shapes.\n";
+    abort();
+  }
+  for(size_t i=0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+  tx_.merge(other.tx_);
+  ty_.merge(other.ty_);
+  num_trials_ += other.num_trials_;
+  ++num_merged_hists_;
+}
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf2D<cnt_t,bin_t>::print_pdf_header(std::ostream& out) const {
+  out << "####  2D Histogram\n";
+  out << "# Ncounts " << n_counts() << "\n";
+  out << "# Min data x " << data_min_x() << "\n";
+  out << "# Max data x " << data_max_x() << "\n";
+  out << "# Min data y " << data_min_y() << "\n";
+  out << "# Max data y " << data_max_y() << "\n";
+  out << "# Min bin x " << x_.init_min() << "\n";
+  out << "# Max bin x " << x_.init_max() << "\n";
+  out << "# Nbins x " << x_.n_bins() << "\n";
+  out << "# Min bin y " << y_.init_min() << "\n";
+  out << "# Max bin y " << y_.init_max() << "\n";
+  out << "# Nbins y " << y_.n_bins() << "\n";
+  out << "# n greater than max x " << tx_.n_greater_than_max << "\n";
+  out << "# n less than min x " << tx_.n_less_than_min << "\n";
+  out << "# n greater than max y " << ty_.n_greater_than_max << "\n";
+  out << "# n less than min y " << ty_.n_less_than_min << "\n";
+  out << "# num_merged_hists " << num_merged_hists() << "\n";
+  out << "# num_trials " << num_trials() << "\n";
+  out << "# Log spacing x = " << (x_.using_log() ? "true" : "false") << "\n";
+  out << "# Log spacing y = " << (y_.using_log() ? "true" : "false") << "\n";
+  out << "#\n# center_x center_y pdf counts\n";
+  out << "#\n";
+}
+
+template <typename cnt_t, typename bin_t>
+inline void HistPdf2D<cnt_t,bin_t>::format_pdf(TextBuffer& buf) const {
+  std::ostringstream header;
+  print_pdf_header(header);
+  buf << header.str();
+  buf.reserve(buf.size() + 48 * counts_.size());
+  std::vector<bin_t> cy(y_.n_bins());
+  for(size_t j=0; j < y_.n_bins(); ++j) cy[j] = y_.center(j);
+  for(size_t i=0; i < x_.n_bins(); ++i) {
+    const bin_t cx = x_.center(i);
+    for(size_t j=0; j < y_.n_bins(); ++j) {
+      const cnt_t c = count(i,j);
+      if ( handle_printing_zeros_ == print_zeros || c > 0 )
+        buf << cx << ' ' << cy[j] << ' ' << pdf(i,j) << ' ' << c << '\n';
+      else if (handle_printing_zeros_ == print_commented_out_zeros)
+        buf << "# " << cx << ' ' << cy[j] << ' ' << pdf(i,j) << ' ' << c << '\n';
+    }
+    buf << '\n';
+  }
+}
+
+template <typename cnt_t, typename bin_t>
+template <typename image_t>
+inline void HistPdf2D<cnt_t,bin_t>::to_image(image_t& image, bool log_scale) const {
+  const size_t nx = x_.n_bins();
+  const size_t ny = y_.n_bins();
+  image.set_dims(ny, nx);
+  const double m = max_count();
+  image.set_max_trans_val(log_scale ? std::log1p(m) : m);
+  for(size_t i=0; i < nx; ++i)
+    for(size_t j=0; j < ny; ++j) {
+      const double c = count(i,j);
+      if (c > 0) image.set_pixel_hue_scaled_data(i, ny - 1 - j, log_scale ? std::log1p(c) : c);
+      else image.set_pixel_grey(i, ny - 1 - j, 0);
+    }
+}
+
+} /*** END namespace gjl */
+
+#endif
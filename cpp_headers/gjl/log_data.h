@@ -0,0 +1,217 @@
+// -*-c++-*-
+#ifndef LOG_DATA_H
+#define LOG_DATA_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gjl/text_buffer.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+  gjl::log_data -- take log10 of the numbers in a text data file, as
+  scripts/log_data_file does. Used by tools_src/gjl_log_data_file.
+
+  gjl::log_data::LogTransform lt;
+  lt.set_linear(cols);                  // 0-based columns to copy as read
+  lt.transform(text, text + n, buf);    // appends to the TextBuffer buf
+
+  A line whose fields, separated by white space, all look like numbers
+  to Perl is written as the log10 of each field, separated by single
+  spaces and ended by a newline. Empty lines are such lines, too. Any
+  other line is copied as is. Logs are written as Perl prints numbers:
+  "%.15g", with Inf, -Inf and NaN spelled as Perl spells them.
+
+  parse_number accepts what Perl's looks_like_number accepts in a
+  field: decimal numbers with optional sign, fraction and exponent, and
+  inf, infinity and nan in any case. It converts digits and exponent
+  exactly when it can (Clinger's fast path), and calls strtod otherwise.
+
+  transform works on many lines at a time. It parses all their numbers
+  into an array, takes the logs in one plain loop, which the compiler
+  may vectorize, and then formats the lines.
+*/
+
+namespace gjl {
+namespace log_data {
+
+  inline bool is_space (char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+
+  // s, of length n, equals lower-case word w, ignoring case
+  inline bool equal_nocase (const char *s, size_t n, const char *w) {
+    if (strlen(w) != n) return false;
+    for(size_t i=0; i < n; ++i)
+      if ((s[i] | 0x20) != w[i]) return false;
+    return true;
+  }
+
+  inline bool parse_number (const char *b, const char *e, double& x) {
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char *p = b;
+    bool neg = false;
+    if (p < e && (*p == '+' || *p == '-')) neg = *p++ == '-';
+    if (p < e && ! (*p >= '0' && *p <= '9') && *p != '.') {
+      const size_t n = e - p;
+      if (equal_nocase(p, n, "inf") || equal_nocase(p, n, "infinity")) x = HUGE_VAL;
+      else if (equal_nocase(p, n, "nan") || equal_nocase(p, n, "nanq") || equal_nocase(p, n, "nans")) x = NAN;
+      else return false;
+      if (neg) x = -x;
+      return true;
+    }
+    uint64_t m = 0;
+    int n_digits = 0, exp10 = 0;
+    bool any_digit = false;
+    for(; p < e && *p >= '0' && *p <= '9'; ++p) {
+      any_digit = true;
+      if (n_digits < 19) {
+        m = 10 * m + (*p - '0');
+        if (m != 0) ++n_digits;
+      }
+      else {
+        ++exp10;
+        ++n_digits;
+      }
+    }
+    if (p < e && *p == '.') {
+      for(++p; p < e && *p >= '0' && *p <= '9'; ++p) {
+        any_digit = true;
+        if (n_digits < 19) {
+          m = 10 * m + (*p - '0');
+          --exp10;
+          if (m != 0) ++n_digits;
+        }
+        else ++n_digits;
+      }
+    }
+    if (! any_digit) return false;
+    if (p < e && (*p == 'e' || *p == 'E')) {
+      ++p;
+      bool eneg = false;
+      if (p < e && (*p == '+' || *p == '-')) eneg = *p++ == '-';
+      if (p == e || ! (*p >= '0' && *p <= '9')) return false;
+      int ex = 0;
+      for(; p < e && *p >= '0' && *p <= '9'; ++p)
+        if (ex < 100000) ex = 10 * ex + (*p - '0');
+      exp10 += eneg ? -ex : ex;
+    }
+    if (p != e) return false;
+    if (n_digits <= 19 && m <= ((uint64_t) 1 << 53) && exp10 >= -22 && exp10 <= 22) {
+      x = exp10 >= 0 ? (double) m * pow10[exp10] : (double) m / pow10[-exp10];
+      if (neg) x = -x;
+      return true;
+    }
+    char tmp[64];
+    const size_t n = e - b;
+    if (n < sizeof(tmp)) {
+      memcpy(tmp, b, n);
+      tmp[n] = 0;
+      x = strtod(tmp, nullptr);
+    }
+    else x = strtod(std::string(b, e).c_str(), nullptr);
+    return true;
+  }
+
+  inline void put_perl_number (TextBuffer& out, double x) {
+    if (std::isnan(x)) out << "NaN";
+    else if (std::isinf(x)) out << (x > 0 ? "Inf" : "-Inf");
+    else out << x;
+  }
+
+  class LogTransform {
+  public:
+    // 0-based column numbers to copy as read, rather than take the log of
+    inline void set_linear(const std::vector<int>& cols) {
+      linear_.clear();
+      for(size_t i=0; i < cols.size(); ++i) {
+        if (cols[i] < 0) continue;
+        if ((size_t) cols[i] >= linear_.size()) linear_.resize(cols[i] + 1, 0);
+        linear_[cols[i]] = 1;
+      }
+    }
+    inline void transform(const char *b, const char *e, TextBuffer& out);
+
+  private:
+    struct field { const char *b, *e; };
+    struct line { const char *b, *e; size_t first, n; bool numeric; };
+    std::vector<char> linear_;
+    std::vector<field> fields_;
+    std::vector<double> vals_;
+    std::vector<line> lines_;
+
+    inline bool is_linear_(size_t col) const { return col < linear_.size() && linear_[col]; }
+    inline void flush_(TextBuffer& out);
+  }; /*** END class LogTransform */
+
+  inline void LogTransform::transform(const char *b, const char *e, TextBuffer& out) {
+    const size_t batch_fields = 4096;
+    out.precision(15);
+    fields_.clear();
+    vals_.clear();
+    lines_.clear();
+    while (b < e) {
+      const char *nl = (const char *) memchr(b, '\n', e - b);
+      const char *le = nl ? nl + 1 : e;
+      line ln = { b, le, fields_.size(), 0, true };
+      const char *p = b;
+      while (true) {
+        while (p < le && is_space(*p)) ++p;
+        if (p == le) break;
+        const char *fb = p;
+        while (p < le && ! is_space(*p)) ++p;
+        double x;
+        if (! parse_number(fb, p, x)) {
+          ln.numeric = false;
+          break;
+        }
+        fields_.push_back(field{fb, p});
+        vals_.push_back(x);
+      }
+      if (! ln.numeric) {
+        fields_.resize(ln.first);
+        vals_.resize(ln.first);
+      }
+      else ln.n = fields_.size() - ln.first;
+      lines_.push_back(ln);
+      if (fields_.size() >= batch_fields) flush_(out);
+      b = le;
+    }
+    flush_(out);
+  }
+
+  inline void LogTransform::flush_(TextBuffer& out) {
+    double *v = vals_.data();
+    const size_t nv = vals_.size();
+    for(size_t i=0; i < nv; ++i) v[i] = log10(v[i]);
+    for(size_t k=0; k < lines_.size(); ++k) {
+      const line& ln = lines_[k];
+      if (! ln.numeric) {
+        out.put(ln.b, ln.e - ln.b);
+        continue;
+      }
+      for(size_t j=0; j < ln.n; ++j) {
+        if (j > 0) out << ' ';
+        if (is_linear_(j)) out.put(fields_[ln.first + j].b, fields_[ln.first + j].e - fields_[ln.first + j].b);
+        else put_perl_number(out, v[ln.first + j]);
+      }
+      out << '\n';
+    }
+    fields_.clear();
+    vals_.clear();
+    lines_.clear();
+  }
+
+} /*** END namespace log_data */
+} /*** END namespace gjl */
+
+#endif
@@ -14,11 +14,18 @@
  * class gjl::LogSpace -- make a virtual array of values separated
  * by a constant factor. The log of the values are then separated by
  * a constant term.
- * It is a virtual array in the sense that the values are not stored, but
- * rather operator[] is overloaded to compute the required value.
+ * It is a virtual array in the sense that operator[] is overloaded to
+ * give the required value.
  *
+ * The values xa * fac^(i - lowest_index) are computed with pow once, in
+ * init(), and kept in a table, so operator[] is a load. The table holds
+ * exactly what pow gives, so the grid is the same as when each value was
+ * computed on demand. Indices outside the grid are still computed.
  */
 
+#include <cmath>
+#include <vector>
+
 namespace gjl {
 
   template< typename data_t = double>
@@ -39,16 +46,26 @@ namespace gjl {
     inline ind_t highest_index() const  {return highest_index_; }
 
     inline uint_t number_of_elements() const {return number_of_elements_;}
+    inline data_t xa() const {return xa_;}
+    inline data_t xb() const {return xb_;}
 
     inline void set_lowest_index_fixed_n(ind_t i) { lowest_index_ = i;}
     inline void set_num_elements_fixed_lowest_index(uint_t n) { number_of_elements_ = n; init();}
     inline void set_highest_index_fixed_lowest_index(ind_t ihigh) { number_of_elements_ = ihigh - lowest_index_ + 1; init();}
 
-    inline void init() {set_fac(); save_highest_index();}
+    inline void init() {set_fac(); save_highest_index(); make_table();}
 
     inline void set_fac() { fac_ = pow((xb_ / xa_), 1.0/(number_of_elements_- 1));}
+    inline data_t fac() const {return fac_;}
+
+    // The value, computed rather than looked up
+    inline data_t compute_val(ind_t i) const {return xa_ * pow(fac_, i - lowest_index_);}
 
-    inline data_t val(ind_t i) const {return xa_ * pow(fac_, i - lowest_index_);}
+    inline data_t val(ind_t i) const {
+      const ind_t k = i - lowest_index_;
+      if (k >= 0 && k < (ind_t) table_.size()) return table_[k];
+      return compute_val(i);
+    }
 
     inline data_t operator[] (ind_t i) const {return val(i);}
 
@@ -59,6 +76,12 @@ namespace gjl {
     ind_t number_of_elements_ = 0;
     ind_t lowest_index_ = 0;
     ind_t highest_index_ = 0; // store, because this may be called in tight loops. not worth the complexity!
+    std::vector<data_t> table_; // table_[k] is the value at index lowest_index_ + k
+
+    inline void make_table() {
+      table_.resize(number_of_elements_ > 0 ? number_of_elements_ : 0);
+      for(ind_t k=0; k < (ind_t) table_.size(); ++k) table_[k] = xa_ * pow(fac_, k);
+    }
 
   }; /*** END class LogSpace */
 
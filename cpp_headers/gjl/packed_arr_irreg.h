@@ -0,0 +1,227 @@
+// -*-c++-*-
+#ifndef PACKED_ARR_IRREG_H
+#define PACKED_ARR_IRREG_H
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <gjl/log_space.h>
+#include <gjl/arr_irreg.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+ * class PackedArrIrreg -- ArrIrreg with the sum and count of each time
+ * side by side, for recording many walkers and merging many copies.
+ *
+ * PackedArrIrreg<> arr(1, 1e6, 300);
+ * ARR_IRREG_CHECK_RECORD(arr, t, v);           // as for ArrIrreg
+ * arr.record_stream(ts, ts + n, vs);           // one whole walk
+ * arr.record_streams(ts, vs, n_walkers, n);    // many, in parallel
+ * PackedArrIrreg<>::merge_tree(parts);         // parts[0] gets the total
+ * arr.to_arr_irreg(a);                         // for printing, result_file, ...
+ *
+ * A walk is a sequence of (time, value) with times increasing. At each
+ * grid time the value recorded is that at the first step whose time is
+ * at least the grid time, as ARR_IRREG_CHECK_RECORD does. record_stream
+ * finds these in one pass over the walk and the grid, and leaves the
+ * cursor of the single record interface alone.
+ *
+ * record_streams takes the walks of n_walkers walkers, each n_steps
+ * long, walker after walker. Each thread records into its own copy, and
+ * the copies are combined by merge_tree. With T threads, each adds P / T
+ * copies into one, and those T are added in pairs in log2 T rounds, so
+ * combining P copies is not a serial chain of P - 1 merges. merge is one
+ * loop over the cells.
+ */
+
+template <typename data_t = double>
+class PackedArrIrreg {
+public:
+  // count is a data_t, so that a cell is two like words. It is exact up to
+  // 2^digits counts: 2^53 for double, but only 2^24 for float.
+  struct cell { data_t sum; data_t count; };
+
+  PackedArrIrreg() {}
+  PackedArrIrreg(data_t xa, data_t xb, size_t n) { set_xa_xb_n(xa,xb,n); }
+  inline void set_xa_xb_n(data_t xa, data_t xb, size_t n) { time_.set_xa_xb_n(xa,xb,n); init_arr();}
+  inline void init_arr() {
+    cells_.assign(number_of_elements(), cell{0, 0});
+    index_ = 0;
+    set_next_time_();
+  }
+  inline void clear() { init_arr(); }
+
+  inline int number_of_elements() const {return time_.number_of_elements();}
+  inline const gjl::LogSpace<data_t>& time() const { return time_;}
+  inline data_t get_time(int i) const {return time_[i];}
+  inline data_t arrsum(int i) const { return cells_[i].sum;}
+  inline size_t counts(int i) const { return (size_t) cells_[i].count;}
+  inline data_t get_arr(int i) const { return cells_[i].count > 0 ? cells_[i].sum / cells_[i].count : 0;}
+  inline const cell * data() const { return cells_.data();}
+
+  // The single record interface, as in ArrIrreg
+  inline void reset_index() { index_ = 0; set_next_time_();}
+  inline data_t get_next_time() const {return time_[index_];}
+  inline data_t next_threshold() const {return next_time_;}
+  inline bool over_max_ind() const { return index_ >= number_of_elements(); }
+  inline void record_arr(data_t val) {
+    cell& c = cells_[index_++];
+    c.sum += val;
+    ++c.count;
+    set_next_time_();
+  }
+
+  template <typename Itert, typename Iterv>
+  inline void record_stream(Itert tfirst, Itert tlast, Iterv vfirst);
+  inline void record_streams(const data_t *times, const data_t *values, size_t n_walkers, size_t n_steps,
+                             int n_threads = 0);
+
+  inline bool is_same_shape(const PackedArrIrreg<data_t>& other) const {
+    return number_of_elements() == other.number_of_elements() && time_.xa() == other.time_.xa()
+      && time_.xb() == other.time_.xb();
+  }
+  inline void merge(const PackedArrIrreg<data_t>& other);
+  inline void operator+=(const PackedArrIrreg<data_t>& other) { merge(other); }
+  // Merge all of parts into parts[0], in parallel
+  static inline void merge_tree(std::vector<PackedArrIrreg<data_t> >& parts, int n_threads = 0);
+
+  inline void to_arr_irreg(ArrIrreg<data_t>& arr) const;
+  inline void merge_arr_irreg(const ArrIrreg<data_t>& arr);
+
+private:
+  std::vector<cell> cells_;
+  gjl::LogSpace<data_t> time_;
+  int index_ = 0;
+  data_t next_time_ = 0;
+
+  inline void set_next_time_() {
+    next_time_ = over_max_ind() ? (std::numeric_limits<data_t>::has_infinity ?
+                                   std::numeric_limits<data_t>::infinity() : std::numeric_limits<data_t>::max())
+      : time_[index_];
+  }
+}; /*** END class PackedArrIrreg */
+
+template <typename data_t>
+template <typename Itert, typename Iterv>
+inline void PackedArrIrreg<data_t>::record_stream(Itert tfirst, Itert tlast, Iterv vfirst) {
+  const int n = number_of_elements();
+  if (n == 0) return;
+  cell *c = cells_.data();
+  int k = 0;
+  data_t next = time_[0];
+  for(; tfirst != tlast; ++tfirst, ++vfirst) {
+    const data_t curtime = *tfirst + 1e-10;
+    if (curtime < next) continue;
+    const data_t v = *vfirst;
+    do {
+      c[k].sum += v;
+      ++c[k].count;
+      if (++k == n) return;
+      next = time_[k];
+    } while (curtime >= next);
+  }
+}
+
+template <typename data_t>
+inline void PackedArrIrreg<data_t>::record_streams(const data_t *times, const data_t *values,
+                                                   size_t n_walkers, size_t n_steps, int n_threads) {
+#ifdef _OPENMP
+  if (n_threads <= 0) n_threads = omp_get_max_threads();
+#else
+  n_threads = 1;
+#endif
+  if (n_threads == 1 || n_walkers < 2) {
+    for(size_t w=0; w < n_walkers; ++w)
+      record_stream(times + w * n_steps, times + (w + 1) * n_steps, values + w * n_steps);
+    return;
+  }
+  std::vector<PackedArrIrreg<data_t> > parts(n_threads, *this);
+  for(size_t j=1; j < parts.size(); ++j) parts[j].clear();
+#pragma omp parallel for num_threads(n_threads) schedule(static)
+  for(int j=0; j < n_threads; ++j) {
+    const size_t lo = n_walkers * j / n_threads, hi = n_walkers * (j + 1) / n_threads;
+    for(size_t w=lo; w < hi; ++w)
+      parts[j].record_stream(times + w * n_steps, times + (w + 1) * n_steps, values + w * n_steps);
+  }
+  merge_tree(parts, n_threads);
+  cells_.swap(parts[0].cells_);
+}
+
+template <typename data_t>
+inline void PackedArrIrreg<data_t>::merge(const PackedArrIrreg<data_t>& other) {
+  if (! is_same_shape(other)) {
+    std::cerr << "*** packed_arr_irreg: cannot merge arrays of different shapes.\n";
+    abort();
+  }
+  data_t *a = &cells_.data()->sum;
+  const data_t *b = &other.cells_.data()->sum;
+  const size_t n = 2 * cells_.size();
+  for(size_t i=0; i < n; ++i) a[i] += b[i];
+}
+
+/*
+  Each thread adds a contiguous run of parts into the first of the run,
+  which stays in cache. Then the runs are added in pairs, in log2 rounds.
+*/
+template <typename data_t>
+inline void PackedArrIrreg<data_t>::merge_tree(std::vector<PackedArrIrreg<data_t> >& parts, int n_threads) {
+#ifdef _OPENMP
+  if (n_threads <= 0) n_threads = omp_get_max_threads();
+#else
+  n_threads = 1;
+#endif
+  const size_t n = parts.size();
+  const size_t n_runs = std::min((size_t) n_threads, n);
+  if (n_runs == 0) return;
+  std::vector<size_t> first(n_runs + 1);
+  for(size_t r=0; r <= n_runs; ++r) first[r] = n * r / n_runs;
+#pragma omp parallel for num_threads(n_threads) schedule(static) if(n_runs > 1)
+  for(long r=0; r < (long) n_runs; ++r)
+    for(size_t j = first[r] + 1; j < first[r+1]; ++j) parts[first[r]].merge(parts[j]);
+  for(size_t stride=1; stride < n_runs; stride *= 2) {
+    const long n_pairs = (long) ((n_runs - stride + 2 * stride - 1) / (2 * stride));
+#pragma omp parallel for num_threads(n_threads) schedule(static) if(n_pairs > 1)
+    for(long p=0; p < n_pairs; ++p) {
+      const size_t r = p * 2 * stride;
+      if (r + stride < n_runs) parts[first[r]].merge(parts[first[r + stride]]);
+    }
+  }
+}
+
+template <typename data_t>
+inline void PackedArrIrreg<data_t>::to_arr_irreg(ArrIrreg<data_t>& arr) const {
+  arr.set_xa_xb_n(time_.xa(), time_.xb(), number_of_elements());
+  data_t *sums = arr.arrsum_data();
+  size_t *counts = arr.counts_data();
+  for(int i=0; i < number_of_elements(); ++i) {
+    sums[i] = cells_[i].sum;
+    counts[i] = (size_t) cells_[i].count;
+  }
+}
+
+template <typename data_t>
+inline void PackedArrIrreg<data_t>::merge_arr_irreg(const ArrIrreg<data_t>& arr) {
+  if (arr.number_of_elements() != number_of_elements() || arr.time().xa() != time_.xa()
+      || arr.time().xb() != time_.xb()) {
+    std::cerr << "*** packed_arr_irreg: cannot merge arrays of different shapes.\n";
+    abort();
+  }
+  const data_t *sums = arr.arrsum_data();
+  const size_t *counts = arr.counts_data();
+  for(int i=0; i < number_of_elements(); ++i) {
+    cells_[i].sum += sums[i];
+    cells_[i].count += counts[i];
+  }
+}
+
+#endif
@@ -0,0 +1,137 @@
+// -*-c++-*-
+#ifndef POWER_LAW_FIT_H
+#define POWER_LAW_FIT_H
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <gjl/arr_irreg.h>
+#include <gjl/hist_pdf.h>
+#include <gjl/simple_linear_regression.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+  class gjl::PowerLawFit -- fit y = A x^p by a straight line through
+  (log10 x, log10 y), taking the points straight from an ArrIrreg or a
+  HistPdf, with no text files in between.
+
+  gjl::PowerLawFit<> plf;
+  plf.fit(arr, 1e2, 1e5);       // ArrIrreg, times in [1e2,1e5]
+  plf.fit(hist, 10, 1000);      // HistPdf, pdf at centers in [10,1000]
+  plf.exponent(); plf.exponent_error(); plf.amplitude();
+
+  Points outside the window, with zero counts, or with x or y <= 0 are
+  skipped. With weighted = true, which is the default, each point is
+  weighted by its count. For the mean of c samples, or a bin with c
+  counts, the variance of log10 y goes roughly as 1 / c. A HistPdf
+  filled with add_weighted_count(s) is fit with weighted_pdf(i), which
+  is normalized by the sum of weights, and each bin is weighted by its
+  effective number of samples, count(i)^2 / sum_weights_squared(i). If the ArrIrreg
+  keeps sums of squares, the weight is instead 1 / var(log10 y), with
+  var(log10 y) = (stderr / (y ln 10))^2, and points with no spread, or
+  fewer than two values, are skipped.
+
+  The points are gathered into arrays and the logs taken in a separate
+  plain loop, which the compiler may vectorize, as in HistPdf::add_counts.
+  The fit is a linear_regression_accumulator, available from fit().
+  fit(...) returns the number of points used. The errors need at least 3.
+*/
+
+namespace gjl {
+
+template <typename output_t = double>
+class PowerLawFit {
+public:
+  template <typename data_t>
+  inline size_t fit(const ArrIrreg<data_t>& arr, double t_min, double t_max, bool weighted = true);
+  template <typename cnt_t, typename bin_t>
+  inline size_t fit(const HistPdf<cnt_t,bin_t>& hist, double x_min, double x_max, bool weighted = true);
+
+  inline const linear_regression_accumulator<output_t>& fit() const { return acc_; }
+  inline output_t exponent() const { return acc_.slope(); }
+  inline output_t exponent_error() const { return acc_.slope_error(); }
+  inline output_t log_amplitude() const { return acc_.intercept(); }
+  inline output_t log_amplitude_error() const { return acc_.intercept_error(); }
+  inline output_t amplitude() const { return pow(10, acc_.intercept()); }
+  inline output_t r() const { return acc_.r(); }
+  inline size_t n() const { return acc_.n(); }
+
+  inline void report(std::ostream& out = std::cout) const;
+
+private:
+  linear_regression_accumulator<output_t> acc_;
+  std::vector<output_t> lx_, ly_, w_;
+
+  inline void add_point_(double x, double y, double c, bool weighted) {
+    if (! (x > 0 && y > 0 && c > 0)) return;
+    lx_.push_back(x);
+    ly_.push_back(y);
+    w_.push_back(weighted ? c : 1);
+  }
+  inline size_t fit_points_();
+}; /*** END class PowerLawFit */
+
+template <typename output_t>
+template <typename data_t>
+inline size_t PowerLawFit<output_t>::fit(const ArrIrreg<data_t>& arr, double t_min, double t_max, bool weighted) {
+  lx_.clear(); ly_.clear(); w_.clear();
+  const data_t *sums = arr.arrsum_data();
+  const size_t *counts = arr.counts_data();
+  const int lowest = arr.lowest_index();
+  const bool use_errors = weighted && arr.has_sum_squares();
+  for(int i=0; i < arr.number_of_elements(); ++i) {
+    const double t = arr.get_time(i + lowest);
+    if (t < t_min || t > t_max || counts[i] == 0) continue;
+    const double y = sums[i] / counts[i];
+    const double e = use_errors ? arr.get_stderr(i + lowest) / (y * log(10.0)) : 0;
+    add_point_(t, y, use_errors ? (e > 0 ? 1 / (e * e) : 0) : counts[i], weighted);
+  }
+  return fit_points_();
+}
+
+template <typename output_t>
+template <typename cnt_t, typename bin_t>
+inline size_t PowerLawFit<output_t>::fit(const HistPdf<cnt_t,bin_t>& hist, double x_min, double x_max, bool weighted) {
+  lx_.clear(); ly_.clear(); w_.clear();
+  const bool has_weights = hist.has_weights();
+  for(size_t i=0; i < hist.n_bins(); ++i) {
+    const double x = hist.center(i);
+    if (x < x_min || x > x_max) continue;
+    if (! has_weights) {
+      add_point_(x, hist.pdf(i), hist.count(i), weighted);
+      continue;
+    }
+    const double c = hist.count(i), w2 = hist.sum_weights_squared(i);
+    add_point_(x, hist.weighted_pdf(i), w2 > 0 ? c * c / w2 : 0, weighted);
+  }
+  return fit_points_();
+}
+
+template <typename output_t>
+inline size_t PowerLawFit<output_t>::fit_points_() {
+  const size_t n = lx_.size();
+  output_t *lx = lx_.data(), *ly = ly_.data();
+  for(size_t i=0; i < n; ++i) lx[i] = log10(lx[i]);
+  for(size_t i=0; i < n; ++i) ly[i] = log10(ly[i]);
+  acc_.clear();
+  acc_.add_range_weighted(lx_.begin(), lx_.end(), ly_.begin(), w_.begin());
+  return n;
+}
+
+template <typename output_t>
+inline void PowerLawFit<output_t>::report(std::ostream& out) const {
+  out << "Power law fit to " << n() << " points, exponent: " << exponent()
+      << " +/- " << exponent_error() << ",  amplitude: " << amplitude() << "\n";
+  out << "Pearson r of log10 y vs. log10 x: " << r() << "\n";
+}
+
+} /*** END namespace gjl */
+
+#endif
@@ -0,0 +1,341 @@
+// -*-c++-*-
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iostream>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+  class gjl::QuantileSketch -- median, percentiles and other quantiles of
+  a stream of samples, without keeping the samples. This is the KLL
+  sketch of Karnin, Lang and Liberty.
+
+  gjl::QuantileSketch<> q;
+  q.record(x);                 // many times
+  q.merge(other);              // from another thread or job
+  double p99 = q.quantile(0.99);
+
+  The samples are kept in levels. A sample in level h stands for 2^h
+  samples. When a level is full it is sorted, and every other sample,
+  starting at 0 or 1 at random, goes up a level. The levels shrink by
+  2/3 going down from the top, so memory is about 3k samples, however
+  many are recorded. The rank error of a quantile is about 1.7 / k of
+  the number of samples, so with the default k = 200, quantile(0.99) is
+  between the true 0.98 and 0.9999 quantiles with high probability. The
+  sorting costs O(log k) per sample, amortised. min and max are exact.
+
+  The random bits come from a generator in the sketch with a fixed seed,
+  so a given sequence of records and merges always gives the same
+  result. Sketches must have the same k to be merged.
+
+  serialize() writes the sketch into a string of bytes, in the byte order
+  of the machine; deserialize() reads it back. A bad string is reported
+  on std::cerr, unless quiet, and the sketch is left as it was.
+*/
+
+namespace gjl {
+
+template <typename data_t = double>
+class QuantileSketch {
+public:
+  explicit QuantileSketch(unsigned k = 200) : k_(k < min_width ? min_width : k) {
+    levels_.resize(1);
+    update_max_size_();
+  }
+
+  inline void record(data_t x);
+  template <typename Iter>
+  inline void record(Iter first, Iter last) { for(; first != last; ++first) record(*first); }
+  inline void merge(const QuantileSketch<data_t>& other);
+  inline void operator+=(const QuantileSketch<data_t>& other) { merge(other); }
+  inline void clear();
+
+  inline unsigned k() const { return k_; }
+  inline size_t N() const { return n_; }
+  inline data_t min() const { return min_; }
+  inline data_t max() const { return max_; }
+  // Number of samples stored
+  inline size_t size() const { return size_; }
+
+  // Estimate of the smallest x with at least a fraction q of the samples <= x
+  inline data_t quantile(double q) const;
+  // quantile for each of qs, sorting the samples only once
+  inline std::vector<data_t> quantiles(const std::vector<double>& qs) const;
+  // Estimate of the fraction of samples <= x
+  inline double rank(data_t x) const;
+
+  // Lines "# p<percent> <value>" for a few common percentiles, as in the headers of HistPdf
+  inline void print_quantiles(std::ostream& out = std::cout) const;
+
+  inline void serialize(std::string& out) const;
+  // With quiet, a bad string is not reported, only refused
+  inline bool deserialize(const std::string& in, bool quiet = false);
+
+private:
+  static const unsigned min_width = 8;
+
+  unsigned k_;
+  std::vector<std::vector<data_t> > levels_;
+  size_t n_ = 0;
+  size_t size_ = 0;
+  size_t max_size_ = 0;
+  data_t min_ = 0;
+  data_t max_ = 0;
+  uint64_t rng_ = 0x9e3779b97f4a7c15ull;
+
+  // xorshift64*
+  inline bool random_bit_() {
+    rng_ ^= rng_ >> 12;
+    rng_ ^= rng_ << 25;
+    rng_ ^= rng_ >> 27;
+    return ((rng_ * 0x2545f4914f6cdd1dull) >> 63) != 0;
+  }
+  inline size_t capacity_(size_t h) const {
+    const size_t depth = levels_.size() - 1 - h;
+    const size_t c = (size_t) std::ceil(k_ * std::pow(2.0 / 3.0, (double) depth));
+    return c < min_width ? min_width : c;
+  }
+  inline void update_max_size_() {
+    max_size_ = 0;
+    for(size_t h=0; h < levels_.size(); ++h) max_size_ += capacity_(h);
+  }
+  inline void compress_();
+  // All samples, sorted, with their weights accumulated
+  inline void sorted_weighted_(std::vector<std::pair<data_t,uint64_t> >& items) const;
+  inline data_t quantile_in_(const std::vector<std::pair<data_t,uint64_t> >& items, double q) const;
+}; /*** END class QuantileSketch */
+
+template <typename data_t>
+inline void QuantileSketch<data_t>::clear() {
+  levels_.assign(1, std::vector<data_t>());
+  n_ = size_ = 0;
+  min_ = max_ = 0;
+  rng_ = 0x9e3779b97f4a7c15ull;
+  update_max_size_();
+}
+
+template <typename data_t>
+inline void QuantileSketch<data_t>::record(data_t x) {
+  if (n_ == 0) min_ = max_ = x;
+  else {
+    if (x < min_) min_ = x;
+    if (x > max_) max_ = x;
+  }
+  ++n_;
+  levels_[0].push_back(x);
+  if (++size_ >= max_size_) compress_();
+}
+
+/*
+  Compact the lowest full level, and repeat until the total fits. Adding
+  a level on top lowers the capacities below it.
+*/
+template <typename data_t>
+inline void QuantileSketch<data_t>::compress_() {
+  for(size_t h=0; h < levels_.size() && size_ >= max_size_; ++h) {
+    if (levels_[h].size() < capacity_(h)) continue;
+    if (h + 1 == levels_.size()) {
+      levels_.emplace_back();
+      update_max_size_();
+    }
+    std::vector<data_t>& level = levels_[h];
+    std::vector<data_t>& up = levels_[h+1];
+    std::sort(level.begin(), level.end());
+    // An odd one out stays behind
+    const size_t even = level.size() & ~(size_t) 1;
+    for(size_t i = random_bit_() ? 1 : 0; i < even; i += 2)
+      up.push_back(level[i]);
+    if (even < level.size()) {
+      level[0] = level.back();
+      level.resize(1);
+    }
+    else level.clear();
+    size_ -= even / 2;
+  }
+}
+
+template <typename data_t>
+inline void QuantileSketch<data_t>::merge(const QuantileSketch<data_t>& other) {
+  if (k_ != other.k_) {
+    std::cerr << "*** quantile_sketch: cannot merge sketches with different k.\n";
+    abort();
+  }
+  if (other.n_ == 0) return;
+  if (n_ == 0) {
+    min_ = other.min_;
+    max_ = other.max_;
+  }
+  else {
+    if (other.min_ < min_) min_ = other.min_;
+    if (other.max_ > max_) max_ = other.max_;
+  }
+  if (other.levels_.size() > levels_.size()) {
+    levels_.resize(other.levels_.size());
+    update_max_size_();
+  }
+  for(size_t h=0; h < other.levels_.size(); ++h)
+    levels_[h].insert(levels_[h].end(), other.levels_[h].begin(), other.levels_[h].end());
+  n_ += other.n_;
+  size_ += other.size_;
+  while (size_ >= max_size_) {
+    const size_t before = size_;
+    compress_();
+    if (size_ == before) break;
+  }
+}
+
+template <typename data_t>
+inline void QuantileSketch<data_t>::sorted_weighted_(std::vector<std::pair<data_t,uint64_t> >& items) const {
+  items.clear();
+  items.reserve(size_);
+  for(size_t h=0; h < levels_.size(); ++h)
+    for(size_t i=0; i < levels_[h].size(); ++i)
+      items.push_back(std::make_pair(levels_[h][i], (uint64_t) 1 << h));
+  std::sort(items.begin(), items.end());
+  for(size_t i=1; i < items.size(); ++i) items[i].second += items[i-1].second;
+}
+
+template <typename data_t>
+inline data_t QuantileSketch<data_t>::quantile_in_(const std::vector<std::pair<data_t,uint64_t> >& items,
+                                                   double q) const {
+  if (q <= 0 || items.empty()) return min_;
+  if (q >= 1) return max_;
+  const double target = q * items.back().second;
+  for(size_t i=0; i < items.size(); ++i)
+    if (items[i].second >= target) return items[i].first;
+  return max_;
+}
+
+template <typename data_t>
+inline data_t QuantileSketch<data_t>::quantile(double q) const {
+  std::vector<std::pair<data_t,uint64_t> > items;
+  sorted_weighted_(items);
+  return quantile_in_(items, q);
+}
+
+template <typename data_t>
+inline std::vector<data_t> QuantileSketch<data_t>::quantiles(const std::vector<double>& qs) const {
+  std::vector<std::pair<data_t,uint64_t> > items;
+  sorted_weighted_(items);
+  std::vector<data_t> r(qs.size());
+  for(size_t i=0; i < qs.size(); ++i) r[i] = quantile_in_(items, qs[i]);
+  return r;
+}
+
+template <typename data_t>
+inline double QuantileSketch<data_t>::rank(data_t x) const {
+  if (n_ == 0) return 0;
+  uint64_t below = 0, total = 0;
+  for(size_t h=0; h < levels_.size(); ++h)
+    for(size_t i=0; i < levels_[h].size(); ++i) {
+      total += (uint64_t) 1 << h;
+      if (levels_[h][i] <= x) below += (uint64_t) 1 << h;
+    }
+  return (double) below / total;
+}
+
+template <typename data_t>
+inline void QuantileSketch<data_t>::print_quantiles(std::ostream& out) const {
+  static const double qs[] = { 0.001, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999 };
+  const std::vector<double> vq(qs, qs + sizeof(qs) / sizeof(qs[0]));
+  const std::vector<data_t> v = quantiles(vq);
+  out << "# N " << n_ << "\n";
+  out << "# min " << min_ << "\n";
+  for(size_t i=0; i < v.size(); ++i)
+    out << "# p" << 100 * vq[i] << " " << v[i] << "\n";
+  out << "# max " << max_ << "\n";
+}
+
+namespace quantile_sketch {
+  const char magic[8] = { 'G', 'J', 'L', 'K', 'L', 'L', '1', 0 };
+
+  template <typename T>
+  inline void put(std::string& out, const T& x) { out.append((const char *) &x, sizeof(T)); }
+
+  template <typename T>
+  inline bool get(const std::string& in, size_t& pos, T& x) {
+    if (pos + sizeof(T) > in.size()) return false;
+    memcpy(&x, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+}
+
+/*
+  magic, sizeof(data_t), k, number of levels, N, generator state, min,
+  max, then for each level its size and its samples.
+*/
+template <typename data_t>
+inline void QuantileSketch<data_t>::serialize(std::string& out) const {
+  namespace qs = quantile_sketch;
+  out.clear();
+  out.reserve(64 + 4 * levels_.size() + sizeof(data_t) * size_);
+  out.append(qs::magic, sizeof(qs::magic));
+  qs::put(out, (uint32_t) sizeof(data_t));
+  qs::put(out, (uint32_t) k_);
+  qs::put(out, (uint32_t) levels_.size());
+  qs::put(out, (uint64_t) n_);
+  qs::put(out, rng_);
+  qs::put(out, min_);
+  qs::put(out, max_);
+  for(size_t h=0; h < levels_.size(); ++h) {
+    qs::put(out, (uint32_t) levels_[h].size());
+    out.append((const char *) levels_[h].data(), sizeof(data_t) * levels_[h].size());
+  }
+}
+
+template <typename data_t>
+inline bool QuantileSketch<data_t>::deserialize(const std::string& in, bool quiet) {
+  namespace qs = quantile_sketch;
+  size_t pos = sizeof(qs::magic);
+  uint32_t data_size, k, n_levels;
+  uint64_t n, rng;
+  data_t mn, mx;
+  bool ok = in.size() >= pos && memcmp(in.data(), qs::magic, pos) == 0
+    && qs::get(in, pos, data_size) && data_size == sizeof(data_t)
+    && qs::get(in, pos, k) && qs::get(in, pos, n_levels) && n_levels > 0 && n_levels < 64
+    && qs::get(in, pos, n) && qs::get(in, pos, rng) && qs::get(in, pos, mn) && qs::get(in, pos, mx);
+  std::vector<std::vector<data_t> > levels(ok ? n_levels : 0);
+  size_t size = 0;
+  for(size_t h=0; ok && h < levels.size(); ++h) {
+    uint32_t m;
+    ok = qs::get(in, pos, m) && pos + sizeof(data_t) * (size_t) m <= in.size();
+    if (! ok) break;
+    levels[h].resize(m);
+    memcpy(levels[h].data(), in.data() + pos, sizeof(data_t) * (size_t) m);
+    pos += sizeof(data_t) * (size_t) m;
+    size += m;
+  }
+  if (! ok || pos != in.size() || k < min_width) {
+    if (! quiet) std::cerr << "*** quantile_sketch: bad serialized sketch.\n";
+    return false;
+  }
+  k_ = k;
+  levels_.swap(levels);
+  n_ = n;
+  size_ = size;
+  rng_ = rng;
+  min_ = mn;
+  max_ = mx;
+  update_max_size_();
+  return true;
+}
+
+} /*** END namespace gjl */
+
+#endif
@@ -0,0 +1,487 @@
+// -*-c++-*-
+#ifndef GJL_RESULT_FILE_H
+#define GJL_RESULT_FILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <gjl/hist_pdf.h>
+#include <gjl/arr_irreg.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+ * Binary result files for HistPdf and ArrIrreg.
+ *
+ * A file is a fixed size Header, the histogram name, and then the raw
+ * arrays. The name and every array but the last are padded with zeros
+ * to a multiple of 8 bytes.
+ *    HistPdf:   [bin edges, n+1 bin_t, only with custom bins]  counts, n cnt_t
+ *               [sums of squared weights, n cnt_t]
+ *    ArrIrreg:  sums, n data_t   counts, n size_t   [sums of squares, n data_t]
+ * The sums of squared weights are there when the HistPdf has weighted
+ * counts, and the sum_weights_squared_flag is set. The sums of squares
+ * are there when the ArrIrreg keeps them, and the sum_squares_flag is set.
+ * Numbers are in the byte order of the machine that wrote them. A reader
+ * with the other byte order refuses the file. Element types are recorded
+ * as codes, and must match the types of the object that is read into.
+ *
+ * write() sends the file with one writev() that points at the arrays in
+ * the object, so nothing is copied. MappedResult maps a file read-only
+ * and points into the mapping, so merging many files reads each count
+ * once and parses nothing.
+ *
+ *   gjl::result_file::write(hist, "hist.gjlr");
+ *   ...
+ *   gjl::result_file::MappedResult m("hist.gjlr");
+ *   gjl::result_file::merge(m, total);
+ *
+ * Errors are reported on std::cerr, and the functions return false.
+ */
+
+namespace gjl {
+  namespace result_file {
+
+    const char magic[8] = {'G','J','L','R','E','S','\0','\0'};
+    const uint32_t version = 1;
+    const uint32_t byte_order_mark = 0x01020304;
+
+    enum kind_t { hist_pdf_kind = 1, arr_irreg_kind = 2 };
+    enum flag_t { log_flag = 1, custom_bins_flag = 2, hist_name_flag = 4, sum_squares_flag = 8,
+                  sum_weights_squared_flag = 16 };
+
+    // Code for an element type: kind (1 float, 2 signed, 3 unsigned) * 256 + size
+    template <typename T>
+    inline uint32_t type_code() {
+      return (std::is_floating_point<T>::value ? 1 : std::is_signed<T>::value ? 2 : 3) * 256
+        + sizeof(T);
+    }
+
+    struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t byte_order_mark;
+      uint32_t header_size;     // bytes. The name follows the header.
+      uint32_t kind;            // kind_t
+      uint32_t flags;           // flag_t bits
+      uint32_t cnt_type;        // type code of the counts
+      uint32_t bin_type;        // type code of bin edges (HistPdf) or sums (ArrIrreg)
+      uint32_t name_size;       // bytes, without padding
+      uint64_t n;               // number of bins or elements
+      int64_t lowest_index;     // ArrIrreg
+      double min;               // HistPdf: init_min(). ArrIrreg: first time
+      double max;               // HistPdf: init_max(). ArrIrreg: last time
+      double data_min;          // in the binning coordinate, as in hist_pdf::Tally
+      double data_max;
+      double n_weighted_counts;
+      uint64_t n_counts;
+      uint64_t n_greater_than_max;
+      uint64_t n_less_than_min;
+      uint64_t num_merged_hists;
+      uint64_t num_trials;
+      char reserved[56];
+    };
+
+    static_assert(sizeof(Header) == 192, "result_file::Header has padding");
+
+    inline size_t padded_size(size_t n) { return (n + 7) & ~size_t(7); }
+
+    // Zeros for padding
+    inline struct iovec padding(size_t n) {
+      static const char zeros[8] = {0};
+      struct iovec v;
+      v.iov_base = (void *) zeros;
+      v.iov_len = padded_size(n) - n;
+      return v;
+    }
+
+    inline Header new_header(kind_t kind) {
+      Header h;
+      memset(&h, 0, sizeof(h));
+      memcpy(h.magic, magic, sizeof(magic));
+      h.version = version;
+      h.byte_order_mark = byte_order_mark;
+      h.header_size = sizeof(Header);
+      h.kind = kind;
+      return h;
+    }
+
+    /*
+     * Write all of iov to fd. This is one writev, unless the kernel
+     * writes less than everything, as it may for more than 2GB.
+     */
+    inline bool writev_all(int fd, struct iovec *iov, int iovcnt) {
+      while (iovcnt > 0) {
+        ssize_t nw = ::writev(fd, iov, iovcnt);
+        if (nw < 0) {
+          if (errno == EINTR) continue;
+          return false;
+        }
+        size_t left = nw;
+        while (iovcnt > 0 && left >= iov->iov_len) {
+          left -= iov->iov_len;
+          ++iov;
+          --iovcnt;
+        }
+        if (iovcnt > 0) {
+          iov->iov_base = (char *) iov->iov_base + left;
+          iov->iov_len -= left;
+        }
+      }
+      return true;
+    }
+
+    // Write the header, the padded name, and the arrays in iov to fname
+    inline bool write_file(const std::string& fname, Header& h, const std::string& name,
+                           struct iovec *arrays, int n_arrays) {
+      h.name_size = name.size();
+      std::vector<struct iovec> iov(3 + n_arrays);
+      iov[0].iov_base = &h;
+      iov[0].iov_len = sizeof(h);
+      iov[1].iov_base = (void *) name.data();
+      iov[1].iov_len = name.size();
+      iov[2] = padding(name.size());
+      for(int i=0; i < n_arrays; ++i) iov[3+i] = arrays[i];
+      int fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (fd < 0) {
+        std::cerr << "*** result_file: can't open '" << fname << "' for writing: "
+                  << strerror(errno) << "\n";
+        return false;
+      }
+      bool ok = writev_all(fd, iov.data(), iov.size());
+      if (! ok)
+        std::cerr << "*** result_file: error writing '" << fname << "': " << strerror(errno) << "\n";
+      if (::close(fd) != 0 && ok) {
+        std::cerr << "*** result_file: error closing '" << fname << "': " << strerror(errno) << "\n";
+        ok = false;
+      }
+      return ok;
+    }
+
+    template <typename cnt_t, typename bin_t>
+    inline bool write(const HistPdf<cnt_t,bin_t>& hist, const std::string& fname) {
+      Header h = new_header(hist_pdf_kind);
+      h.flags = (hist.using_log() ? log_flag : 0)
+        | (hist.using_custom_bins() ? custom_bins_flag : 0)
+        | (hist.is_hist_name_enabled() ? hist_name_flag : 0);
+      h.cnt_type = type_code<cnt_t>();
+      h.bin_type = type_code<bin_t>();
+      h.n = hist.n_bins();
+      h.min = hist.init_min();
+      h.max = hist.init_max();
+      auto t = hist.tally();
+      h.data_min = t.data_min;
+      h.data_max = t.data_max;
+      h.n_counts = t.n_counts;
+      h.n_greater_than_max = t.n_greater_than_max;
+      h.n_less_than_min = t.n_less_than_min;
+      h.n_weighted_counts = hist.n_weighted_counts();
+      h.num_merged_hists = hist.num_merged_hists();
+      h.num_trials = hist.num_trials();
+      struct iovec arrays[5];
+      int n_arrays = 0;
+      if (hist.using_custom_bins()) {
+        arrays[n_arrays].iov_base = (void *) hist.custom_bins().data();
+        arrays[n_arrays++].iov_len = (h.n + 1) * sizeof(bin_t);
+        arrays[n_arrays++] = padding((h.n + 1) * sizeof(bin_t));
+      }
+      // Compensated weights are added to the counts first
+      std::vector<cnt_t> folded;
+      const cnt_t *counts = hist.counts_data();
+      if (hist.weight_summation() == hist_pdf::compensated_summation) {
+        folded.resize(h.n);
+        for(size_t i=0; i < h.n; ++i) folded[i] = hist.count(i);
+        counts = folded.data();
+      }
+      arrays[n_arrays].iov_base = (void *) counts;
+      arrays[n_arrays++].iov_len = h.n * sizeof(cnt_t);
+      if (hist.has_weights()) {
+        h.flags |= sum_weights_squared_flag;
+        arrays[n_arrays++] = padding(h.n * sizeof(cnt_t));
+        arrays[n_arrays].iov_base = (void *) hist.sum_weights_squared_data();
+        arrays[n_arrays++].iov_len = h.n * sizeof(cnt_t);
+      }
+      return write_file(fname, h, hist.is_hist_name_enabled() ? hist.hist_name() : std::string(),
+                        arrays, n_arrays);
+    }
+
+    template <typename data_t>
+    inline bool write(const ArrIrreg<data_t>& arr, const std::string& fname) {
+      Header h = new_header(arr_irreg_kind);
+      h.cnt_type = type_code<size_t>();
+      h.bin_type = type_code<data_t>();
+      h.n = arr.number_of_elements();
+      h.lowest_index = arr.lowest_index();
+      h.min = arr.time().xa();
+      h.max = arr.time().xb();
+      struct iovec arrays[5];
+      int n_arrays = 3;
+      arrays[0].iov_base = (void *) arr.arrsum_data();
+      arrays[0].iov_len = h.n * sizeof(data_t);
+      arrays[1] = padding(h.n * sizeof(data_t));
+      arrays[2].iov_base = (void *) arr.counts_data();
+      arrays[2].iov_len = h.n * sizeof(size_t);
+      if (arr.has_sum_squares()) {
+        h.flags |= sum_squares_flag;
+        arrays[n_arrays++] = padding(h.n * sizeof(size_t));
+        arrays[n_arrays].iov_base = (void *) arr.arrsum2_data();
+        arrays[n_arrays++].iov_len = h.n * sizeof(data_t);
+      }
+      return write_file(fname, h, std::string(), arrays, n_arrays);
+    }
+
+    /*
+     * class MappedResult -- a result file mapped read-only. The header
+     * is checked when the file is opened. The array pointers point into
+     * the mapping, and are valid until close() or destruction.
+     */
+    class MappedResult {
+    public:
+      MappedResult() {}
+      explicit MappedResult(const std::string& fname) { open(fname); }
+      ~MappedResult() { close(); }
+      MappedResult(const MappedResult&) = delete;
+      MappedResult& operator=(const MappedResult&) = delete;
+
+      // With quiet, errors are not printed, only kept for error()
+      inline bool open(const std::string& fname, bool quiet = false);
+      inline void close() {
+        if (data_) munmap((void *) data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+      }
+
+      inline bool is_open() const { return data_ != nullptr; }
+      inline const std::string& filename() const { return filename_; }
+      inline const std::string& error() const { return error_; }
+      inline const Header& header() const { return *(const Header *) data_; }
+      inline std::string name() const { return std::string(data_ + header().header_size, header().name_size); }
+
+      // HistPdf arrays. edges is only present with custom bins.
+      template <typename bin_t>
+      inline const bin_t * edges() const { return (const bin_t *) (data_ + arrays_offset_); }
+      template <typename cnt_t>
+      inline const cnt_t * counts() const { return (const cnt_t *) (data_ + second_array_offset_); }
+      // Only with sum_weights_squared_flag
+      template <typename cnt_t>
+      inline const cnt_t * sum_weights_squared() const { return (const cnt_t *) (data_ + third_array_offset_); }
+
+      // ArrIrreg arrays
+      template <typename data_t>
+      inline const data_t * sums() const { return (const data_t *) (data_ + arrays_offset_); }
+      inline const size_t * arr_counts() const { return (const size_t *) (data_ + second_array_offset_); }
+      // Only with sum_squares_flag
+      template <typename data_t>
+      inline const data_t * sum_squares() const { return (const data_t *) (data_ + third_array_offset_); }
+
+    private:
+      inline bool fail_(const char *why) {
+        error_ = why;
+        if (! quiet_) std::cerr << "*** result_file: '" << filename_ << "': " << why << "\n";
+        close();
+        return false;
+      }
+      const char *data_ = nullptr;
+      size_t size_ = 0;
+      size_t arrays_offset_ = 0;
+      size_t second_array_offset_ = 0;
+      size_t third_array_offset_ = 0;
+      std::string filename_;
+      std::string error_;
+      bool quiet_ = false;
+    }; /*** END class MappedResult */
+
+    inline bool MappedResult::open(const std::string& fname, bool quiet) {
+      close();
+      filename_ = fname;
+      error_.clear();
+      quiet_ = quiet;
+      int fd = ::open(fname.c_str(), O_RDONLY);
+      if (fd < 0) return fail_(strerror(errno));
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return fail_(strerror(errno));
+      }
+      if ((size_t) st.st_size < sizeof(Header)) {
+        ::close(fd);
+        return fail_("too short to be a result file");
+      }
+      void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (p == MAP_FAILED) return fail_(strerror(errno));
+      data_ = (const char *) p;
+      size_ = st.st_size;
+      const Header& h = header();
+      if (memcmp(h.magic, magic, sizeof(magic)) != 0) return fail_("not a result file");
+      if (h.byte_order_mark != byte_order_mark) return fail_("written with the other byte order");
+      if (h.version != version) return fail_("unknown result file version");
+      if (h.header_size < sizeof(Header) || h.header_size % 8 != 0) return fail_("bad header size");
+      arrays_offset_ = h.header_size + padded_size(h.name_size);
+      size_t cnt_size = h.cnt_type % 256;
+      size_t bin_size = h.bin_type % 256;
+      size_t expected;
+      if (h.kind == hist_pdf_kind) {
+        second_array_offset_ = arrays_offset_;
+        if (h.flags & custom_bins_flag) second_array_offset_ += padded_size((h.n + 1) * bin_size);
+        expected = second_array_offset_ + h.n * cnt_size;
+        if (h.flags & sum_weights_squared_flag) {
+          third_array_offset_ = second_array_offset_ + padded_size(h.n * cnt_size);
+          expected = third_array_offset_ + h.n * cnt_size;
+        }
+      }
+      else if (h.kind == arr_irreg_kind) {
+        second_array_offset_ = arrays_offset_ + padded_size(h.n * bin_size);
+        expected = second_array_offset_ + h.n * cnt_size;
+        if (h.flags & sum_squares_flag) {
+          third_array_offset_ = second_array_offset_ + padded_size(h.n * cnt_size);
+          expected = third_array_offset_ + h.n * bin_size;
+        }
+      }
+      else return fail_("unknown kind of result");
+      if (size_ != expected) return fail_("file size does not match the header");
+      return true;
+    }
+
+    /*
+     * Shape of m is that of hist. On mismatch, print why, unless quiet.
+     */
+    template <typename cnt_t, typename bin_t>
+    inline bool is_same_shape(const MappedResult& m, const HistPdf<cnt_t,bin_t>& hist, bool quiet = false) {
+      const Header& h = m.header();
+      const char *why = nullptr;
+      if (h.kind != hist_pdf_kind) why = "not a HistPdf";
+      else if (h.cnt_type != type_code<cnt_t>() || h.bin_type != type_code<bin_t>())
+        why = "count or bin type differs";
+      else if (h.n != hist.n_bins()) why = "number of bins differs";
+      else if (((h.flags & log_flag) != 0) != hist.using_log()) why = "log spacing differs";
+      else if (((h.flags & custom_bins_flag) != 0) != hist.using_custom_bins()) why = "custom bins differ";
+      else if (h.min != hist.init_min() || h.max != hist.init_max()) why = "min or max bin differs";
+      else if (hist.using_custom_bins()
+               && memcmp(m.edges<bin_t>(), hist.custom_bins().data(), (h.n + 1) * sizeof(bin_t)) != 0)
+        why = "custom bin edges differ";
+      if (why && ! quiet)
+        std::cerr << "*** result_file: '" << m.filename() << "': shape mismatch: " << why << "\n";
+      return why == nullptr;
+    }
+
+    template <typename data_t>
+    inline bool is_same_shape(const MappedResult& m, const ArrIrreg<data_t>& arr, bool quiet = false) {
+      const Header& h = m.header();
+      const char *why = nullptr;
+      if (h.kind != arr_irreg_kind) why = "not an ArrIrreg";
+      else if (h.cnt_type != type_code<size_t>() || h.bin_type != type_code<data_t>())
+        why = "data type differs";
+      else if (h.n != (uint64_t) arr.number_of_elements()) why = "number of elements differs";
+      else if (h.lowest_index != arr.lowest_index()) why = "lowest index differs";
+      else if (h.min != arr.time().xa() || h.max != arr.time().xb()) why = "times differ";
+      else if (arr.has_sum_squares() && ! (h.flags & sum_squares_flag)) why = "no sums of squares";
+      if (why && ! quiet)
+        std::cerr << "*** result_file: '" << m.filename() << "': shape mismatch: " << why << "\n";
+      return why == nullptr;
+    }
+
+    // Add the counts and tallies in m to hist, as HistPdf::merge does
+    template <typename cnt_t, typename bin_t>
+    inline bool merge(const MappedResult& m, HistPdf<cnt_t,bin_t>& hist) {
+      if (! is_same_shape(m, hist)) return false;
+      const Header& h = m.header();
+      const cnt_t *c = m.counts<cnt_t>();
+      cnt_t *mine = hist.counts()->data();
+      for(size_t i=0; i < h.n; ++i) mine[i] += c[i];
+      hist_pdf::Tally<bin_t> t;
+      t.n_counts = h.n_counts;
+      t.n_greater_than_max = h.n_greater_than_max;
+      t.n_less_than_min = h.n_less_than_min;
+      t.data_min = h.data_min;
+      t.data_max = h.data_max;
+      hist.merge_tally(t);
+      if (h.flags & sum_weights_squared_flag) hist.add_sum_weights_squared(m.sum_weights_squared<cnt_t>());
+      hist.n_weighted_counts(hist.n_weighted_counts() + h.n_weighted_counts);
+      hist.num_trials(hist.num_trials() + h.num_trials);
+      hist.num_merged_hists(hist.num_merged_hists() + 1);
+      return true;
+    }
+
+    template <typename data_t>
+    inline bool merge(const MappedResult& m, ArrIrreg<data_t>& arr) {
+      if (! is_same_shape(m, arr)) return false;
+      const size_t n = m.header().n;
+      const data_t *s = m.sums<data_t>();
+      const size_t *c = m.arr_counts();
+      data_t *msum = arr.arrsum_data();
+      size_t *mc = arr.counts_data();
+      for(size_t i=0; i < n; ++i) {
+        msum[i] += s[i];
+        mc[i] += c[i];
+      }
+      if (arr.has_sum_squares()) {
+        const data_t *s2 = m.sum_squares<data_t>();
+        data_t *msum2 = arr.arrsum2_data();
+        for(size_t i=0; i < n; ++i) msum2[i] += s2[i];
+      }
+      return true;
+    }
+
+    // Make hist a copy of the result in m
+    template <typename cnt_t, typename bin_t>
+    inline bool read(const MappedResult& m, HistPdf<cnt_t,bin_t>& hist) {
+      const Header& h = m.header();
+      if (h.kind != hist_pdf_kind || h.cnt_type != type_code<cnt_t>() || h.bin_type != type_code<bin_t>()) {
+        std::cerr << "*** result_file: '" << m.filename() << "': not a HistPdf of this type\n";
+        return false;
+      }
+      if (h.flags & custom_bins_flag) {
+        const bin_t *e = m.edges<bin_t>();
+        hist.init(std::vector<bin_t>(e, e + h.n + 1));
+      }
+      else {
+        hist.init(h.n, h.min, h.max);
+        hist.use_log((h.flags & log_flag) != 0);
+      }
+      hist.clear();
+      hist.num_trials(0);
+      if (h.flags & hist_name_flag) hist.set_hist_name(m.name());
+      if (! merge(m, hist)) return false;
+      hist.num_merged_hists(h.num_merged_hists);
+      return true;
+    }
+
+    template <typename data_t>
+    inline bool read(const MappedResult& m, ArrIrreg<data_t>& arr) {
+      const Header& h = m.header();
+      if (h.kind != arr_irreg_kind) {
+        std::cerr << "*** result_file: '" << m.filename() << "': not an ArrIrreg\n";
+        return false;
+      }
+      arr.set_lowest_index(h.lowest_index);
+      arr.set_xa_xb_n(h.min, h.max, h.n);
+      arr.keep_sum_squares((h.flags & sum_squares_flag) != 0);
+      return merge(m, arr);
+    }
+
+    template <typename T>
+    inline bool read(const std::string& fname, T& result) {
+      MappedResult m(fname);
+      return m.is_open() && read(m, result);
+    }
+
+  } /*** END namespace result_file */
+} /*** END namespace gjl */
+
+#endif
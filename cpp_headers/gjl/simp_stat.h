@@ -2,6 +2,9 @@
 #ifndef SIMP_STAT_H
 #define SIMP_STAT_H
 
+#include <cmath>
+#include <cstddef>
+
 /*****************************************************
 * Copyright 2014 John Lapeyre                        *
 *                                                    *
@@ -14,51 +17,154 @@
  * class gjl::SimpStat
  * Perform very simple statistical analysis. means, standard deviation, etc.
  * This is useful for MontCarlo simulations.
+ *
+ * The mean and the sums of the 2nd, 3rd and 4th powers of deviations from
+ * the mean are updated with each sample (Welford, and Pebay for the higher
+ * moments). Unlike sums of x and x^2, this does not lose the variance to
+ * cancellation when the mean is large compared to the spread.
+ *
+ * merge() combines two SimpStats in O(1), as if one had recorded the
+ * samples of both (Chan et al.), so each thread can keep its own and they
+ * are reduced at the end.
+ *
+ * record(first,last) works in blocks. The mean of a block and the sums of
+ * powers of deviations from it are plain loops that vectorize, and the
+ * block is then merged in.
+ *
+ * variance() is the population variance, sum (x - mean)^2 / N.
+ * sample_variance() divides by N - 1. kurtosis() is the excess kurtosis,
+ * zero for a normal distribution.
  */
 
-//#include <algorithm>
-//#include <vector>
-//#include <iostream>
-
 namespace gjl {
 
 template <typename data_t = double >
 class SimpStat {
 
 public:
+  static const size_t record_block_size = 256;
+
   inline void record (data_t x) {
-    mean_tally_ += x;
-    mean_sq_tally_ += square_(x);
+    const data_t n1 = N_;
     ++N_;
+    const data_t n = N_;
+    const data_t delta = x - mean_;
+    const data_t delta_n = delta / n;
+    const data_t delta_n2 = delta_n * delta_n;
+    const data_t term1 = delta * delta_n * n1;
+    mean_ += delta_n;
+    m4_ += term1 * delta_n2 * (n*n - 3*n + 3) + 6 * delta_n2 * m2_ - 4 * delta_n * m3_;
+    m3_ += term1 * delta_n * (n - 2) - 3 * delta_n * m2_;
+    m2_ += term1;
   }
 
-  inline double mean () { return mean_tally_ / N_; }
+  template <typename Iter>
+  inline void record (Iter first, Iter last);
 
-  inline double variance () {
-    double mean = mean();
-    double variance = (mean_sq_tally_ / N_) - square_(mean);
-    return variance;
-  }
+  inline void merge (const SimpStat<data_t>& other);
+  inline void operator+= (const SimpStat<data_t>& other) { merge(other); }
+
+  inline void clear () { *this = SimpStat<data_t>(); }
+
+  inline double mean () const { return mean_; }
+
+  inline double variance () const { return m2_ / N_; }
 
-  inline double std_dev () {return sqrt(variance());}
+  inline double sample_variance () const { return m2_ / (N_ - 1); }
 
-  inline double error () {return sqrt(variance()/N_);}
+  inline double std_dev () const {return sqrt(variance());}
 
-  inline double N () {return N_;}
+  inline double error () const {return sqrt(variance()/N_);}
+
+  inline double skewness () const { return sqrt((double) N_) * m3_ / pow(m2_, 1.5); }
+
+  inline double kurtosis () const { return N_ * m4_ / (m2_ * m2_) - 3; }
+
+  inline double N () const {return N_;}
 
 private:
-  data_t square_(data_t x) { return x*x;}
-  data_t mean_tally_ = 0;
-  data_t mean_sq_tally_ = 0;
   size_t N_ = 0;
-
-  //  data_t mean_ = 0;
-  //  data_t mean_sq_ = 0;
-  //  data_t std_dev_ = 0;
-  //  data_t error_ = 0;
+  data_t mean_ = 0;
+  data_t m2_ = 0;  // sum of (x - mean)^k
+  data_t m3_ = 0;
+  data_t m4_ = 0;
 
 }; /*** END class SimpStat */
 
+template <typename data_t>
+inline void SimpStat<data_t>::merge (const SimpStat<data_t>& other) {
+  if (other.N_ == 0) return;
+  if (N_ == 0) {
+    *this = other;
+    return;
+  }
+  const data_t na = N_, nb = other.N_;
+  const data_t n = na + nb;
+  const data_t delta = other.mean_ - mean_;
+  const data_t delta2 = delta * delta;
+  const data_t m2 = m2_ + other.m2_ + delta2 * na * nb / n;
+  const data_t m3 = m3_ + other.m3_ + delta2 * delta * na * nb * (na - nb) / (n * n)
+    + 3 * delta * (na * other.m2_ - nb * m2_) / n;
+  const data_t m4 = m4_ + other.m4_ + delta2 * delta2 * na * nb * (na*na - na*nb + nb*nb) / (n * n * n)
+    + 6 * delta2 * (na * na * other.m2_ + nb * nb * m2_) / (n * n)
+    + 4 * delta * (na * other.m3_ - nb * m3_) / n;
+  mean_ += delta * nb / n;
+  m2_ = m2;
+  m3_ = m3;
+  m4_ = m4;
+  N_ += other.N_;
+}
+
+template <typename data_t>
+template <typename Iter>
+inline void SimpStat<data_t>::record (Iter first, Iter last) {
+  data_t xs[record_block_size];
+  while (first != last) {
+    size_t n = 0;
+    for(; n < record_block_size && first != last; ++n, ++first)
+      xs[n] = *first;
+    // Independent lanes, so the compiler may vectorize the sums
+    const size_t nlanes = 8;
+    data_t lane[nlanes] = {0};
+    size_t i = 0;
+    for(; i + nlanes <= n; i += nlanes)
+      for(size_t j=0; j < nlanes; ++j) lane[j] += xs[i+j];
+    for(; i < n; ++i) lane[0] += xs[i];
+    data_t sum = 0;
+    for(size_t j=0; j < nlanes; ++j) sum += lane[j];
+    const data_t mean = sum / n;
+    data_t l2[nlanes] = {0}, l3[nlanes] = {0}, l4[nlanes] = {0};
+    for(i = 0; i + nlanes <= n; i += nlanes)
+      for(size_t j=0; j < nlanes; ++j) {
+        const data_t d = xs[i+j] - mean;
+        const data_t d2 = d * d;
+        l2[j] += d2;
+        l3[j] += d2 * d;
+        l4[j] += d2 * d2;
+      }
+    for(; i < n; ++i) {
+      const data_t d = xs[i] - mean;
+      const data_t d2 = d * d;
+      l2[0] += d2;
+      l3[0] += d2 * d;
+      l4[0] += d2 * d2;
+    }
+    data_t s2 = 0, s3 = 0, s4 = 0;
+    for(size_t j=0; j < nlanes; ++j) {
+      s2 += l2[j];
+      s3 += l3[j];
+      s4 += l4[j];
+    }
+    SimpStat<data_t> block;
+    block.N_ = n;
+    block.mean_ = mean;
+    block.m2_ = s2;
+    block.m3_ = s3;
+    block.m4_ = s4;
+    merge(block);
+  }
+}
+
 } /*** END namespace gjl */
 
 #endif
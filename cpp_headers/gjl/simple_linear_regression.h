@@ -31,15 +31,55 @@
 
     // Fit all data in containers x and y
     linfit.fit(x,y);
+
+  linear_regression_accumulator<output_t> keeps the sums of a fit as
+  points arrive, so the data need not be kept, and the fit is available
+  at any time in O(1).
+
+    linear_regression_accumulator<double> acc;
+    acc.add(x, y);                  // or acc.add(x, y, w)
+    acc.add_range(x.begin(), x.end(), y.begin());
+    acc.merge(other);               // eg from another thread
+    acc.slope(); acc.intercept(); acc.r();
+
+  It keeps the weighted means of x and y and the sums of products of
+  deviations from them, updated as in Welford's method, rather than the
+  sums of x, x^2, ... used by fit_range, which lose precision when the
+  means are large compared to the spread. add_range works in blocks: the
+  means and centered sums of a block are plain loops that vectorize, and
+  the block is merged in.
+
+  windowed_linear_regression<output_t> fits the last `window` points
+  added. Points leaving the window are removed from the sums, and the
+  sums are recomputed from the window each time it has been replaced
+  entirely, so rounding errors do not build up.
+
+  slope_error() and intercept_error() are standard errors estimated from
+  the scatter of the points about the line, so they need n > 2. Weights
+  are relative: scaling all of them does not change the errors.
+
+  multi_linear_regression<output_t> fits one x against many y series.
+
+    multi_linear_regression<double> mfit;
+    mfit.fit_rows(x.begin(), x.end(), y.begin(), n_series);  // y[i * n_series + k]
+    mfit.fit_columns(x.begin(), x.end(), ys);                // ys[k][i]
+    mfit.slope(k); mfit.slope_error(k);
+
+  The sums over x alone are found once. fit_rows reads y once, in order,
+  with the loop over series innermost, so it vectorizes. fit_columns
+  reads each series once.
  */
 
 #include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
 
 template <typename output_t>
 class simple_linear_regression {
   output_t slope_data_, intercept_data_, r_data_;
+  output_t slope_error_data_, intercept_error_data_;
   size_t n_data_;
-  //  output_t s_slope, s_intercept;
  public:
   template <typename Iterx, typename Itery>
     void fit_range(Iterx xbegin, Iterx xend, Itery ybegin );
@@ -60,6 +100,9 @@ class simple_linear_regression {
   inline output_t intercept() const { return intercept_data_; };
   inline output_t r() const { return r_data_; };
   inline size_t n() const { return n_data_; };
+  // Standard errors, from the scatter of the points about the line
+  inline output_t slope_error() const { return slope_error_data_; };
+  inline output_t intercept_error() const { return intercept_error_data_; };
   void report( std::ostream & stream );
 
 }; /*** END class simple_linear_regression */
@@ -97,11 +140,12 @@ template <class Iterx, class Itery>
   intercept_data_ = (Sy - slope_data_ * Sx)/n;
   r_data_ = Dxy / sqrt(Dx * Dy);
 
-  /*
-  auto se2 = (Dy-m*m*Dx)/(n*(n-2));
-  auto sm2 = n * se2 / Dx;
-  auto sb2 = sm2 * Sxx/ n;
-  */
+  // Rounding can make the residual slightly negative for points on a line
+  const output_t dr = Dy - slope_data_ * slope_data_ * Dx;
+  const output_t se2 = (dr > 0 ? dr : 0) / (n * (n - 2.0));
+  const output_t sm2 = n * se2 / Dx;
+  slope_error_data_ = sqrt(sm2);
+  intercept_error_data_ = sqrt(sm2 * Sxx / n);
 }
 
 template <class output_t>
@@ -140,6 +184,383 @@ template <class Iterx, class Itery>
   slope_data_ = Dxy / Dx;
   intercept_data_ = (Sy - slope_data_ * Sx)/W;
   r_data_ = Dxy / sqrt(Dx * Dy);
+
+  // The weights are relative. The scale of the errors comes from the scatter.
+  const output_t dr = Dy - slope_data_ * slope_data_ * Dx;
+  const output_t sm2 = (dr > 0 ? dr : 0) / ((n - 2.0) * Dx);
+  slope_error_data_ = sqrt(sm2);
+  intercept_error_data_ = sqrt(sm2 * Sxx / W);
+}
+
+template <typename output_t>
+class linear_regression_accumulator {
+ public:
+  static const size_t add_range_block_size = 256;
+
+  inline void add(output_t x, output_t y, output_t w = 1);
+  // Undo add(x, y, w). Sums with weight zero left are cleared.
+  inline void remove(output_t x, output_t y, output_t w = 1);
+  template <typename Iterx, typename Itery>
+  inline void add_range(Iterx xbegin, Iterx xend, Itery ybegin);
+  template <typename Iterx, typename Itery, typename Iterw>
+  inline void add_range_weighted(Iterx xbegin, Iterx xend, Itery ybegin, Iterw wbegin);
+  inline void merge(const linear_regression_accumulator<output_t>& other);
+  inline void operator+=(const linear_regression_accumulator<output_t>& other) { merge(other); }
+  inline void clear() { *this = linear_regression_accumulator<output_t>(); }
+
+  inline output_t slope() const { return cxy_ / cxx_; }
+  inline output_t intercept() const { return mean_y_ - slope() * mean_x_; }
+  inline output_t r() const { return cxy_ / sqrt(cxx_ * cyy_); }
+  inline size_t n() const { return n_; }
+  // Standard errors, as for simple_linear_regression
+  inline output_t slope_error() const { return sqrt(residual_variance_() / cxx_); }
+  inline output_t intercept_error() const {
+    return sqrt(residual_variance_() * (1 / w_ + mean_x_ * mean_x_ / cxx_));
+  }
+  inline output_t sum_weights() const { return w_; }
+  inline output_t mean_x() const { return mean_x_; }
+  inline output_t mean_y() const { return mean_y_; }
+  // Weighted sums of (x - mean_x)^2, (y - mean_y)^2 and (x - mean_x)(y - mean_y)
+  inline output_t sxx() const { return cxx_; }
+  inline output_t syy() const { return cyy_; }
+  inline output_t sxy() const { return cxy_; }
+  void report( std::ostream & stream ) const;
+
+ private:
+  size_t n_ = 0;
+  output_t w_ = 0;
+  output_t mean_x_ = 0, mean_y_ = 0;
+  output_t cxx_ = 0, cyy_ = 0, cxy_ = 0;
+
+  // Weighted sum of squared residuals over n - 2, not below zero
+  inline output_t residual_variance_() const {
+    const output_t r = cyy_ - cxy_ * cxy_ / cxx_;
+    return (r > 0 ? r : 0) / (n_ - 2.0);
+  }
+  template <bool Weighted>
+  inline void add_block_(const output_t *xs, const output_t *ys, const output_t *ws, size_t n);
+}; /*** END class linear_regression_accumulator */
+
+template <typename output_t>
+inline void linear_regression_accumulator<output_t>::add(output_t x, output_t y, output_t w) {
+  ++n_;
+  w_ += w;
+  const output_t dx = x - mean_x_;
+  const output_t dy = y - mean_y_;
+  mean_x_ += w * dx / w_;
+  mean_y_ += w * dy / w_;
+  cxx_ += w * dx * (x - mean_x_);
+  cyy_ += w * dy * (y - mean_y_);
+  cxy_ += w * dx * (y - mean_y_);
+}
+
+template <typename output_t>
+inline void linear_regression_accumulator<output_t>::remove(output_t x, output_t y, output_t w) {
+  const output_t w_old = w_ - w;
+  if (n_ <= 1 || w_old <= 0) {
+    clear();
+    return;
+  }
+  const output_t mean_x_old = (w_ * mean_x_ - w * x) / w_old;
+  const output_t mean_y_old = (w_ * mean_y_ - w * y) / w_old;
+  const output_t dx = x - mean_x_old;
+  const output_t dy = y - mean_y_old;
+  cxx_ -= w * dx * (x - mean_x_);
+  cyy_ -= w * dy * (y - mean_y_);
+  cxy_ -= w * dx * (y - mean_y_);
+  mean_x_ = mean_x_old;
+  mean_y_ = mean_y_old;
+  w_ = w_old;
+  --n_;
+}
+
+template <typename output_t>
+inline void linear_regression_accumulator<output_t>::merge(const linear_regression_accumulator<output_t>& other) {
+  if (other.n_ == 0) return;
+  if (n_ == 0) {
+    *this = other;
+    return;
+  }
+  const output_t w = w_ + other.w_;
+  const output_t dx = other.mean_x_ - mean_x_;
+  const output_t dy = other.mean_y_ - mean_y_;
+  const output_t f = w_ * other.w_ / w;
+  cxx_ += other.cxx_ + dx * dx * f;
+  cyy_ += other.cyy_ + dy * dy * f;
+  cxy_ += other.cxy_ + dx * dy * f;
+  mean_x_ += dx * other.w_ / w;
+  mean_y_ += dy * other.w_ / w;
+  w_ = w;
+  n_ += other.n_;
+}
+
+/*
+  Means, then centered sums, of one block, each in independent lanes so
+  the compiler may vectorize. ws is ignored unless Weighted.
+*/
+template <typename output_t>
+template <bool Weighted>
+inline void linear_regression_accumulator<output_t>::add_block_(const output_t *xs, const output_t *ys,
+                                                                const output_t *ws, size_t n) {
+  const size_t nlanes = 8;
+  output_t lw[nlanes] = {0}, lx[nlanes] = {0}, ly[nlanes] = {0};
+  size_t i = 0;
+  for(; i + nlanes <= n; i += nlanes)
+    for(size_t j=0; j < nlanes; ++j) {
+      const output_t w = Weighted ? ws[i+j] : 1;
+      lw[j] += w;
+      lx[j] += w * xs[i+j];
+      ly[j] += w * ys[i+j];
+    }
+  for(; i < n; ++i) {
+    const output_t w = Weighted ? ws[i] : 1;
+    lw[0] += w;
+    lx[0] += w * xs[i];
+    ly[0] += w * ys[i];
+  }
+  linear_regression_accumulator<output_t> block;
+  for(size_t j=0; j < nlanes; ++j) {
+    block.w_ += lw[j];
+    block.mean_x_ += lx[j];
+    block.mean_y_ += ly[j];
+  }
+  if (block.w_ <= 0) return;
+  block.mean_x_ /= block.w_;
+  block.mean_y_ /= block.w_;
+  const output_t mx = block.mean_x_, my = block.mean_y_;
+  output_t lxx[nlanes] = {0}, lyy[nlanes] = {0}, lxy[nlanes] = {0};
+  for(i = 0; i + nlanes <= n; i += nlanes)
+    for(size_t j=0; j < nlanes; ++j) {
+      const output_t w = Weighted ? ws[i+j] : 1;
+      const output_t dx = xs[i+j] - mx, dy = ys[i+j] - my;
+      lxx[j] += w * dx * dx;
+      lyy[j] += w * dy * dy;
+      lxy[j] += w * dx * dy;
+    }
+  for(; i < n; ++i) {
+    const output_t w = Weighted ? ws[i] : 1;
+    const output_t dx = xs[i] - mx, dy = ys[i] - my;
+    lxx[0] += w * dx * dx;
+    lyy[0] += w * dy * dy;
+    lxy[0] += w * dx * dy;
+  }
+  for(size_t j=0; j < nlanes; ++j) {
+    block.cxx_ += lxx[j];
+    block.cyy_ += lyy[j];
+    block.cxy_ += lxy[j];
+  }
+  block.n_ = n;
+  merge(block);
+}
+
+template <typename output_t>
+template <typename Iterx, typename Itery>
+inline void linear_regression_accumulator<output_t>::add_range(Iterx xbegin, Iterx xend, Itery ybegin) {
+  output_t xs[add_range_block_size], ys[add_range_block_size];
+  while (xbegin != xend) {
+    size_t n = 0;
+    for(; n < add_range_block_size && xbegin != xend; ++n, ++xbegin, ++ybegin) {
+      xs[n] = *xbegin;
+      ys[n] = *ybegin;
+    }
+    add_block_<false>(xs, ys, nullptr, n);
+  }
+}
+
+template <typename output_t>
+template <typename Iterx, typename Itery, typename Iterw>
+inline void linear_regression_accumulator<output_t>::add_range_weighted(Iterx xbegin, Iterx xend,
+                                                                        Itery ybegin, Iterw wbegin) {
+  output_t xs[add_range_block_size], ys[add_range_block_size], ws[add_range_block_size];
+  while (xbegin != xend) {
+    size_t n = 0;
+    for(; n < add_range_block_size && xbegin != xend; ++n, ++xbegin, ++ybegin, ++wbegin) {
+      xs[n] = *xbegin;
+      ys[n] = *ybegin;
+      ws[n] = *wbegin;
+    }
+    add_block_<true>(xs, ys, ws, n);
+  }
+}
+
+template < class output_t >
+void linear_regression_accumulator<output_t>::report ( std::ostream & stream ) const {
+  stream << "Fit " << n() << " points, Slope m: "
+            << slope() << ",  intercept b: " << intercept() << "\n";
+  stream << "Pearson r: " << r() << "\n";
+  stream << "Standard errors, slope: " << slope_error() << ",  intercept: " << intercept_error() << "\n";
+}
+
+template <typename output_t>
+class windowed_linear_regression {
+ public:
+  explicit windowed_linear_regression(size_t window) : window_(window) {
+    if ( window == 0 ) {
+      std::cerr << "*** windowed_linear_regression: window is zero!\n";
+      abort();
+    }
+    points_.reserve(window);
+  }
+
+  inline void add(output_t x, output_t y, output_t w = 1);
+  inline void clear() { points_.clear(); next_ = 0; acc_.clear(); }
+
+  inline const linear_regression_accumulator<output_t>& fit() const { return acc_; }
+  inline output_t slope() const { return acc_.slope(); }
+  inline output_t intercept() const { return acc_.intercept(); }
+  inline output_t r() const { return acc_.r(); }
+  inline output_t slope_error() const { return acc_.slope_error(); }
+  inline output_t intercept_error() const { return acc_.intercept_error(); }
+  inline size_t n() const { return acc_.n(); }
+  inline size_t window() const { return window_; }
+  void report( std::ostream & stream ) const { acc_.report(stream); }
+
+ private:
+  struct point { output_t x, y, w; };
+  size_t window_;
+  std::vector<point> points_;  // ring buffer once full
+  size_t next_ = 0;            // oldest point, once full
+  linear_regression_accumulator<output_t> acc_;
+}; /*** END class windowed_linear_regression */
+
+template <typename output_t>
+inline void windowed_linear_regression<output_t>::add(output_t x, output_t y, output_t w) {
+  if (points_.size() < window_) {
+    points_.push_back(point{x, y, w});
+    acc_.add(x, y, w);
+    return;
+  }
+  const point& old = points_[next_];
+  acc_.remove(old.x, old.y, old.w);
+  points_[next_] = point{x, y, w};
+  acc_.add(x, y, w);
+  if (++next_ == window_) {
+    next_ = 0;
+    acc_.clear();
+    for(size_t i=0; i < points_.size(); ++i) acc_.add(points_[i].x, points_[i].y, points_[i].w);
+  }
+}
+
+template <typename output_t>
+class multi_linear_regression {
+ public:
+  template <typename Iterx, typename Itery>
+  void fit_rows(Iterx xbegin, Iterx xend, Itery ybegin, size_t n_series);
+  template <typename Iterx, typename Columns>
+  void fit_columns(Iterx xbegin, Iterx xend, const Columns& ys);
+
+  inline size_t n() const { return n_data_; }
+  inline size_t n_series() const { return cxy_.size(); }
+  inline output_t slope(size_t k) const { return cxy_[k] / cxx_; }
+  inline output_t intercept(size_t k) const { return mean_y_[k] - slope(k) * mean_x_; }
+  inline output_t r(size_t k) const { return cxy_[k] / sqrt(cxx_ * cyy_[k]); }
+  inline output_t slope_error(size_t k) const { return sqrt(residual_variance_(k) / cxx_); }
+  inline output_t intercept_error(size_t k) const {
+    return sqrt(residual_variance_(k) * (1.0 / n_data_ + mean_x_ * mean_x_ / cxx_));
+  }
+  void report( std::ostream & stream ) const;
+
+ private:
+  size_t n_data_ = 0;
+  output_t mean_x_ = 0, cxx_ = 0;
+  std::vector<output_t> dx_;  // x - mean_x
+  std::vector<output_t> mean_y_, cyy_, cxy_;
+
+  template <typename Iterx>
+  inline void fit_x_(Iterx xbegin, Iterx xend);
+  inline output_t residual_variance_(size_t k) const {
+    const output_t r = cyy_[k] - cxy_[k] * cxy_[k] / cxx_;
+    return (r > 0 ? r : 0) / (n_data_ - 2.0);
+  }
+}; /*** END class multi_linear_regression */
+
+template <typename output_t>
+template <typename Iterx>
+inline void multi_linear_regression<output_t>::fit_x_(Iterx xbegin, Iterx xend) {
+  dx_.assign(xbegin, xend);
+  n_data_ = dx_.size();
+  if ( n_data_ == 0 ) {
+    std::cerr << "*** multi_linear_regression: size of x,y is zero!\n";
+    abort();
+  }
+  output_t sx = 0;
+  for(size_t i=0; i < n_data_; ++i) sx += dx_[i];
+  mean_x_ = sx / n_data_;
+  cxx_ = 0;
+  for(size_t i=0; i < n_data_; ++i) {
+    dx_[i] -= mean_x_;
+    cxx_ += dx_[i] * dx_[i];
+  }
+}
+
+/*
+  Since the dx sum to zero, sum dx (y - y0) is the centered cross sum for
+  any shift y0. y is shifted by its first point, so that the sum of
+  squares does not lose precision when the mean of y is large.
+*/
+template <typename output_t>
+template <typename Iterx, typename Itery>
+void multi_linear_regression<output_t>::fit_rows(Iterx xbegin, Iterx xend, Itery ybegin, size_t n_series) {
+  fit_x_(xbegin, xend);
+  const size_t m = n_series;
+  std::vector<output_t> y0(m), sy(m, 0), syy(m, 0), sxy(m, 0);
+  std::vector<output_t> row(m);
+  for(size_t i=0; i < n_data_; ++i) {
+    for(size_t k=0; k < m; ++k, ++ybegin) row[k] = *ybegin;
+    if (i == 0) y0 = row;
+    const output_t dx = dx_[i];
+    output_t *py = row.data(), *p0 = y0.data(), *psy = sy.data(), *psyy = syy.data(), *psxy = sxy.data();
+    for(size_t k=0; k < m; ++k) {
+      const output_t d = py[k] - p0[k];
+      psy[k] += d;
+      psyy[k] += d * d;
+      psxy[k] += dx * d;
+    }
+  }
+  mean_y_.resize(m);
+  cyy_.resize(m);
+  cxy_.resize(m);
+  for(size_t k=0; k < m; ++k) {
+    const output_t d = sy[k] / n_data_;
+    mean_y_[k] = y0[k] + d;
+    cyy_[k] = syy[k] - n_data_ * d * d;
+    cxy_[k] = sxy[k];
+  }
+}
+
+template <typename output_t>
+template <typename Iterx, typename Columns>
+void multi_linear_regression<output_t>::fit_columns(Iterx xbegin, Iterx xend, const Columns& ys) {
+  fit_x_(xbegin, xend);
+  const size_t m = ys.size();
+  mean_y_.resize(m);
+  cyy_.resize(m);
+  cxy_.resize(m);
+  size_t k = 0;
+  for (auto col = ys.begin(); col != ys.end(); ++col, ++k) {
+    auto yit = col->begin();
+    const output_t y0 = *yit;
+    output_t sy = 0, syy = 0, sxy = 0;
+    for(size_t i=0; i < n_data_; ++i, ++yit) {
+      const output_t d = *yit - y0;
+      sy += d;
+      syy += d * d;
+      sxy += dx_[i] * d;
+    }
+    const output_t d = sy / n_data_;
+    mean_y_[k] = y0 + d;
+    cyy_[k] = syy - n_data_ * d * d;
+    cxy_[k] = sxy;
+  }
+}
+
+template < class output_t >
+void multi_linear_regression<output_t>::report ( std::ostream & stream ) const {
+  stream << "Fit " << n() << " points, " << n_series() << " series\n";
+  stream << "# series slope slope_error intercept intercept_error r\n";
+  for(size_t k=0; k < n_series(); ++k)
+    stream << k << " " << slope(k) << " " << slope_error(k) << " " << intercept(k)
+           << " " << intercept_error(k) << " " << r(k) << "\n";
 }
 
 template < class output_t >
@@ -147,6 +568,7 @@ void simple_linear_regression<output_t>::report ( std::ostream & stream ) {
   stream << "Fit " << n() << " points, Slope m: "
             << slope() << ",  intercept b: " << intercept() << "\n";
   stream << "Pearson r: " << r() << "\n";
+  stream << "Standard errors, slope: " << slope_error() << ",  intercept: " << intercept_error() << "\n";
 }
 
 #endif
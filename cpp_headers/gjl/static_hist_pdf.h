@@ -0,0 +1,198 @@
+// -*-c++-*-
+#ifndef STATIC_HIST_PDF_H
+#define STATIC_HIST_PDF_H
+
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <gjl/hist_pdf.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+  class gjl::StaticHistPdf -- a histogram whose number of bins and range
+  are fixed at compile time.
+
+  struct MyRange { static constexpr double min = 0, max = 30; };
+  gjl::StaticHistPdf<100, MyRange> hist;
+  hist.add_count(x);
+  hist.print_pdf(out);
+
+  The range is a type with static constexpr members min and max, because
+  a double can't be a template parameter. With log spacing, min and max
+  are in the binning coordinate, log10 of the data. DecadeRange<-2,5>
+  covers 1e-2 to 1e5, and IntRange<0,30> covers 0 to 30.
+
+  The counts are a std::array in the object, and the width, its inverse
+  and the limits are constants. Bins, and the treatment of samples out of
+  range, are those of HistPdf<cnt_t,double>(N, min, max, Log), so
+  to_hist_pdf() gives what a HistPdf filled with the same samples would
+  hold. Use that for anything not here, such as other zero printing
+  modes. merge() and the text of print_pdf are as for HistPdf.
+*/
+
+namespace gjl {
+
+template <int Lo, int Hi>
+struct IntRange {
+  static constexpr double min = Lo;
+  static constexpr double max = Hi;
+};
+
+// 10^Lo to 10^Hi, for log spacing
+template <int Lo, int Hi>
+struct DecadeRange : public IntRange<Lo,Hi> {};
+
+template <size_t N, typename Range, bool Log = false, typename cnt_t = double>
+class StaticHistPdf {
+  static_assert(N > 0, "StaticHistPdf needs at least one bin");
+  static_assert(Range::max > Range::min, "StaticHistPdf range must have max > min");
+public:
+  typedef hist_pdf::Tally<double> tally_t;
+  static constexpr size_t n_bins_c = N;
+  static constexpr double min_c = Range::min;   // binning coordinate
+  static constexpr double max_c = Range::max;
+  static constexpr double width_c = (max_c - min_c) / N;
+  static constexpr double inv_width_c = 1 / width_c;
+
+  StaticHistPdf() { clear(); }
+
+  inline void clear() {
+    counts_.fill(0);
+    tally_ = tally_t();
+  }
+
+  inline void add_count(double x);
+  template <typename Iter>
+  inline void add_counts(Iter first, Iter last);
+
+  inline void merge(const StaticHistPdf& other) {
+    for(size_t i=0; i < N; ++i) counts_[i] += other.counts_[i];
+    tally_.merge(other.tally_);
+    ++num_merged_hists_;
+    num_trials_ += other.num_trials_;
+  }
+  inline void operator+=(const StaticHistPdf& other) { merge(other); }
+
+  static constexpr size_t n_bins() { return N; }
+  static constexpr bool using_log() { return Log; }
+  inline double min() const { return maybe_exp(min_c); }
+  inline double max() const { return maybe_exp(max_c); }
+  inline cnt_t count(size_t i) const { return counts_[i]; }
+  inline const std::array<cnt_t,N>& counts() const { return counts_; }
+  inline const tally_t& tally() const { return tally_; }
+  inline size_t n_counts() const { return tally_.n_counts; }
+  inline size_t n_greater_than_max() const { return tally_.n_greater_than_max; }
+  inline size_t n_less_than_min() const { return tally_.n_less_than_min; }
+  inline double data_min() const { return maybe_exp(tally_.data_min); }
+  inline double data_max() const { return maybe_exp(tally_.data_max); }
+  inline void increment_num_trials() { ++num_trials_; }
+  inline size_t num_trials() const { return num_trials_; }
+  inline size_t num_merged_hists() const { return num_merged_hists_; }
+
+  // Bin index of y, which is in the binning coordinate. Out of range goes to the first or last bin.
+  static inline size_t bin_index_internal(double y) {
+    double r = (y - min_c) * inv_width_c;
+    r = r >= 0 ? r : 0; // NaN goes to 0, too
+    r = r <= N - 1 ? r : N - 1;
+    return (size_t) r;
+  }
+
+  inline void to_hist_pdf(HistPdf<cnt_t,double>& h) const;
+  inline HistPdf<cnt_t,double> to_hist_pdf() const { HistPdf<cnt_t,double> h; to_hist_pdf(h); return h; }
+  inline void print_pdf(std::ostream& out = std::cout) const { to_hist_pdf().print_pdf(out); }
+  inline bool write_pdf(const std::string& filename) const { return to_hist_pdf().write_pdf(filename); }
+
+private:
+  std::array<cnt_t,N> counts_;
+  tally_t tally_;
+  size_t num_merged_hists_ = 0;
+  size_t num_trials_ = 0;
+
+  static inline double maybe_log(double x) { return Log ? hist_pdf::histlog(x) : x; }
+  static inline double maybe_exp(double x) { return Log ? hist_pdf::histexp(x) : x; }
+}; /*** END class StaticHistPdf */
+
+template <size_t N, typename Range, bool Log, typename cnt_t>
+constexpr double StaticHistPdf<N,Range,Log,cnt_t>::min_c;
+template <size_t N, typename Range, bool Log, typename cnt_t>
+constexpr double StaticHistPdf<N,Range,Log,cnt_t>::max_c;
+template <size_t N, typename Range, bool Log, typename cnt_t>
+constexpr double StaticHistPdf<N,Range,Log,cnt_t>::width_c;
+template <size_t N, typename Range, bool Log, typename cnt_t>
+constexpr double StaticHistPdf<N,Range,Log,cnt_t>::inv_width_c;
+
+template <size_t N, typename Range, bool Log, typename cnt_t>
+inline void StaticHistPdf<N,Range,Log,cnt_t>::add_count(double x) {
+  const double y = maybe_log(x);
+  ++counts_[bin_index_internal(y)];
+  if (tally_.n_counts++ == 0) tally_.data_min = tally_.data_max = y;
+  else {
+    if (y > tally_.data_max) tally_.data_max = y;
+    if (y < tally_.data_min) tally_.data_min = y;
+  }
+  tally_.n_greater_than_max += y > max_c;
+  tally_.n_less_than_min += y < min_c;
+}
+
+/*
+  Add all samples in [first,last). Same result as add_count on each.
+  As in HistPdf::add_counts, a block of indices is found before any
+  count is incremented, so that loop vectorizes, and the tallies are
+  kept in locals. The block min and max are from hist_pdf::block_min_max,
+  as in HistPdf::index_block.
+*/
+template <size_t N, typename Range, bool Log, typename cnt_t>
+template <typename Iter>
+inline void StaticHistPdf<N,Range,Log,cnt_t>::add_counts(Iter first, Iter last) {
+  const size_t block_size = HistPdf<cnt_t,double>::add_counts_block_size;
+  double ys[block_size];
+  size_t idx[block_size];
+  while (first != last) {
+    size_t n = 0;
+    for(; n < block_size && first != last; ++n, ++first)
+      ys[n] = *first;
+    if (Log)
+      for(size_t i=0; i < n; ++i) ys[i] = hist_pdf::histlog(ys[i]);
+    size_t ngt = 0, nlt = 0;
+    for(size_t i=0; i < n; ++i) {
+      const double y = ys[i];
+      idx[i] = bin_index_internal(y);
+      ngt += y > max_c;
+      nlt += y < min_c;
+    }
+    double dmin, dmax;
+    hist_pdf::block_min_max(ys, n, dmin, dmax);
+    for(size_t i=0; i < n; ++i)
+      ++counts_[idx[i]];
+    tally_t t;
+    t.n_counts = n;
+    t.n_greater_than_max = ngt;
+    t.n_less_than_min = nlt;
+    t.data_min = dmin;
+    t.data_max = dmax;
+    tally_.merge(t);
+  }
+}
+
+template <size_t N, typename Range, bool Log, typename cnt_t>
+inline void StaticHistPdf<N,Range,Log,cnt_t>::to_hist_pdf(HistPdf<cnt_t,double>& h) const {
+  h.init(N, maybe_exp(min_c), maybe_exp(max_c));
+  h.use_log(Log);
+  h.clear();
+  cnt_t *c = h.counts()->data();
+  for(size_t i=0; i < N; ++i) c[i] = counts_[i];
+  h.merge_tally(tally_);
+  h.num_merged_hists(num_merged_hists_);
+  h.num_trials(num_trials_);
+}
+
+} /*** END namespace gjl */
+
+#endif
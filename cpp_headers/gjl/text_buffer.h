@@ -0,0 +1,164 @@
+// -*-c++-*-
+#ifndef GJL_TEXT_BUFFER_H
+#define GJL_TEXT_BUFFER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+  class gjl::TextBuffer -- format text into memory, then write it all at
+  once.
+
+  gjl::TextBuffer buf;
+  buf << x << " " << n << "\n";  // many lines
+  buf.write_file("out.dat");
+  buf.clear();                   // keeps the memory for the next file
+
+  Floating point numbers are written as an ostream with default flags
+  writes them, ie. "%g", so the text is the same as with iostream. With
+  round_trip(true) they are written with the fewest of 15, 16 or 17
+  digits that read back to the same number. precision(n), at most 17,
+  writes them with "%.<n>g", as precision(n) on an ostream does. Perl
+  prints numbers as precision(15). Integer valued numbers, which most
+  counts are, are written without calling snprintf.
+*/
+
+namespace gjl {
+
+class TextBuffer {
+public:
+  TextBuffer() {}
+  explicit TextBuffer(size_t capacity) { reserve(capacity); }
+
+  inline void round_trip(bool on) { round_trip_ = on; }
+  inline bool round_trip() const { return round_trip_; }
+  inline void precision(int digits) { precision_ = digits; }
+  inline int precision() const { return precision_; }
+
+  inline void clear() { size_ = 0; }
+  inline void reserve(size_t n) { if (n > buf_.size()) buf_.resize(n); }
+  inline size_t size() const { return size_; }
+  inline const char * data() const { return buf_.data(); }
+  inline std::string str() const { return std::string(buf_.data(), size_); }
+
+  inline TextBuffer& put(const char *s, size_t n) {
+    char *p = room_(n);
+    memcpy(p, s, n);
+    size_ += n;
+    return *this;
+  }
+  inline TextBuffer& operator<< (const char *s) { return put(s, strlen(s)); }
+  inline TextBuffer& operator<< (const std::string& s) { return put(s.data(), s.size()); }
+  inline TextBuffer& operator<< (char c) { *room_(1) = c; ++size_; return *this; }
+  inline TextBuffer& operator<< (double x) { put_double_(x); return *this; }
+  inline TextBuffer& operator<< (float x) { put_double_(x); return *this; }
+  template <typename T>
+  inline typename std::enable_if<std::is_integral<T>::value, TextBuffer&>::type
+  operator<< (T n) {
+    if (n < 0) {
+      *room_(1) = '-';
+      ++size_;
+      put_uint_(0 - (unsigned long long) n);
+    }
+    else put_uint_((unsigned long long) n);
+    return *this;
+  }
+
+  // One call to write, or as few as the system allows. Retried after a signal.
+  inline bool write(int fd) const;
+  inline bool write(std::ostream& out) const { return (bool) out.write(data(), size_); }
+  // Replace fname with the contents of the buffer
+  inline bool write_file(const std::string& fname) const;
+
+private:
+  std::vector<char> buf_;
+  size_t size_ = 0;
+  bool round_trip_ = false;
+  int precision_ = 6;
+
+  // Pointer to at least n free chars
+  inline char * room_(size_t n) {
+    if (size_ + n > buf_.size()) buf_.resize(std::max(2 * buf_.size(), size_ + n + 4096));
+    return buf_.data() + size_;
+  }
+
+  inline void put_uint_(unsigned long long n) {
+    char tmp[24];
+    char *e = tmp + sizeof(tmp);
+    char *p = e;
+    do {
+      *--p = '0' + n % 10;
+      n /= 10;
+    } while (n != 0);
+    put(p, e - p);
+  }
+
+  inline void put_double_(double x);
+}; /*** END class TextBuffer */
+
+inline void TextBuffer::put_double_(double x) {
+  // "%.<p>g" writes integers below 10^p as plain digits
+  static const double pow10[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                  1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+  const int digits = round_trip_ ? 15 : precision_;
+  const double int_max = digits < 1 ? 10 : digits > 18 ? 1e18 : pow10[digits];
+  if (std::abs(x) < int_max && x == (long long) x && ! (x == 0 && std::signbit(x))) {
+    *this << (long long) x;
+    return;
+  }
+  char *p = room_(32);
+  int n;
+  if (! round_trip_) n = snprintf(p, 32, "%.*g", precision_ < 17 ? precision_ : 17, x);
+  else {
+    n = snprintf(p, 32, "%.15g", x);
+    if (std::isfinite(x) && strtod(p, nullptr) != x) {
+      n = snprintf(p, 32, "%.16g", x);
+      if (strtod(p, nullptr) != x) n = snprintf(p, 32, "%.17g", x);
+    }
+  }
+  size_ += n;
+}
+
+inline bool TextBuffer::write(int fd) const {
+  const char *p = buf_.data();
+  size_t left = size_;
+  while (left > 0) {
+    ssize_t n = ::write(fd, p, left);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += n;
+    left -= n;
+  }
+  return true;
+}
+
+inline bool TextBuffer::write_file(const std::string& fname) const {
+  int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+  bool ok = write(fd);
+  return close(fd) == 0 && ok;
+}
+
+} /*** END namespace gjl */
+
+#endif
@@ -0,0 +1,112 @@
+// -*-c++-*-
+#ifndef TIME_GRID_H
+#define TIME_GRID_H
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+ * class gjl::TimeGrid -- an increasing array of arbitrary times, with
+ * the interface of LogSpace, so that it can be the grid of an ArrIrreg.
+ *
+ * gjl::TimeGrid<> grid;
+ * grid.append_linear(1, 100, 100);      // 1, 2, ..., 100
+ * grid.append_log(100, 1e6, 200);       // 100 is already there, and dropped
+ * ArrIrreg<double, gjl::TimeGrid<> > arr(grid);
+ * ARR_IRREG_CHECK_RECORD(arr, t, v);    // as for ArrIrreg<>
+ *
+ * The times are kept in a table, so operator[] is a load, and the
+ * ArrIrreg cursor advances by one index per recorded time, with no
+ * search. append_linear and append_log drop points that are not later
+ * than the last time, so pieces may share an end point. set_times
+ * requires strictly increasing times, and aborts otherwise.
+ *
+ * set_xa_xb_n(xa, xb, n) makes the grid that LogSpace(xa, xb, n) gives,
+ * value for value. Indices outside the grid give infinity, so that an
+ * exhausted cursor never records.
+ */
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <iostream>
+
+namespace gjl {
+
+  template< typename data_t = double>
+  class TimeGrid {
+  public:
+    typedef int ind_t;
+    typedef size_t uint_t;
+    TimeGrid() {}
+    TimeGrid(data_t xa, data_t xb, uint_t n) { set_xa_xb_n(xa,xb,n); }
+    explicit TimeGrid(const std::vector<data_t>& times) { set_times(times); }
+
+    // Log spaced, as LogSpace
+    inline void set_xa_xb_n(data_t xa, data_t xb, uint_t n) { clear(); append_log(xa,xb,n); }
+    inline void set_times(const std::vector<data_t>& times);
+    inline void clear() { table_.clear(); }
+
+    // Append n times from xa to xb, both included, linearly or log spaced
+    inline void append_linear(data_t xa, data_t xb, uint_t n);
+    inline void append_log(data_t xa, data_t xb, uint_t n);
+
+    inline ind_t lowest_index() const {return lowest_index_;}
+    inline ind_t highest_index() const {return lowest_index_ + (ind_t) table_.size() - 1;}
+    inline uint_t number_of_elements() const {return table_.size();}
+    inline data_t xa() const {return table_.empty() ? 0 : table_.front();}
+    inline data_t xb() const {return table_.empty() ? 0 : table_.back();}
+    // only lowest_index = 0 is supported by ArrIrreg now.
+    inline void set_lowest_index_fixed_n(ind_t i) { lowest_index_ = i;}
+    inline const std::vector<data_t>& times() const { return table_;}
+
+    inline data_t val(ind_t i) const {
+      const ind_t k = i - lowest_index_;
+      if (k >= 0 && k < (ind_t) table_.size()) return table_[k];
+      return std::numeric_limits<data_t>::has_infinity ?
+        std::numeric_limits<data_t>::infinity() : std::numeric_limits<data_t>::max();
+    }
+
+    inline data_t operator[] (ind_t i) const {return val(i);}
+
+  private:
+    ind_t lowest_index_ = 0;
+    std::vector<data_t> table_; // table_[k] is the time at index lowest_index_ + k
+
+    inline void append_if_later_(data_t t) {
+      if (table_.empty() || t > table_.back()) table_.push_back(t);
+    }
+  }; /*** END class TimeGrid */
+
+  template <typename data_t>
+  inline void TimeGrid<data_t>::set_times(const std::vector<data_t>& times) {
+    for(size_t i=1; i < times.size(); ++i)
+      if (! (times[i] > times[i-1])) {
+        std::cerr << "*** time_grid: times are not strictly increasing at index " << i << ".\n";
+        abort();
+      }
+    table_ = times;
+  }
+
+  template <typename data_t>
+  inline void TimeGrid<data_t>::append_linear(data_t xa, data_t xb, uint_t n) {
+    if (n == 1) append_if_later_(xa);
+    for(uint_t k=0; n > 1 && k < n; ++k)
+      append_if_later_(k == n - 1 ? xb : xa + (xb - xa) * k / (n - 1));
+  }
+
+  // The expression of LogSpace::make_table, so set_xa_xb_n agrees with LogSpace
+  template <typename data_t>
+  inline void TimeGrid<data_t>::append_log(data_t xa, data_t xb, uint_t n) {
+    const data_t fac = pow((xb / xa), 1.0/((ind_t) n - 1));
+    for(ind_t k=0; k < (ind_t) n; ++k) append_if_later_(xa * pow(fac, k));
+  }
+
+}
+
+#endif
@@ -0,0 +1,322 @@
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "gjl/hist_merger.h"
+#include "gjl/result_file.h"
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+namespace rf = gjl::result_file;
+typedef gjl::HistPdf<> hist_t;
+
+namespace {
+
+  /*
+   * The header of a histogram file, text or binary. Tallies are in the
+   * data coordinate, as printed.
+   */
+  struct FileShape {
+    size_t n_bins = 0;
+    bool log = false;
+    bool custom = false;
+    double min = 0;
+    double max = 0;
+    std::vector<double> edges; // custom bins, binary files only
+    std::string name;
+  };
+
+  struct FileTally {
+    size_t n_counts = 0;
+    size_t n_greater_than_max = 0;
+    size_t n_less_than_min = 0;
+    size_t num_trials = 0;
+    double data_min = 0;
+    double data_max = 0;
+  };
+
+  inline bool starts_with(const std::string& s, const char *prefix, std::string& rest) {
+    size_t n = strlen(prefix);
+    if (s.compare(0, n, prefix) != 0) return false;
+    rest = s.substr(n);
+    return true;
+  }
+
+  inline bool is_histogram_line(const std::string& s) {
+    return s.compare(0, 4, "####") == 0 && s.find("Histogram") != std::string::npos;
+  }
+
+  // Equal as printed with 6 digits
+  inline bool close_enough(double a, double b) {
+    return a == b || std::abs(a - b) <= 1e-5 * std::max(std::abs(a), std::abs(b));
+  }
+
+  /*
+   * Read the text header, up to the first data line, which is left in
+   * line. Return an empty string, or the error.
+   */
+  std::string read_text_header(std::istream& in, FileShape& s, FileTally& t, std::string& line) {
+    bool in_header = false;
+    bool have_nbins = false;
+    std::string v;
+    while (std::getline(in, line)) {
+      if (! in_header) {
+        in_header = is_histogram_line(line);
+        continue;
+      }
+      if (line.empty()) continue;
+      if (line[0] != '#') break;
+      if (starts_with(line, "# Ncounts ", v)) t.n_counts = strtoull(v.c_str(), nullptr, 10);
+      else if (starts_with(line, "# Min data ", v)) t.data_min = strtod(v.c_str(), nullptr);
+      else if (starts_with(line, "# Max data ", v)) t.data_max = strtod(v.c_str(), nullptr);
+      else if (starts_with(line, "# Min bin ", v)) s.min = strtod(v.c_str(), nullptr);
+      else if (starts_with(line, "# Max bin ", v)) s.max = strtod(v.c_str(), nullptr);
+      else if (starts_with(line, "# Nbins ", v)) {
+        s.n_bins = strtoull(v.c_str(), nullptr, 10);
+        have_nbins = true;
+      }
+      else if (starts_with(line, "# n greater than max ", v)) t.n_greater_than_max = strtoull(v.c_str(), nullptr, 10);
+      else if (starts_with(line, "# n less than min ", v)) t.n_less_than_min = strtoull(v.c_str(), nullptr, 10);
+      else if (starts_with(line, "# num_trials ", v)) t.num_trials = strtoull(v.c_str(), nullptr, 10);
+      else if (starts_with(line, "# Log spacing = ", v)) s.log = (v == "true");
+      else if (starts_with(line, "# Custom bins = ", v)) s.custom = (v == "true");
+      else if (starts_with(line, "# name: ", v)) s.name = v;
+    }
+    if (! in_header) return "no \"#### Histogram\" line";
+    if (! have_nbins || s.n_bins == 0) return "no \"# Nbins\" line";
+    if (s.custom) return "custom bins can only be read from binary files";
+    return "";
+  }
+
+  std::string read_binary_shape(const rf::MappedResult& m, FileShape& s) {
+    const rf::Header& h = m.header();
+    if (h.kind != rf::hist_pdf_kind) return "not a histogram";
+    if (h.cnt_type != rf::type_code<double>() || h.bin_type != rf::type_code<double>())
+      return "count or bin type is not double";
+    s.n_bins = h.n;
+    s.log = (h.flags & rf::log_flag) != 0;
+    s.custom = (h.flags & rf::custom_bins_flag) != 0;
+    s.min = h.min;
+    s.max = h.max;
+    if (s.custom) s.edges.assign(m.edges<double>(), m.edges<double>() + h.n + 1);
+    if (h.flags & rf::hist_name_flag) s.name = m.name();
+    return "";
+  }
+
+  std::string read_shape(const std::string& fname, FileShape& s) {
+    if (gjl::HistMerger::is_binary_file(fname)) {
+      rf::MappedResult m;
+      if (! m.open(fname, true)) return m.error();
+      return read_binary_shape(m, s);
+    }
+    std::ifstream in(fname);
+    if (! in) return "can't open for reading";
+    FileTally t;
+    std::string line;
+    return read_text_header(in, s, t, line);
+  }
+
+  // Empty histogram with shape s
+  void make_hist(const FileShape& s, hist_t& h) {
+    if (s.custom) h.init(s.edges);
+    else {
+      h.init(s.n_bins, s.min, s.max);
+      h.use_log(s.log);
+    }
+    h.clear();
+    h.num_trials(0);
+    if (! s.name.empty()) h.set_hist_name(s.name);
+  }
+
+  std::string shape_mismatch(const FileShape& s, const hist_t& h) {
+    std::ostringstream why;
+    if (s.n_bins != h.n_bins())
+      why << "number of bins " << s.n_bins << " vs " << h.n_bins();
+    else if (s.log != h.using_log())
+      why << "log spacing " << s.log << " vs " << h.using_log();
+    else if (s.custom != h.using_custom_bins())
+      why << "custom bins " << s.custom << " vs " << h.using_custom_bins();
+    else if (s.custom && s.edges != h.custom_bins())
+      why << "custom bin edges differ";
+    else if (! close_enough(s.min, h.init_min()) || ! close_enough(s.max, h.init_max()))
+      why << "bin range [" << s.min << ", " << s.max << "] vs ["
+          << h.init_min() << ", " << h.init_max() << "]";
+    return why.str();
+  }
+
+  void add_tally(hist_t& h, const FileTally& ft) {
+    gjl::hist_pdf::Tally<double> t;
+    t.n_counts = ft.n_counts;
+    t.n_greater_than_max = ft.n_greater_than_max;
+    t.n_less_than_min = ft.n_less_than_min;
+    t.data_min = h.to_internal(ft.data_min);
+    t.data_max = h.to_internal(ft.data_max);
+    h.merge_tally(t);
+    h.num_trials(h.num_trials() + ft.num_trials);
+  }
+
+  /*
+   * Add the data lines of a text file to acc. When there is a line for
+   * every bin, as when zeros are printed, line i goes to bin i.
+   * Otherwise each line goes to the bin that holds its center. Centers
+   * are printed with 6 digits, so are known only to center_precision
+   * times their size. It is an error if that spans more than one bin, if
+   * two lines go to one bin, or if a center is not within that of its
+   * bin. Nothing is added to acc unless every line is placed.
+   */
+  const double center_precision = 1e-5;
+
+  std::string add_text_file(std::istream& in, std::string& line, hist_t& acc) {
+    std::vector<double> centers, counts;
+    do {
+      if (line.empty() || line[0] == '#') continue;
+      const char *p = line.c_str();
+      char *end;
+      double center = strtod(p, &end);
+      if (end == p) return "bad data line: " + line;
+      p = end;
+      strtod(p, &end); // pdf
+      if (end == p) return "bad data line: " + line;
+      p = end;
+      double count = strtod(p, &end);
+      if (end == p) return "bad data line: " + line;
+      centers.push_back(center);
+      counts.push_back(count);
+    } while (std::getline(in, line));
+    const size_t n_bins = acc.n_bins();
+    if (centers.size() > n_bins) return "more data lines than bins";
+    const bool by_line = centers.size() == n_bins;
+    std::vector<size_t> idx(centers.size());
+    std::vector<char> used(n_bins, 0);
+    for(size_t j=0; j < centers.size(); ++j) {
+      const double c = centers[j];
+      const double u = center_precision * std::abs(c);
+      std::ostringstream why;
+      size_t i = j;
+      if (! by_line) {
+        i = acc.bin_index_internal(acc.to_internal(c));
+        if ((size_t) acc.bin_index_internal(acc.to_internal(c - u)) != i
+            || (size_t) acc.bin_index_internal(acc.to_internal(c + u)) != i) {
+          why << "bins are narrower than the printed precision of the centers, at center " << c;
+          return why.str();
+        }
+        if (used[i]++) {
+          why << "two data lines in bin " << i << ", at center " << c;
+          return why.str();
+        }
+      }
+      if (std::abs(c - acc.center(i)) > u + acc.bin_width(i) / 2) {
+        why << "center " << c << " is not in bin " << i << ", whose center is " << acc.center(i);
+        return why.str();
+      }
+      idx[j] = i;
+    }
+    for(size_t j=0; j < idx.size(); ++j) acc.add_to_counts(idx[j], counts[j]);
+    return "";
+  }
+
+  // Add the file to acc, which has the shape of the first file
+  std::string add_file(const std::string& fname, hist_t& acc) {
+    FileShape s;
+    std::string why;
+    if (gjl::HistMerger::is_binary_file(fname)) {
+      rf::MappedResult m;
+      if (! m.open(fname, true)) return m.error();
+      why = read_binary_shape(m, s);
+      if (why.empty()) why = shape_mismatch(s, acc);
+      if (! why.empty()) return why;
+      if (! rf::merge(m, acc)) return "shape mismatch";
+      return "";
+    }
+    std::ifstream in(fname);
+    if (! in) return "can't open for reading";
+    FileTally t;
+    std::string line;
+    why = read_text_header(in, s, t, line);
+    if (why.empty()) why = shape_mismatch(s, acc);
+    if (why.empty() && in) why = add_text_file(in, line, acc);
+    if (why.empty()) add_tally(acc, t);
+    return why;
+  }
+
+}
+
+bool gjl::HistMerger::is_binary_file(const std::string& fname) {
+  char buf[sizeof(rf::magic)];
+  std::ifstream in(fname, std::ios::binary);
+  return in.read(buf, sizeof(buf)) && memcmp(buf, rf::magic, sizeof(buf)) == 0;
+}
+
+bool gjl::HistMerger::read(const std::string& fname, hist_t& hist) {
+  return merge(std::vector<std::string>(1, fname), hist);
+}
+
+bool gjl::HistMerger::merge(const std::vector<std::string>& fnames, hist_t& total) {
+  error_.clear();
+  if (fnames.empty()) {
+    error_ = "no files to merge";
+    return false;
+  }
+  FileShape shape;
+  std::string why = read_shape(fnames[0], shape);
+  if (! why.empty()) {
+    error_ = "'" + fnames[0] + "': " + why;
+    return false;
+  }
+  int n_threads = n_threads_;
+#ifdef _OPENMP
+  if (n_threads <= 0) n_threads = omp_get_max_threads();
+#else
+  n_threads = 1;
+#endif
+  if ((size_t) n_threads > fnames.size()) n_threads = fnames.size();
+  std::vector<hist_t> acc(n_threads);
+  std::vector<std::string> errors(n_threads);
+  std::vector<size_t> error_file(n_threads, fnames.size());
+  std::atomic<bool> failed(false);
+
+  // Contiguous runs of files, so the order of the sums is fixed. The runs
+  // are shared out by omp for, so all are done even if fewer threads start.
+#pragma omp parallel for num_threads(n_threads) schedule(static,1)
+  for(int r=0; r < n_threads; ++r) {
+    make_hist(shape, acc[r]);
+    size_t first = fnames.size() * r / n_threads;
+    size_t last = fnames.size() * (r + 1) / n_threads;
+    for(size_t i = first; i < last && ! failed.load(std::memory_order_relaxed); ++i) {
+      std::string why = add_file(fnames[i], acc[r]);
+      if (! why.empty()) {
+        errors[r] = why;
+        error_file[r] = i;
+        failed = true;
+      }
+    }
+  }
+  if (failed) {
+    int bad = 0;
+    for(int j=1; j < n_threads; ++j)
+      if (error_file[j] < error_file[bad]) bad = j;
+    error_ = "'" + fnames[error_file[bad]] + "': " + errors[bad];
+    if (error_file[bad] > 0) error_ += " (compared with '" + fnames[0] + "')";
+    return false;
+  }
+
+  // Tree reduction: 0 += 1, 2 += 3, ...; then 0 += 2, ...
+  for(int stride = 1; stride < n_threads; stride *= 2) {
+#pragma omp parallel for num_threads(n_threads)
+    for(int j = 0; j < n_threads - stride; j += 2 * stride)
+      acc[j].merge(acc[j + stride]);
+  }
+  total = acc[0];
+  total.num_merged_hists(fnames.size() - 1);
+  return true;
+}
@@ -8,7 +8,9 @@ use v5.14.0;
 # test_hist_pdf actually prints to stderr if tests fail.
 
 my $test_dir = "./test_src";
-my @tests = qw( test_hist_pdf simple_linear_regression_test test_cpu_timer vec2d test_arr_irreg);
+my @tests = qw( test_hist_pdf simple_linear_regression_test test_cpu_timer vec2d test_arr_irreg test_result_file test_hist_merger test_auto_hist_pdf test_hist_pdf_2d test_quantile_sketch test_simp_stat test_blocking_stat test_linear_regression_accumulator test_power_law_fit test_log_data test_log_space test_packed_arr_irreg test_arr_irreg_multi test_arr_irreg_errors test_time_grid);
+# Run again with fewer threads than the tests ask for
+my @thread_limited_tests = qw( test_hist_merger test_hist_pdf test_hist_pdf_2d );
 
 sub dosys {
     my $c = shift;
@@ -32,4 +34,11 @@ sub run_tests_for_stderr {
     }
 }
 
+sub run_thread_limited_tests_for_stderr {
+    foreach my $test (@thread_limited_tests) {
+        dosys('OMP_THREAD_LIMIT=2 ' . exepath($test) . ' > /dev/null');
+    }
+}
+
 run_tests_for_stderr();
+run_thread_limited_tests_for_stderr();
@@ -0,0 +1,196 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include "gjl/cpu_timer.h"
+#include "gjl/arr_irreg.h"
+#include "gjl/packed_arr_irreg.h"
+#include "gjl/arr_irreg_multi.h"
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/**********************************************************************
+ *  Benchmark for ArrIrreg in a walk loop. The time check is done as it
+ *  was before LogSpace kept a table, with pow on every step, and with
+ *  ARR_IRREG_CHECK_RECORD, on a LogSpace and on a TimeGrid with the
+ *  same times. The results must agree. Then ArrIrreg
+ *  against PackedArrIrreg for many walkers: recording, and merging
+ *  one copy per walker. Last, three observables in three ArrIrreg
+ *  against one ArrIrregMulti<3>.
+ *********************************************************************/
+
+// ArrIrreg as it was: the next time computed with pow on every check
+struct PowArrIrreg {
+  gjl::LogSpace<> time;
+  std::vector<double> sums;
+  std::vector<size_t> counts;
+  int index = 0;
+  PowArrIrreg(double xa, double xb, size_t n) : time(xa, xb, n), sums(n), counts(n) {}
+  double get_next_time() const { return time.compute_val(index); }
+  bool over_max_ind() const { return index >= (int) time.number_of_elements(); }
+  void record_arr(double v) { ++counts[index]; sums[index++] += v; }
+};
+
+// 1-d walk with a cheap generator, so the time check is a visible part of the cost
+struct Walk {
+  uint64_t state = 88172645463325252ull;
+  long x = 0;
+  inline void step() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    x += (state & 1) ? 1 : -1;
+  }
+};
+
+int bench_many_walkers () {
+  const size_t n_walkers = 2000, n_steps = 1000, n_copies = 10000, n_times = 300;
+  std::cout << "\n" << n_walkers << " walkers of " << n_steps << " steps\n";
+  std::vector<double> ts(n_walkers * n_steps), vs(n_walkers * n_steps);
+  Walk walk;
+  for(size_t w=0; w < n_walkers; ++w) {
+    walk.x = 0;
+    for(size_t i=0; i < n_steps; ++i) {
+      walk.step();
+      ts[w * n_steps + i] = i + 1;
+      vs[w * n_steps + i] = (double) walk.x * walk.x;
+    }
+  }
+  ArrIrreg<> arr(1, n_steps, n_times);
+  PackedArrIrreg<> packed(1, n_steps, n_times);
+  CpuTimer t;
+  t.split_seconds();
+  for(size_t w=0; w < n_walkers; ++w) {
+    arr.reset_index();
+    for(size_t i=0; i < n_steps; ++i)
+      ARR_IRREG_CHECK_RECORD(arr, ts[w * n_steps + i], vs[w * n_steps + i]);
+  }
+  std::cout << "ArrIrreg, macro            ";
+  t.print_split_seconds();
+  packed.record_streams(ts.data(), vs.data(), n_walkers, n_steps);
+  std::cout << "PackedArrIrreg streams     ";
+  t.print_split_seconds();
+  for(size_t i=0; i < n_times; ++i)
+    if (packed.arrsum(i) != arr.arrsum(i) || packed.counts(i) != arr.counts(i)) {
+      std::cerr << "*** bench_arr_irreg: recorded results differ at " << i << "\n";
+      return 1;
+    }
+  std::cout << "merge " << n_copies << " copies\n";
+  std::vector<ArrIrreg<> > arrs(n_copies, arr);
+  std::vector<PackedArrIrreg<> > packeds(n_copies, packed);
+  t.split_seconds();
+  ArrIrreg<> total(1, n_steps, n_times);
+  for(size_t j=0; j < n_copies; ++j) total.merge(arrs[j]);
+  std::cout << "ArrIrreg, in a row         ";
+  t.print_split_seconds();
+  PackedArrIrreg<>::merge_tree(packeds);
+  std::cout << "PackedArrIrreg merge_tree  ";
+  t.print_split_seconds();
+  for(size_t i=0; i < n_times; ++i)
+    if (packeds[0].counts(i) != total.counts(i)) {
+      std::cerr << "*** bench_arr_irreg: merged results differ at " << i << "\n";
+      return 1;
+    }
+  return 0;
+}
+
+int bench_multi () {
+  const size_t n_steps = 10 * 1000 * 1000, n_walks = 3, n_times = 300;
+  std::cout << "\nthree observables, " << n_walks << " walks of " << n_steps << " steps\n";
+  std::vector<ArrIrreg<> > arrs(3, ArrIrreg<>(1, n_steps, n_times));
+  ArrIrregMulti<3> multi(1, n_steps, n_times);
+  CpuTimer t;
+  t.split_seconds();
+  for(size_t w=0; w < n_walks; ++w) {
+    Walk walk;
+    double n_zero = 0;
+    for(auto& arr : arrs) arr.reset_index();
+    for(size_t i=1; i <= n_steps; ++i) {
+      walk.step();
+      n_zero += walk.x == 0;
+      ARR_IRREG_CHECK_RECORD(arrs[0], i, (double) walk.x * walk.x);
+      ARR_IRREG_CHECK_RECORD(arrs[1], i, (double) walk.x);
+      ARR_IRREG_CHECK_RECORD(arrs[2], i, n_zero);
+    }
+  }
+  std::cout << "three ArrIrreg             ";
+  t.print_split_seconds();
+  for(size_t w=0; w < n_walks; ++w) {
+    Walk walk;
+    double n_zero = 0;
+    multi.reset_index();
+    for(size_t i=1; i <= n_steps; ++i) {
+      walk.step();
+      n_zero += walk.x == 0;
+      ArrIrregMulti<3>::row_t v = {{ (double) walk.x * walk.x, (double) walk.x, n_zero }};
+      ARR_IRREG_CHECK_RECORD(multi, i, v);
+    }
+  }
+  std::cout << "ArrIrregMulti<3>           ";
+  t.print_split_seconds();
+  for(size_t i=0; i < n_times; ++i)
+    for(size_t k=0; k < 3; ++k)
+      if (multi.arrsum(i,k) != arrs[k].arrsum(i) || multi.counts(i) != arrs[k].counts(i)) {
+        std::cerr << "*** bench_arr_irreg: multi results differ at " << i << "\n";
+        return 1;
+      }
+  return 0;
+}
+
+int main () {
+  const size_t n_steps = 10 * 1000 * 1000, n_walks = 5, n_times = 300;
+  std::cout << "ArrIrreg in a walk loop, " << n_walks << " walks of " << n_steps << " steps, "
+            << n_times << " times\n";
+  PowArrIrreg old(1, n_steps, n_times);
+  ArrIrreg<> arr(1, n_steps, n_times);
+  CpuTimer t;
+  t.split_seconds();
+  for(size_t w=0; w < n_walks; ++w) {
+    Walk walk;
+    old.index = 0;
+    for(size_t i=1; i <= n_steps; ++i) {
+      walk.step();
+      if (! old.over_max_ind()) {
+        auto curtime = i + 1e-10;
+        while (curtime >= old.get_next_time() && ! old.over_max_ind())
+          old.record_arr((double) walk.x * walk.x);
+      }
+    }
+  }
+  std::cout << "pow on every step          ";
+  t.print_split_seconds();
+  for(size_t w=0; w < n_walks; ++w) {
+    Walk walk;
+    arr.reset_index();
+    for(size_t i=1; i <= n_steps; ++i) {
+      walk.step();
+      ARR_IRREG_CHECK_RECORD(arr, i, (double) walk.x * walk.x);
+    }
+  }
+  std::cout << "ARR_IRREG_CHECK_RECORD     ";
+  t.print_split_seconds();
+  ArrIrreg<double, gjl::TimeGrid<> > grid_arr(gjl::TimeGrid<>(1, n_steps, n_times));
+  for(size_t w=0; w < n_walks; ++w) {
+    Walk walk;
+    grid_arr.reset_index();
+    for(size_t i=1; i <= n_steps; ++i) {
+      walk.step();
+      ARR_IRREG_CHECK_RECORD(grid_arr, i, (double) walk.x * walk.x);
+    }
+  }
+  std::cout << "same, on a TimeGrid        ";
+  t.print_split_seconds();
+  for(size_t i=0; i < n_times; ++i)
+    if (old.sums[i] != arr.arrsum(i) || old.counts[i] != arr.counts(i)
+        || grid_arr.arrsum(i) != arr.arrsum(i)) {
+      std::cerr << "*** bench_arr_irreg: results differ at " << i << "\n";
+      return 1;
+    }
+  if (bench_many_walkers() != 0) return 1;
+  return bench_multi();
+}
@@ -0,0 +1,281 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include "gjl/cpu_timer.h"
+#include "gjl/hist_pdf.h"
+#include "gjl/static_hist_pdf.h"
+#include "gjl/count_hist_pdf.h"
+#include "gjl/quantile_sketch.h"
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/**********************************************************************
+ *  Benchmarks for HistPdf. Each section times the old way of doing
+ *  something against the new way, and checks that the results agree.
+ *********************************************************************/
+
+typedef gjl::HistPdf<> hist_t;
+
+std::vector<double> make_samples (size_t n, double lo, double hi) {
+  std::mt19937_64 generator;
+  std::uniform_real_distribution<double> distribution(lo,hi);
+  std::vector<double> v(n);
+  for(size_t i=0; i < n; ++i) v[i] = distribution(generator);
+  return v;
+}
+
+void check_same (const hist_t& a, const hist_t& b) {
+  if ( a != b || a.n_counts() != b.n_counts()
+       || a.n_greater_than_max() != b.n_greater_than_max()
+       || a.data_max() != b.data_max() )
+    std::cerr << "*** bench_hist_pdf: results differ.\n";
+}
+
+// add_count one sample at a time vs. add_counts
+void bench_add_counts (const std::vector<double>& v, bool uselog) {
+  std::cout << "\nadd_count loop vs. add_counts, " << v.size() << " samples, log = "
+            << (uselog ? "true" : "false") << "\n";
+  hist_t a(1000,0.1,100,uselog);
+  hist_t b(1000,0.1,100,uselog);
+  CpuTimer t;
+  t.split_seconds();
+  for(size_t i=0; i < v.size(); ++i) a.add_count(v[i]);
+  std::cout << "add_count  ";
+  t.print_split_seconds();
+  b.add_counts(v.begin(), v.end());
+  std::cout << "add_counts ";
+  t.print_split_seconds();
+  check_same(a,b);
+}
+
+// log10 on each sample vs. fast log binning, and number of samples that land in different bins
+void bench_fast_log (const std::vector<double>& v) {
+  std::cout << "\nlog10 binning vs. fast log binning, " << v.size() << " samples\n";
+  hist_t a(1000,0.1,1e7,true);
+  hist_t b(1000,0.1,1e7,true);
+  hist_t c(1000,0.1,1e7,true);
+  hist_t d(1000,0.1,1e7,true);
+  c.use_fast_log(true);
+  d.use_fast_log(true);
+  CpuTimer t;
+  t.split_seconds();
+  for(size_t i=0; i < v.size(); ++i) a.add_count(v[i]);
+  std::cout << "add_count           ";
+  t.print_split_seconds();
+  b.add_counts(v.begin(), v.end());
+  std::cout << "add_counts          ";
+  t.print_split_seconds();
+  for(size_t i=0; i < v.size(); ++i) c.add_count(v[i]);
+  std::cout << "fast log add_count  ";
+  t.print_split_seconds();
+  d.add_counts(v.begin(), v.end());
+  std::cout << "fast log add_counts ";
+  t.print_split_seconds();
+  check_same(a,b);
+  check_same(c,d);
+  double ndiff = 0;
+  for(size_t i=0; i < a.n_bins(); ++i) ndiff += std::abs(a.count(i) - c.count(i));
+  std::cout << "samples in different bins: " << ndiff / 2 << "\n";
+}
+
+// uniform bins vs. the same bins given as custom edges
+void bench_custom_bins (const std::vector<double>& v) {
+  std::cout << "\nuniform bins vs. custom bins, " << v.size() << " samples\n";
+  hist_t a(1000,0,100);
+  std::vector<double> e(1001);
+  for(size_t i=0; i <= 1000; ++i) e[i] = i * 0.1;
+  hist_t b(e);
+  CpuTimer t;
+  t.split_seconds();
+  a.add_counts(v.begin(), v.end());
+  std::cout << "uniform add_counts ";
+  t.print_split_seconds();
+  b.add_counts(v.begin(), v.end());
+  std::cout << "custom add_counts  ";
+  t.print_split_seconds();
+  double ndiff = 0;
+  for(size_t i=0; i < a.n_bins(); ++i) ndiff += std::abs(a.count(i) - b.count(i));
+  std::cout << "samples in different bins: " << ndiff / 2 << "\n";
+}
+
+// add_counts vs. add_counts_parallel. CpuTimer counts all threads, so this uses the wall clock.
+void bench_parallel (const std::vector<double>& v) {
+  typedef std::chrono::steady_clock clock;
+  std::cout << "\nadd_counts vs. add_counts_parallel, " << v.size() << " samples, wall time\n";
+  hist_t a(1000,0,100);
+  hist_t b(1000,0,100);
+  auto t0 = clock::now();
+  a.add_counts(v.begin(), v.end());
+  auto t1 = clock::now();
+  b.add_counts_parallel(v.begin(), v.end());
+  auto t2 = clock::now();
+  std::cout << "add_counts          " << std::chrono::duration<double>(t1 - t0).count() << " s\n";
+  std::cout << "add_counts_parallel " << std::chrono::duration<double>(t2 - t1).count() << " s\n";
+  check_same(a,b);
+}
+
+// print_pdf through an ofstream vs. write_pdf, which formats in a buffer and writes once
+void bench_write (const std::vector<double>& v) {
+  typedef std::chrono::steady_clock clock;
+  const size_t n_bins = 1000 * 1000;
+  std::cout << "\nprint_pdf vs. write_pdf, " << n_bins << " bins, wall time\n";
+  hist_t h(n_bins,0,110);
+  h.add_counts(v.begin(), v.end());
+  h.zero_printing_on();
+  std::string base = "/tmp/bench_hist_pdf." + std::to_string(getpid());
+  gjl::TextBuffer buf;
+  auto t1 = clock::now();
+  {
+    std::ofstream out(base + ".b");
+    h.print_pdf(out);
+  }
+  auto t2 = clock::now();
+  h.write_pdf(base + ".c", buf);
+  auto t3 = clock::now();
+  h.write_pdf(base + ".c", buf);
+  auto t4 = clock::now();
+  std::cout << "print_pdf(ofstream)  " << std::chrono::duration<double>(t2 - t1).count() << " s\n";
+  std::cout << "write_pdf            " << std::chrono::duration<double>(t3 - t2).count() << " s\n";
+  std::cout << "write_pdf, reuse buf " << std::chrono::duration<double>(t4 - t3).count() << " s\n";
+  std::ifstream b(base + ".b"), c(base + ".c");
+  std::stringstream sb, sc;
+  sb << b.rdbuf();
+  sc << c.rdbuf();
+  if (sb.str() != sc.str()) std::cerr << "*** bench_hist_pdf: results differ.\n";
+  remove((base + ".b").c_str());
+  remove((base + ".c").c_str());
+}
+
+// HistPdf vs. StaticHistPdf with the same shape
+void bench_static (const std::vector<double>& v) {
+  std::cout << "\nHistPdf vs. StaticHistPdf, " << v.size() << " samples\n";
+  hist_t a(1000,0,100);
+  hist_t b(1000,0,100);
+  gjl::StaticHistPdf<1000, gjl::IntRange<0,100> > c;
+  gjl::StaticHistPdf<1000, gjl::IntRange<0,100> > d;
+  CpuTimer t;
+  t.split_seconds();
+  for(size_t i=0; i < v.size(); ++i) a.add_count(v[i]);
+  std::cout << "HistPdf add_count        ";
+  t.print_split_seconds();
+  b.add_counts(v.begin(), v.end());
+  std::cout << "HistPdf add_counts       ";
+  t.print_split_seconds();
+  for(size_t i=0; i < v.size(); ++i) c.add_count(v[i]);
+  std::cout << "StaticHistPdf add_count  ";
+  t.print_split_seconds();
+  d.add_counts(v.begin(), v.end());
+  std::cout << "StaticHistPdf add_counts ";
+  t.print_split_seconds();
+  check_same(a,c.to_hist_pdf());
+  check_same(a,d.to_hist_pdf());
+}
+
+// add_weighted_count loop vs. add_weighted_counts, naive vs. compensated summation
+void bench_weights (const std::vector<double>& v) {
+  std::cout << "\nweighted counts, " << v.size() << " samples, naive vs. compensated summation\n";
+  std::vector<double> w(v.size());
+  for(size_t i=0; i < v.size(); ++i) w[i] = 1e-3 * (1 + (i % 1000));
+  hist_t a(1000,0,100);
+  hist_t b(1000,0,100);
+  hist_t c(1000,0,100);
+  c.weight_summation(gjl::hist_pdf::compensated_summation);
+  CpuTimer t;
+  t.split_seconds();
+  for(size_t i=0; i < v.size(); ++i) a.add_weighted_count(v[i], w[i]);
+  std::cout << "add_weighted_count, naive        ";
+  t.print_split_seconds();
+  b.add_weighted_counts(v.begin(), v.end(), w.begin());
+  std::cout << "add_weighted_counts, naive       ";
+  t.print_split_seconds();
+  c.add_weighted_counts(v.begin(), v.end(), w.begin());
+  std::cout << "add_weighted_counts, compensated ";
+  t.print_split_seconds();
+  std::vector<long double> exact(a.n_bins(), 0);
+  for(size_t i=0; i < v.size(); ++i) exact[a.bin_index_internal(a.to_internal(v[i]))] += w[i];
+  double err_b = 0, err_c = 0;
+  for(size_t i=0; i < a.n_bins(); ++i) {
+    err_b = std::max(err_b, (double) std::abs((b.count(i) - exact[i]) / exact[i]));
+    err_c = std::max(err_c, (double) std::abs((c.count(i) - exact[i]) / exact[i]));
+  }
+  std::cout << "largest relative error in a bin: naive " << err_b << ", compensated " << err_c << "\n";
+  check_same(a,b);
+}
+
+// HistPdf<> vs. CountHistPdf<>, filling and merging, with bins that overflow L2 as doubles
+void bench_integer_counts (const std::vector<double>& v) {
+  const size_t n_bins = 200 * 1000;
+  std::cout << "\nHistPdf<> vs. CountHistPdf<>, " << v.size() << " samples, "
+            << n_bins << " bins\n";
+  hist_t a(n_bins,0,110);
+  hist_t a1(n_bins,0,110);
+  gjl::CountHistPdf<> b(n_bins,0,110);
+  gjl::CountHistPdf<> b1(n_bins,0,110);
+  CpuTimer t;
+  t.split_seconds();
+  a.add_counts(v.begin(), v.end());
+  std::cout << "HistPdf add_counts         ";
+  t.print_split_seconds();
+  b.add_counts(v.begin(), v.end());
+  std::cout << "CountHistPdf add_counts    ";
+  t.print_split_seconds();
+  a1.add_counts(v.begin(), v.begin() + v.size() / 10);
+  b1.add_counts(v.begin(), v.begin() + v.size() / 10);
+  t.split_seconds();
+  for(int i=0; i < 100; ++i) a.merge(a1);
+  std::cout << "HistPdf merge x 100        ";
+  t.print_split_seconds();
+  for(int i=0; i < 100; ++i) b.merge(b1);
+  std::cout << "CountHistPdf merge x 100   ";
+  t.print_split_seconds();
+  check_same(a,b.to_hist_pdf());
+}
+
+void bench_quantile_sketch (const std::vector<double>& v) {
+  std::cout << "\nHistPdf<> vs. QuantileSketch<>, " << v.size() << " samples\n";
+  hist_t a(1000,0,110);
+  gjl::QuantileSketch<> b;
+  gjl::QuantileSketch<> b1;
+  CpuTimer t;
+  t.split_seconds();
+  a.add_counts(v.begin(), v.end());
+  std::cout << "HistPdf add_counts         ";
+  t.print_split_seconds();
+  b.record(v.begin(), v.end());
+  std::cout << "QuantileSketch record      ";
+  t.print_split_seconds();
+  b1.record(v.begin(), v.begin() + v.size() / 10);
+  t.split_seconds();
+  for(int i=0; i < 100; ++i) b.merge(b1);
+  std::cout << "QuantileSketch merge x 100 ";
+  t.print_split_seconds();
+  std::string buf;
+  b.serialize(buf);
+  std::cout << "median " << b.quantile(0.5) << ", " << b.size() << " samples kept, "
+            << buf.size() << " bytes serialized\n";
+}
+
+int main () {
+  auto v = make_samples(50 * 1000 * 1000, 0, 110);
+  bench_add_counts(v,false);
+  bench_add_counts(v,true);
+  bench_custom_bins(v);
+  bench_static(v);
+  bench_weights(v);
+  bench_integer_counts(v);
+  bench_quantile_sketch(v);
+  bench_parallel(v);
+  bench_write(v);
+  for(size_t i=0; i < v.size(); ++i) v[i] = pow(10, v[i] / 10 - 2);
+  bench_fast_log(v);
+  return 0;
+}
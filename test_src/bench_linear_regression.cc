@@ -0,0 +1,83 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include "gjl/cpu_timer.h"
+#include "gjl/simple_linear_regression.h"
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/**********************************************************************
+ *  Benchmarks for simple_linear_regression. fit_range against the
+ *  accumulator, one point at a time, with add_range, and windowed.
+ *  Then many series against one x.
+ *********************************************************************/
+
+int main () {
+  const size_t n = 20 * 1000 * 1000;
+  std::mt19937_64 generator;
+  std::uniform_real_distribution<double> noise(-1, 1);
+  std::vector<double> x(n), y(n);
+  for(size_t i=0; i < n; ++i) {
+    x[i] = i * 1e-6;
+    y[i] = 3.4 * x[i] + 2.1 + noise(generator);
+  }
+  std::cout << "linear fit, " << n << " points\n";
+  CpuTimer t;
+  t.split_seconds();
+  simple_linear_regression<double> fit;
+  fit.fit_range(x.begin(), x.end(), y.begin());
+  std::cout << "fit_range                  ";
+  t.print_split_seconds();
+  linear_regression_accumulator<double> a;
+  for(size_t i=0; i < n; ++i) a.add(x[i], y[i]);
+  std::cout << "accumulator add            ";
+  t.print_split_seconds();
+  linear_regression_accumulator<double> b;
+  b.add_range(x.begin(), x.end(), y.begin());
+  std::cout << "accumulator add_range      ";
+  t.print_split_seconds();
+  windowed_linear_regression<double> w(1000);
+  for(size_t i=0; i < n; ++i) w.add(x[i], y[i]);
+  std::cout << "windowed add, window 1000  ";
+  t.print_split_seconds();
+  std::cout << "slopes " << fit.slope() << " " << a.slope() << " " << b.slope() << "\n";
+  fit.fit_range(x.end() - 1000, x.end(), y.end() - 1000);
+  std::cout << "last 1000 points, slopes " << fit.slope() << " " << w.slope() << "\n";
+
+  const size_t n_series = 200, n_points = 50 * 1000;
+  std::cout << "\n" << n_series << " series against one x, " << n_points << " points\n";
+  std::vector<std::vector<double> > cols(n_series, std::vector<double>(n_points));
+  std::vector<double> rows(n_series * n_points);
+  for(size_t k=0; k < n_series; ++k)
+    for(size_t i=0; i < n_points; ++i)
+      rows[i * n_series + k] = cols[k][i] = k * x[i] + noise(generator);
+  std::vector<double> xs(x.begin(), x.begin() + n_points);
+  t.split_seconds();
+  double sum_slopes = 0;
+  for(size_t k=0; k < n_series; ++k) {
+    fit.fit_range(xs.begin(), xs.end(), cols[k].begin());
+    sum_slopes += fit.slope();
+  }
+  std::cout << "fit_range for each         ";
+  t.print_split_seconds();
+  multi_linear_regression<double> mfit;
+  mfit.fit_columns(xs.begin(), xs.end(), cols);
+  std::cout << "fit_columns                ";
+  t.print_split_seconds();
+  double sum_c = 0;
+  for(size_t k=0; k < n_series; ++k) sum_c += mfit.slope(k);
+  t.split_seconds();
+  mfit.fit_rows(xs.begin(), xs.end(), rows.begin(), n_series);
+  std::cout << "fit_rows                   ";
+  t.print_split_seconds();
+  double sum_r = 0;
+  for(size_t k=0; k < n_series; ++k) sum_r += mfit.slope(k);
+  std::cout << "sums of slopes " << sum_slopes << " " << sum_c << " " << sum_r << "\n";
+  return 0;
+}
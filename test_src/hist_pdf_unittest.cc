@@ -37,6 +37,15 @@ TEST(EQTests, FindIndex) {
   EXPECT_TRUE( idx == 2 );
 }
 
+TEST(EQTests, CustomBinIndex) {
+  std::vector<double> e = {0, 1, 3, 7, 15};
+  hist_t h(e);
+  EXPECT_EQ(h.find_index(-1), 0u);
+  EXPECT_EQ(h.find_index(2.99), 1u);
+  EXPECT_EQ(h.find_index(3), 2u);
+  EXPECT_EQ(h.find_index(100), 3u);
+  EXPECT_EQ(h.bin_width(3), 8);
+}
 
 /////////////////////////////////////////////////////
 #include <stdio.h>
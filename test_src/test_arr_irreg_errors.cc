@@ -0,0 +1,78 @@
+#include <random>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include "gjl/arr_irreg.h"
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+// Variance and standard error agree with a direct computation, also after merge
+bool test_1 () {
+  const int n_times = 6, n_a = 40, n_b = 25;
+  std::mt19937_64 generator(1);
+  std::normal_distribution<double> normal(5, 2);
+  std::vector<std::vector<double> > vals(n_times);
+  ArrIrreg<> a(1, 1000, n_times), b(1, 1000, n_times);
+  a.keep_sum_squares();
+  b.keep_sum_squares();
+  for(int j=0; j < n_a + n_b; ++j) {
+    ArrIrreg<>& arr = j < n_a ? a : b;
+    arr.reset_index();
+    for(int i=0; i < n_times; ++i) {
+      const double v = normal(generator) * (i + 1);
+      vals[i].push_back(v);
+      arr.record_arr(v);
+    }
+  }
+  a.merge(b);
+  for(int i=0; i < n_times; ++i) {
+    double m = 0, v = 0;
+    for(double x : vals[i]) m += x;
+    m /= vals[i].size();
+    for(double x : vals[i]) v += (x - m) * (x - m);
+    v /= vals[i].size() - 1;
+    if (std::abs(a.get_variance(i) / v - 1) > 1e-12
+        || std::abs(a.get_stderr(i) / std::sqrt(v / vals[i].size()) - 1) > 1e-12
+        || std::abs(a.get_weight(i) * v / vals[i].size() - 1) > 1e-12)
+      return false;
+  }
+  return a.counts(0) == n_a + n_b;
+}
+
+// Off by default, no errors with one value, and printing
+bool test_2 () {
+  ArrIrreg<> plain(1, 100, 3), a(1, 100, 3);
+  a.keep_sum_squares();
+  plain.record_arr(2);
+  a.record_arr(2);
+  a.reset_index();
+  a.record_arr(4);
+  a.record_arr(1);
+  std::ostringstream out;
+  a.print_arr_with_errors(out);
+  return ! plain.has_sum_squares() && plain.arrsum2_data() == nullptr && plain.get_stderr(0) == 0
+    && a.get_variance(1) == 0 && a.get_weight(1) == 0
+    && out.str() == "1 3 1 2\n10 1 0 1\n100 0 0 0\n";
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
@@ -0,0 +1,98 @@
+#include <random>
+#include <sstream>
+#include <vector>
+#include <iostream>
+#include "gjl/arr_irreg.h"
+#include "gjl/arr_irreg_multi.h"
+
+typedef ArrIrregMulti<3> multi_t;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+// Record walks into m and into three ArrIrreg, one per observable
+void record_walks (size_t n_walkers, size_t n_steps, unsigned seed, multi_t& m, std::vector<ArrIrreg<> >& a) {
+  std::mt19937_64 generator(seed);
+  std::exponential_distribution<double> dt(1.0);
+  std::uniform_int_distribution<int> step(0, 1);
+  for(size_t w=0; w < n_walkers; ++w) {
+    double t = 0, x = 0, n_zero = 0;
+    m.reset_index();
+    for(auto& arr : a) arr.reset_index();
+    for(size_t i=0; i < n_steps; ++i) {
+      t += dt(generator);
+      x += step(generator) ? 1 : -1;
+      if (x == 0) ++n_zero;
+      multi_t::row_t v = {{ x * x, x, n_zero }};
+      ARR_IRREG_CHECK_RECORD(m, t, v);
+      for(size_t k=0; k < 3; ++k)
+        ARR_IRREG_CHECK_RECORD(a[k], t, v[k]);
+    }
+  }
+}
+
+// One cursor records what three ArrIrreg do
+bool test_1 () {
+  multi_t m(1, 2000, 40);
+  std::vector<ArrIrreg<> > a(3, ArrIrreg<>(1, 2000, 40));
+  record_walks(30, 3000, 1, m, a);
+  for(int i=0; i < m.number_of_elements(); ++i)
+    for(size_t k=0; k < 3; ++k)
+      if (m.arrsum(i,k) != a[k].arrsum(i) || m.counts(i) != a[k].counts(i) || m.get_arr(i,k) != a[k].get_arr(i))
+        return false;
+  ArrIrreg<> c;
+  m.column(1, c);
+  for(int i=0; i < m.number_of_elements(); ++i)
+    if (c.arrsum(i) != a[1].arrsum(i) || c.counts(i) != a[1].counts(i)) return false;
+  return m.counts(0) == 30 && multi_t::number_of_observables() == 3;
+}
+
+// merge adds all columns and the counts
+bool test_2 () {
+  multi_t m(1, 500, 20), n(1, 500, 20), total(1, 500, 20);
+  std::vector<ArrIrreg<> > a(3, ArrIrreg<>(1, 500, 20));
+  record_walks(10, 800, 2, m, a);
+  record_walks(15, 800, 3, n, a);
+  total.merge(m);
+  total.merge(n);
+  for(int i=0; i < total.number_of_elements(); ++i) {
+    if (total.counts(i) != m.counts(i) + n.counts(i) || total.counts(i) != a[0].counts(i)) return false;
+    for(size_t k=0; k < 3; ++k)
+      if (total.arrsum(i,k) != m.arrsum(i,k) + n.arrsum(i,k)) return false;
+  }
+  return total.counts(0) == 25;
+}
+
+// Printing all columns together
+bool test_3 () {
+  ArrIrregMulti<2> m(1, 100, 3);
+  const double v[2] = { 2, 4 };
+  while (! m.over_max_ind()) m.record_arr(v);
+  m.reset_index();
+  m.record_arr(v);
+  std::ostringstream out, out2;
+  m.print_arr(out);
+  m.print_arr_with_counts(out2);
+  return out.str() == "1 2 4\n10 2 4\n100 2 4\n" && out2.str() == "1 2 4 2\n10 2 4 1\n100 2 4 1\n";
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
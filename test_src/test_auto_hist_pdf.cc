@@ -0,0 +1,140 @@
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include "gjl/auto_hist_pdf.h"
+
+typedef gjl::AutoHistPdf<> auto_hist_t;
+typedef gjl::HistPdf<> hist_t;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+// Normal data that drifts, so the range keeps growing while streaming
+std::vector<double> drifting_data (size_t n, unsigned seed = 1) {
+  std::mt19937_64 generator(seed);
+  std::normal_distribution<double> distribution(0,1);
+  std::vector<double> v(n);
+  for(size_t i=0; i < n; ++i) v[i] = distribution(generator) * (1 + i * 1e-3) + i * 1e-3;
+  return v;
+}
+
+std::vector<double> log_data (size_t n, unsigned seed = 1) {
+  std::mt19937_64 generator(seed);
+  std::uniform_real_distribution<double> distribution(-3,5);
+  std::vector<double> v(n);
+  for(size_t i=0; i < n; ++i) v[i] = pow(10, distribution(generator));
+  return v;
+}
+
+bool same_hists (const hist_t& a, const hist_t& b) {
+  if (a.n_bins() != b.n_bins() || a.n_counts() != b.n_counts()
+      || a.min() != b.min() || a.max() != b.max()
+      || a.data_min() != b.data_min() || a.data_max() != b.data_max()) return false;
+  for(size_t i=0; i < a.n_bins(); ++i)
+    if (a.count(i) != b.count(i)) return false;
+  return true;
+}
+
+/*
+  Every sample is in the bin that floor(y / finest_width) >> level gives,
+  and the bins are as narrow as they can be.
+*/
+bool check_bins (const auto_hist_t& a, const std::vector<double>& v) {
+  hist_t h = a.to_hist_pdf();
+  const bool lg = a.using_log();
+  std::vector<double> expect(h.n_bins(), 0);
+  int64_t lo = 0, hi = 0;
+  for(size_t i=0; i < v.size(); ++i) {
+    double y = lg ? log10(v[i]) : v[i];
+    int64_t g = (int64_t) std::floor(y / a.finest_width());
+    if (i == 0 || g < lo) lo = g;
+    if (i == 0 || g > hi) hi = g;
+  }
+  const int L = a.level();
+  if ((hi >> L) - (lo >> L) + 1 > (int64_t) a.n_bins()) return false;
+  if (L > 0 && (hi >> (L-1)) - (lo >> (L-1)) + 1 <= (int64_t) a.n_bins()) return false;
+  for(size_t i=0; i < v.size(); ++i) {
+    double y = lg ? log10(v[i]) : v[i];
+    int64_t g = (int64_t) std::floor(y / a.finest_width());
+    expect[(g >> L) - (lo >> L)] += 1;
+  }
+  for(size_t i=0; i < h.n_bins(); ++i)
+    if (h.count(i) != expect[i]) return false;
+  return h.n_counts() == v.size() && a.data_min() == *std::min_element(v.begin(), v.end())
+    && a.data_max() == *std::max_element(v.begin(), v.end());
+}
+
+// Linear: one at a time and in bulk give the right bins
+bool test_1 () {
+  auto v = drifting_data(100000);
+  auto_hist_t a(100, 1.0/8192);
+  auto_hist_t b(100, 1.0/8192);
+  for(size_t i=0; i < v.size(); ++i) a.add_count(v[i]);
+  b.add_counts(v.begin(), v.end());
+  return a.level() > 0 && check_bins(a, v) && check_bins(b, v)
+    && same_hists(a.to_hist_pdf(), b.to_hist_pdf());
+}
+
+// Log spacing, and samples that can't be binned
+bool test_2 () {
+  auto v = log_data(50000);
+  auto_hist_t a(64, 1.0/1024, true);
+  a.add_counts(v.begin(), v.end());
+  a.add_count(0);
+  a.add_count(-1);
+  a.add_count(NAN);
+  hist_t h = a.to_hist_pdf();
+  return check_bins(a, v) && a.n_skipped() == 3 && h.using_log()
+    && h.min() <= a.data_min() && h.max() > a.data_max();
+}
+
+// Merging the parts in any order is the same as one stream
+bool test_3 () {
+  auto v = drifting_data(60000, 7);
+  std::reverse(v.begin() + 20000, v.end());
+  auto_hist_t whole(50, 1.0/1024);
+  whole.add_counts(v.begin(), v.end());
+  auto_hist_t p1(50, 1.0/1024), p2(50, 1.0/1024), p3(50, 1.0/1024);
+  p1.add_counts(v.begin(), v.begin() + 1000);
+  p2.add_counts(v.begin() + 1000, v.begin() + 30000);
+  p3.add_counts(v.begin() + 30000, v.end());
+  auto_hist_t m1 = p1;
+  m1.merge(p2);
+  m1.merge(p3);
+  auto_hist_t m2 = p3;
+  m2 += p1;
+  m2 += p2;
+  return check_bins(whole, v) && same_hists(whole.to_hist_pdf(), m1.to_hist_pdf())
+    && same_hists(whole.to_hist_pdf(), m2.to_hist_pdf());
+}
+
+// Data in a narrow range stays at the finest width
+bool test_4 () {
+  auto_hist_t a(10, 0.5);
+  for(int i=0; i < 100; ++i) a.add_count(3 + (i % 10) * 0.5);
+  hist_t h = a.to_hist_pdf();
+  return a.level() == 0 && h.n_bins() == 10 && h.min() == 3 && h.max() == 8
+    && h.count(0) == 10 && h.count(9) == 10;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  dotest(test_4,4);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
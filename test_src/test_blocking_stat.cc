@@ -0,0 +1,105 @@
+#include <random>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include "gjl/blocking_stat.h"
+
+typedef gjl::BlockingStat<> blocking_t;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+bool close (double a, double b, double tol) { return std::abs(a - b) <= tol * std::abs(b); }
+
+// AR(1) series, x_{t+1} = phi x_t + noise. tau_int = (1 + phi) / (2 (1 - phi))
+std::vector<double> ar1_data (size_t n, double phi, unsigned seed) {
+  std::mt19937_64 generator(seed);
+  std::normal_distribution<double> distribution(0, 1);
+  std::vector<double> v(n);
+  double x = 0;
+  for(size_t i=0; i < n; ++i) {
+    x = phi * x + distribution(generator);
+    v[i] = 10 + x;
+  }
+  return v;
+}
+
+// tau_int and the error of the mean of a correlated series
+bool test_1 () {
+  const double phi = 0.9;
+  auto v = ar1_data(1 << 22, phi, 1);
+  blocking_t b;
+  for(double x : v) b.record(x);
+  const double tau = (1 + phi) / (2 * (1 - phi));
+  const double sigma2 = 1 / (1 - phi * phi);
+  const double err = sqrt(2 * tau * sigma2 / v.size());
+  return b.N() == v.size() && b.n_levels() == 23 && close(b.tau_int(), tau, 0.15)
+    && close(b.error(), err, 0.08) && close(b.level_error(0), sqrt(sigma2 / v.size()), 0.02)
+    && std::abs(b.mean() - 10) < 4 * err;
+}
+
+// Independent samples have tau_int near 1/2
+bool test_2 () {
+  auto v = ar1_data(1 << 20, 0, 2);
+  blocking_t b;
+  b.record(v.begin(), v.end());
+  return close(b.tau_int(), 0.5, 0.1);
+}
+
+// Batched record gives the same blocks as one at a time
+bool test_3 () {
+  auto v = ar1_data(100003, 0.5, 3);
+  blocking_t a, b;
+  for(double x : v) a.record(x);
+  b.record(v.begin(), v.begin() + 777);
+  b.record(v.begin() + 777, v.end());
+  if (a.n_levels() != b.n_levels()) return false;
+  for(size_t h=0; h < a.n_levels(); ++h)
+    if (a.level_n_blocks(h) != b.level_n_blocks(h) || ! close(b.level(h).mean(), a.level(h).mean(), 1e-12)
+        || ! close(b.level(h).variance(), a.level(h).variance(), 1e-10))
+      return false;
+  return true;
+}
+
+// Merging chains adds the blocks at each level, and pairs the leftovers
+bool test_4 () {
+  auto v = ar1_data(30001, 0.5, 4);
+  auto w = ar1_data(20001, 0.5, 5);
+  blocking_t a, b, c;
+  a.record(v.begin(), v.end());
+  b.record(w.begin(), w.end());
+  c = a;
+  c += b;
+  c.merge(blocking_t());
+  bool ok = c.N() == 50002 && close(c.mean(), (a.mean() * a.N() + b.mean() * b.N()) / 50002, 1e-14);
+  for(size_t h=0; h < c.n_levels(); ++h) {
+    const double n = (h < a.n_levels() ? a.level_n_blocks(h) : 0) + (h < b.n_levels() ? b.level_n_blocks(h) : 0);
+    // at most one block made by pairing leftovers
+    ok = ok && c.level_n_blocks(h) >= n && c.level_n_blocks(h) <= n + 1;
+  }
+  std::ostringstream out;
+  c.print_levels(out);
+  return ok && out.str().find("\n0 50002 ") != std::string::npos;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  dotest(test_4,4);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
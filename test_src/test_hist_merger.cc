@@ -0,0 +1,219 @@
+#include <random>
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "gjl/hist_pdf.h"
+#include "gjl/result_file.h"
+#include "gjl/hist_merger.h"
+
+typedef gjl::HistPdf<> hist_t;
+namespace rf = gjl::result_file;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+std::string tmp_name (int i, const char *suffix) {
+  return "/tmp/test_hist_merger." + std::to_string(getpid()) + "." + std::to_string(i) + suffix;
+}
+
+hist_t sample_hist (unsigned seed, size_t n_bins = 40) {
+  std::mt19937_64 generator(seed);
+  std::uniform_real_distribution<double> distribution(-1,3.5);
+  hist_t h(n_bins,0.1,1000,true);
+  for(size_t i=0; i < 2000; ++i) h.add_count(pow(10,distribution(generator)));
+  h.increment_num_trials();
+  return h;
+}
+
+void write_text (const hist_t& h, const std::string& fname) {
+  std::ofstream out(fname);
+  out << "# a job header\n# that the merger skips\n";
+  h.print_pdf(out);
+}
+
+bool close_to (double a, double b) {
+  return std::abs(a - b) <= 1e-12 * std::abs(b);
+}
+
+bool same_tallies (const hist_t& a, const hist_t& b) {
+  return ( a.n_counts() == b.n_counts()
+           && a.n_greater_than_max() == b.n_greater_than_max()
+           && a.n_less_than_min() == b.n_less_than_min()
+           && a.num_trials() == b.num_trials() );
+}
+
+// Text and binary files, any number of threads, give the same result as merging in memory
+bool test_1 () {
+  std::vector<std::string> files;
+  hist_t total = sample_hist(0);
+  files.push_back(tmp_name(0, ".gjlr"));
+  rf::write(total, files.back());
+  for(unsigned i=1; i < 11; ++i) {
+    hist_t h = sample_hist(i);
+    total.merge(h);
+    files.push_back(tmp_name(i, i % 2 ? ".dat" : ".gjlr"));
+    if (i % 2) write_text(h, files.back());
+    else rf::write(h, files.back());
+  }
+  bool ok = true;
+  for(int n_threads = 1; n_threads <= 4; ++n_threads) {
+    gjl::HistMerger merger;
+    merger.n_threads(n_threads);
+    hist_t m;
+    ok = ok && merger.merge(files, m) && m == total && same_tallies(m, total)
+      && m.num_merged_hists() == 10;
+  }
+  for(size_t i=0; i < files.size(); ++i) remove(files[i].c_str());
+  return ok;
+}
+
+// A shape mismatch is an error that names the file
+bool test_2 () {
+  std::vector<std::string> files;
+  for(int i=0; i < 3; ++i) {
+    files.push_back(tmp_name(i, ".dat"));
+    write_text(sample_hist(i, i == 2 ? 41 : 40), files.back());
+  }
+  gjl::HistMerger merger;
+  hist_t m;
+  bool ok = ! merger.merge(files, m)
+    && merger.error().find(files[2]) != std::string::npos
+    && merger.error().find("number of bins 41 vs 40") != std::string::npos;
+  for(size_t i=0; i < files.size(); ++i) remove(files[i].c_str());
+  return ok;
+}
+
+// Old text output from a cluster job
+bool test_3 () {
+  std::vector<std::string> files(3, "./testdata/transit_time_compute-1-0_1.dat");
+  gjl::HistMerger merger;
+  hist_t one;
+  hist_t three;
+  if (! merger.read(files[0], one) || ! merger.merge(files, three)) return false;
+  return ( one.n_bins() == 100 && one.using_log() && three.n_counts() == 3 * one.n_counts()
+           && three.count(50) == 3 * one.count(50) && one.count(50) > 0 );
+}
+
+// A fine-binned text file goes back into the right bins, by line order,
+// or is refused when zeros are not printed and the centers can't tell the bins apart
+bool test_4 () {
+  std::mt19937_64 generator(4);
+  std::uniform_real_distribution<double> distribution(0,1);
+  hist_t h(1000000, 0, 1);
+  for(size_t i=0; i < 200000; ++i) h.add_count(distribution(generator));
+  const std::string with_zeros = tmp_name(0, ".dat"), without = tmp_name(1, ".dat"), two = tmp_name(2, ".dat");
+  h.zero_printing_on();
+  write_text(h, with_zeros);
+  h.zero_printing_off();
+  write_text(h, without);
+  hist_t coarse(10, 0, 10);
+  coarse.add_count(0.5);
+  coarse.add_count(0.7);
+  coarse.zero_printing_off();
+  {
+    std::ofstream out(two);
+    coarse.print_pdf(out);
+    out << "0.6 0.1 1\n";  // a second line in bin 0
+  }
+  gjl::HistMerger merger;
+  hist_t m, m2, m3;
+  bool ok = merger.read(with_zeros, m) && m == h && same_tallies(m, h);
+  ok = ok && ! merger.read(without, m2) && merger.error().find("narrower than the printed precision") != std::string::npos;
+  ok = ok && ! merger.read(two, m3) && merger.error().find("two data lines in bin 0") != std::string::npos;
+  remove(with_zeros.c_str());
+  remove(without.c_str());
+  remove(two.c_str());
+  return ok;
+}
+
+// All files are merged when fewer threads start than were asked for.
+// Inside an active parallel region a nested one gets a single thread.
+bool test_5 () {
+  std::vector<std::string> files;
+  hist_t total = sample_hist(0);
+  files.push_back(tmp_name(0, ".gjlr"));
+  rf::write(total, files.back());
+  for(unsigned i=1; i < 9; ++i) {
+    hist_t h = sample_hist(i);
+    total.merge(h);
+    files.push_back(tmp_name(i, ".gjlr"));
+    rf::write(h, files.back());
+  }
+#ifdef _OPENMP
+  omp_set_max_active_levels(1);
+#endif
+  bool ok = false;
+#pragma omp parallel num_threads(2)
+  {
+#pragma omp single
+    {
+      gjl::HistMerger merger;
+      merger.n_threads(4);
+      hist_t m;
+      ok = merger.merge(files, m) && m == total && same_tallies(m, total);
+    }
+  }
+  for(size_t i=0; i < files.size(); ++i) remove(files[i].c_str());
+  return ok;
+}
+
+hist_t weighted_hist (unsigned seed) {
+  std::mt19937_64 generator(seed);
+  std::uniform_real_distribution<double> distribution(-1,3.5);
+  std::uniform_real_distribution<double> weight(0.5,2);
+  hist_t h(40,0.1,1000,true);
+  for(size_t i=0; i < 2000; ++i) h.add_weighted_count(pow(10,distribution(generator)), weight(generator));
+  h.increment_num_trials();
+  return h;
+}
+
+// Weighted binary files keep the sum of weights, and of squared weights
+bool test_6 () {
+  std::vector<std::string> files;
+  hist_t total = weighted_hist(0);
+  files.push_back(tmp_name(0, ".gjlr"));
+  rf::write(total, files.back());
+  for(unsigned i=1; i < 5; ++i) {
+    hist_t h = weighted_hist(i);
+    total.merge(h);
+    files.push_back(tmp_name(i, ".gjlr"));
+    rf::write(h, files.back());
+  }
+  gjl::HistMerger merger;
+  merger.n_threads(2);
+  hist_t m;
+  bool ok = merger.merge(files, m) && same_tallies(m, total)
+    && close_to(m.n_weighted_counts(), total.n_weighted_counts()) && m.weighted_pdf(20) > 0;
+  for(size_t i=0; ok && i < m.n_bins(); ++i)
+    ok = close_to(m.weighted_pdf(i), total.weighted_pdf(i))
+      && close_to(m.weighted_pdf_error(i), total.weighted_pdf_error(i));
+  for(size_t i=0; i < files.size(); ++i) remove(files[i].c_str());
+  return ok;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  dotest(test_4,4);
+  dotest(test_5,5);
+  dotest(test_6,6);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
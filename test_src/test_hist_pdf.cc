@@ -1,4 +1,15 @@
+#include <random>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "gjl/hist_pdf.h"
+#include "gjl/concurrent_hist_pdf.h"
+#include "gjl/static_hist_pdf.h"
+#include "gjl/count_hist_pdf.h"
 
 typedef gjl::HistPdf<> hist_t;
 
@@ -175,6 +186,430 @@ bool test_20 () {
   return ( a.n_counts() == 4 );
 }
 
+// Samples that hit both ends of the range of a (10,0,10) histogram
+std::vector<double> sample_data (size_t n, double lo = -2, double hi = 12) {
+  std::mt19937_64 generator;
+  std::uniform_real_distribution<double> distribution(lo,hi);
+  std::vector<double> v(n);
+  for(size_t i=0; i < n; ++i) v[i] = distribution(generator);
+  return v;
+}
+
+bool same_tallies (const hist_t& a, const hist_t& b) {
+  return ( a.n_counts() == b.n_counts()
+           && a.n_greater_than_max() == b.n_greater_than_max()
+           && a.n_less_than_min() == b.n_less_than_min()
+           && a.data_min() == b.data_min()
+           && a.data_max() == b.data_max() );
+}
+
+// Bulk insertion gives the same counts and tallies as one at a time
+bool test_21 () {
+  hist_t a(10,0,10);
+  hist_t b(10,0,10);
+  auto v = sample_data(1000);
+  for(size_t i=0; i < v.size(); ++i) a.add_count(v[i]);
+  b.add_counts(v.begin(), v.end());
+  return ( a == b && same_tallies(a,b) );
+}
+
+// Bulk insertion with log spacing
+bool test_22 () {
+  hist_t a(20,0.1,100,true);
+  hist_t b(20,0.1,100,true);
+  auto v = sample_data(1000,0.01,200);
+  for(size_t i=0; i < v.size(); ++i) a.add_count(v[i]);
+  b.add_counts(v.data(), v.data() + v.size());
+  return ( a == b && same_tallies(a,b) );
+}
+
+// Bulk insertion appends to existing counts
+bool test_23 () {
+  hist_t a(10,0,10);
+  hist_t b(10,0,10);
+  auto v = sample_data(1000);
+  a.add_count(5.0);
+  b.add_count(5.0);
+  for(size_t i=0; i < v.size(); ++i) a.add_count(v[i]);
+  b.add_count(v);
+  return ( a == b && same_tallies(a,b) );
+}
+
+// merge carries all tallies, including those of out of range data
+bool test_24 () {
+  hist_t a(10,0,10);
+  hist_t b(10,0,10);
+  hist_t c(10,0,10);
+  auto v = sample_data(1000);
+  a.add_counts(v.begin(), v.begin() + 500);
+  b.add_counts(v.begin() + 500, v.end());
+  c.add_counts(v.begin(), v.end());
+  hist_t m(10,0,10);
+  m.merge(a);
+  m.merge(b);
+  return ( m == c && same_tallies(m,c) );
+}
+
+// Sharded concurrent fill gives the same histogram as a serial fill
+bool test_25 () {
+  const int n_threads = 4;
+  auto v = sample_data(100000);
+  hist_t serial(10,0,10);
+  serial.add_counts(v.begin(), v.end());
+  gjl::ConcurrentHistPdf<> conc(hist_t(10,0,10), n_threads);
+  std::vector<std::thread> threads;
+  size_t chunk = v.size() / n_threads;
+  for(int k=0; k < n_threads; ++k)
+    threads.push_back(std::thread([&conc,&v,k,chunk] () {
+          auto first = v.begin() + k * chunk;
+          for(auto it = first; it != first + chunk / 2; ++it) conc.add_count(k,*it);
+          conc.add_counts(k, first + chunk / 2, first + chunk);
+        }));
+  for(auto& t : threads) t.join();
+  auto h = conc.snapshot();
+  return ( h == serial && same_tallies(h,serial) );
+}
+
+// Snapshots taken while producers run are consistent, and the last one is complete
+bool test_26 () {
+  const int n_threads = 3;
+  auto v = sample_data(300000);
+  gjl::ConcurrentHistPdf<> conc(hist_t(50,0,10), n_threads);
+  std::atomic<int> n_running(n_threads);
+  std::vector<std::thread> threads;
+  size_t chunk = v.size() / n_threads;
+  for(int k=0; k < n_threads; ++k)
+    threads.push_back(std::thread([&conc,&v,&n_running,k,chunk] () {
+          for(size_t i=k*chunk; i < (k+1)*chunk; ++i) conc.add_count(k,v[i]);
+          --n_running;
+        }));
+  bool consistent = true;
+  size_t last_n = 0;
+  while (n_running > 0) {
+    auto h = conc.snapshot();
+    double sum = 0;
+    for(size_t i=0; i < h.n_bins(); ++i) sum += h.count(i);
+    if (sum != h.n_counts() || h.n_counts() < last_n) consistent = false;
+    last_n = h.n_counts();
+  }
+  for(auto& t : threads) t.join();
+  auto h = conc.snapshot();
+  return ( consistent && h.n_counts() == v.size() );
+}
+
+// log uniform samples from lo to hi
+std::vector<double> log_sample_data (size_t n, double lo, double hi) {
+  auto v = sample_data(n, log10(lo), log10(hi));
+  for(size_t i=0; i < n; ++i) v[i] = pow(10,v[i]);
+  return v;
+}
+
+// Fast log binning puts samples in the same bins as log10
+bool test_27 () {
+  hist_t a(500,0.1,1e7,true);
+  hist_t b(500,0.1,1e7,true);
+  b.use_fast_log(true);
+  auto v = log_sample_data(100000,0.01,1e8);
+  for(size_t i=0; i < v.size(); ++i) a.add_count(v[i]);
+  for(size_t i=0; i < 1000; ++i) b.add_count(v[i]);
+  b.add_counts(v.begin() + 1000, v.end());
+  return ( b.using_fast_log() && a == b && same_tallies(a,b) );
+}
+
+// Fast log binning is refused if the bins are too narrow, and dropped with linear spacing
+bool test_28 () {
+  hist_t a(1000000,1,1.1,true);
+  a.use_fast_log(true);
+  hist_t b(10,1,10,true);
+  b.use_fast_log(true);
+  b.use_log(false);
+  return ( ! a.using_fast_log() && ! b.using_fast_log() );
+}
+
+// Uneven edges, including a number of interior edges that does not fill the tree
+std::vector<double> custom_edges (size_t n) {
+  std::vector<double> e(n+1);
+  for(size_t i=0; i <= n; ++i) e[i] = i * i * 10.0 / (n * n);
+  return e;
+}
+
+// Custom bins put samples in the same bins as a linear search over the edges
+bool test_29 () {
+  auto e = custom_edges(37);
+  hist_t a(e);
+  hist_t b(e);
+  std::vector<double> c(37,0);
+  auto v = sample_data(100000);
+  v.push_back(e[5]);
+  v.push_back(e[36]);
+  for(size_t i=0; i < v.size(); ++i) {
+    a.add_count(v[i]);
+    size_t j = 0;
+    while (j + 1 < 37 && v[i] >= e[j+1]) ++j;
+    c[j] += 1;
+  }
+  b.add_counts(v.begin(), v.end());
+  if (! (a == b && same_tallies(a,b)) ) return false;
+  for(size_t i=0; i < 37; ++i)
+    if (a.count(i) != c[i] || a.find_index(e[i]) != i) return false;
+  return ( a.using_custom_bins() && a.n_less_than_min() > 0 && a.n_greater_than_max() > 0 );
+}
+
+// Custom bins: pdf uses per-bin widths; merge checks the edges
+bool test_30 () {
+  auto e = custom_edges(16);
+  hist_t a(e);
+  hist_t b(e);
+  auto v = sample_data(10000, 0, 10);
+  a.add_counts(v.begin(), v.begin() + 5000);
+  b.add_counts(v.begin() + 5000, v.end());
+  a.merge(b);
+  hist_t c(e);
+  c.add_counts(v.begin(), v.end());
+  e[3] += 0.01;
+  hist_t d(e);
+  hist_t u(16,0,10);
+  return ( a == c && same_tallies(a,c) && std::abs(a.pdf_integral() - 1) < 1e-12
+           && a.pdf(0) == a.count(0) / (a.n_counts() * e[1])
+           && ! a.is_same_shape(d) && ! a.is_same_shape(u) );
+}
+
+// Parallel fill gives the same result as the serial path for any number of threads
+bool test_31 () {
+  auto v = sample_data(100003, 0.01, 12);
+  std::vector<hist_t> shapes;
+  shapes.push_back(hist_t(100,0,10));
+  shapes.push_back(hist_t(100,0.1,10,true));
+  shapes.push_back(hist_t(custom_edges(20)));
+  for(size_t k=0; k < shapes.size(); ++k) {
+    hist_t a = shapes[k];
+    a.add_counts(v.begin(), v.end());
+    for(int n_threads = 1; n_threads <= 7; ++n_threads) {
+      hist_t b = shapes[k];
+      b.add_count(v[0]);
+      b.add_counts_parallel(v.begin() + 1, v.end(), n_threads);
+      if (! (a == b && same_tallies(a,b)) ) return false;
+    }
+  }
+  return true;
+}
+
+// format_pdf and write_pdf give the same text as print_pdf, in each zero printing mode
+bool test_32 () {
+  auto v = sample_data(20000, 0.01, 12);
+  std::vector<hist_t> hists;
+  hists.push_back(hist_t(300,0,10));
+  hists.push_back(hist_t(300,0.1,10,true));
+  hists.push_back(hist_t(custom_edges(40)));
+  gjl::TextBuffer buf;
+  std::string fname = "/tmp/test_hist_pdf." + std::to_string(getpid()) + ".dat";
+  bool ok = true;
+  for(size_t k=0; k < hists.size(); ++k) {
+    hist_t& h = hists[k];
+    h.add_counts(v.begin(), v.end());
+    for(int mode = 0; mode < 3; ++mode) {
+      if (mode == 0) h.zero_printing_on();
+      else if (mode == 1) h.zero_printing_off();
+      else h.zero_printing_commented();
+      std::ostringstream out;
+      h.print_pdf(out);
+      buf.clear();
+      h.format_pdf(buf);
+      ok = ok && buf.str() == out.str();
+      std::ifstream in;
+      ok = ok && h.write_pdf(fname);
+      in.open(fname);
+      std::stringstream file;
+      file << in.rdbuf();
+      ok = ok && file.str() == out.str();
+    }
+  }
+  remove(fname.c_str());
+  return ok;
+}
+
+// TextBuffer writes numbers as an ostream does, or so that they read back exactly
+bool test_33 () {
+  std::vector<double> x = { 0, -0.0, 1, -7, 999999, 1e6, 123456.7, 0.1, 1.0/3, -2.5e-300,
+                            1e300, 4503599627370497.0, INFINITY, -INFINITY, NAN };
+  auto v = sample_data(1000, -1e5, 1e5);
+  x.insert(x.end(), v.begin(), v.end());
+  std::ostringstream out;
+  gjl::TextBuffer buf;
+  for(size_t i=0; i < x.size(); ++i) {
+    out << x[i] << " ";
+    buf << x[i] << " ";
+  }
+  out << (size_t) 18446744073709551615ull << " " << -42 << " " << 'c' << "\n";
+  buf << (size_t) 18446744073709551615ull << " " << -42 << " " << 'c' << "\n";
+  if (buf.str() != out.str()) return false;
+  gjl::TextBuffer rt;
+  rt.round_trip(true);
+  for(size_t i=0; i < x.size(); ++i) {
+    if (std::isnan(x[i])) continue;
+    rt.clear();
+    rt << x[i];
+    if (strtod(rt.str().c_str(), nullptr) != x[i] || rt.size() > 24) return false;
+  }
+  rt.clear();
+  rt << 0.1 << " " << 123456.7 << " " << 1e15;
+  return rt.str() == "0.1 123456.7 1e+15";
+}
+
+// StaticHistPdf bins as HistPdf does, and converts, merges and prints the same way
+bool test_34 () {
+  auto v = sample_data(30001, -2, 12);
+  typedef gjl::StaticHistPdf<77, gjl::IntRange<0,10> > shist_t;
+  shist_t a, b;
+  for(size_t i=0; i < 10000; ++i) a.add_count(v[i]);
+  b.add_counts(v.begin() + 10000, v.end());
+  a.merge(b);
+  hist_t h(77,0,10);
+  hist_t h1(77,0,10);
+  h.add_counts(v.begin(), v.begin() + 10000);
+  h1.add_counts(v.begin() + 10000, v.end());
+  h.merge(h1);
+  hist_t c = a.to_hist_pdf();
+  std::ostringstream sa, sh;
+  a.print_pdf(sa);
+  h.print_pdf(sh);
+  return ( c == h && same_tallies(c,h) && c.data_max() == h.data_max()
+           && c.num_merged_hists() == 1 && sa.str() == sh.str() );
+}
+
+bool test_35 () {
+  auto v = log_sample_data(20000, 1e-3, 1e6);
+  gjl::StaticHistPdf<50, gjl::DecadeRange<-2,5>, true> a;
+  a.add_counts(v.begin(), v.end());
+  hist_t h(50,1e-2,1e5,true);
+  h.add_counts(v.begin(), v.end());
+  hist_t c = a.to_hist_pdf();
+  return ( c == h && same_tallies(c,h) && c.using_log() && a.min() == h.min()
+           && a.data_min() == h.data_min() && a.n_less_than_min() > 0 );
+}
+
+// Weighted counts bin as add_count does, with log spacing and custom bins
+bool test_36 () {
+  auto v = log_sample_data(10001, 0.05, 20);
+  std::vector<double> w(v.size());
+  for(size_t i=0; i < v.size(); ++i) w[i] = 0.5 + (i % 7);
+  std::vector<hist_t> shapes;
+  shapes.push_back(hist_t(40,0.1,10,true));
+  shapes.push_back(hist_t(custom_edges(20)));
+  for(size_t k=0; k < shapes.size(); ++k) {
+    hist_t a = shapes[k];
+    hist_t b = shapes[k];
+    hist_t c = shapes[k];
+    hist_t d = shapes[k];
+    a.add_counts(v.begin(), v.end());
+    for(size_t i=0; i < v.size(); ++i) b.add_weighted_count(v[i], w[i]);
+    c.add_weighted_counts(v.begin(), v.begin() + 5000, w.begin());
+    d.add_weighted_counts(v.begin() + 5000, v.end(), w.begin() + 5000);
+    c.merge(d);
+    double sw = 0;
+    for(size_t i=0; i < w.size(); ++i) sw += w[i];
+    hist_t ones = shapes[k];
+    std::vector<double> one(v.size(), 1);
+    ones.add_weighted_counts(v.begin(), v.end(), one.begin());
+    if ( ! (ones == a && same_tallies(ones, a) && same_tallies(b, a) && same_tallies(c, a)
+            && b.n_weighted_counts() == sw && std::abs(c.n_weighted_counts() - sw) < 1e-9
+            && std::abs(b.weighted_pdf_integral() - 1) < 1e-12 && c.has_weights() && ! a.has_weights()) )
+      return false;
+    for(size_t i=0; i < b.n_bins(); ++i)
+      if (std::abs(b.count(i) - c.count(i)) > 1e-9
+          || std::abs(b.sum_weights_squared(i) - c.sum_weights_squared(i)) > 1e-9
+          || ones.sum_weights_squared(i) != a.count(i))
+        return false;
+  }
+  return true;
+}
+
+// Compensated summation keeps small weights added to a large one
+bool test_37 () {
+  hist_t a(2,0,2);
+  hist_t b(2,0,2);
+  b.weight_summation(gjl::hist_pdf::compensated_summation);
+  std::vector<double> x(100001, 0.5);
+  std::vector<double> w(100001, 0.1);
+  w[0] = 1e12;
+  a.add_weighted_counts(x.begin(), x.end(), w.begin());
+  b.add_weighted_counts(x.begin(), x.end(), w.begin());
+  const double exact = 1e12 + 1e4;
+  hist_t c(2,0,2);
+  c.merge(b);
+  return ( a.count(0) != exact && b.count(0) == exact && b.n_weighted_counts() == exact
+           && c.count(0) == exact && (*b.counts())[0] == exact
+           && b.weight_summation() == gjl::hist_pdf::compensated_summation );
+}
+
+// CountHistPdf bins as HistPdf does
+bool test_38 () {
+  auto v = log_sample_data(50001, 0.05, 20);
+  std::vector<hist_t> shapes;
+  shapes.push_back(hist_t(40,0,10));
+  shapes.push_back(hist_t(40,0.1,10,true));
+  shapes.push_back(hist_t(custom_edges(20)));
+  for(size_t k=0; k < shapes.size(); ++k) {
+    hist_t a = shapes[k];
+    a.add_counts(v.begin(), v.end());
+    a.num_merged_hists(1);
+    gjl::CountHistPdf<> b, c;
+    if (k == 0) b = c = gjl::CountHistPdf<>(40,0,10);
+    else if (k == 1) b = c = gjl::CountHistPdf<>(40,0.1,10,true);
+    else b = c = gjl::CountHistPdf<>(custom_edges(20));
+    for(size_t i=0; i < 20000; ++i) b.add_count(v[i]);
+    c.add_counts(v.begin() + 20000, v.end());
+    b.merge(c);
+    hist_t h = b.to_hist_pdf();
+    std::ostringstream sa, sb;
+    a.print_pdf(sa);
+    b.print_pdf(sb);
+    if ( ! (h == a && same_tallies(h, a) && h.data_min() == a.data_min() && sa.str() == sb.str()
+            && b.pdf(3) == a.pdf(3) && b.num_merged_hists() == 1) )
+      return false;
+  }
+  return true;
+}
+
+// Counts carry past 2^32, when filling and when merging
+bool test_39 () {
+  gjl::CountHistPdf<> a(4,0,4);
+  gjl::CountHistPdf<> b(4,0,4);
+  a.add_to_count(0, 0xffffffffull);
+  a.add_count(0.5);
+  std::vector<double> v(3, 1.5);
+  b.add_to_count(1, 0xfffffffeull);
+  b.add_to_count(2, 5ull << 33);
+  b.add_counts(v.begin(), v.end());
+  gjl::CountHistPdf<> c(4,0,4);
+  c.add_to_count(1, 7);
+  c.merge(b);
+  return ( a.count(0) == (1ull << 32) && b.count(1) == (1ull << 32) + 1
+           && c.count(1) == (1ull << 32) + 8 && c.count(2) == (5ull << 33)
+           && c.n_counts() == 3 && a.to_hist_pdf().count(0) == 4294967296.0 );
+}
+
+// Parallel fill is complete when fewer threads start than were asked for.
+// Inside an active parallel region a nested one gets a single thread.
+bool test_40 () {
+  auto v = sample_data(100003, 0.01, 12);
+  hist_t a(100,0,10);
+  a.add_counts(v.begin(), v.end());
+#ifdef _OPENMP
+  omp_set_max_active_levels(1);
+#endif
+  bool ok = false;
+#pragma omp parallel num_threads(2)
+  {
+#pragma omp single
+    {
+      hist_t b(100,0,10);
+      b.add_counts_parallel(v.begin(), v.end(), 8);
+      ok = a == b && same_tallies(a,b);
+    }
+  }
+  return ok;
+}
 
 int main () {
   dotest(test_1,1);
@@ -197,6 +632,26 @@ int main () {
   dotest(test_18,18);
   dotest(test_19,19);
   dotest(test_20,20);
+  dotest(test_21,21);
+  dotest(test_22,22);
+  dotest(test_23,23);
+  dotest(test_24,24);
+  dotest(test_25,25);
+  dotest(test_26,26);
+  dotest(test_27,27);
+  dotest(test_28,28);
+  dotest(test_29,29);
+  dotest(test_30,30);
+  dotest(test_31,31);
+  dotest(test_32,32);
+  dotest(test_33,33);
+  dotest(test_34,34);
+  dotest(test_35,35);
+  dotest(test_36,36);
+  dotest(test_37,37);
+  dotest(test_38,38);
+  dotest(test_39,39);
+  dotest(test_40,40);
   std::cout << n_fail << "/" << n_tests << " tests failed.\n";
   return 1;
 }
@@ -0,0 +1,165 @@
+#include <random>
+#include <sstream>
+#include <string>
+#include "gjl/hist_pdf.h"
+#include "gjl/hist_pdf_2d.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef gjl::HistPdf<> hist_t;
+typedef gjl::HistPdf2D<> hist2_t;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+std::vector<double> sample_data (size_t n, double lo, double hi, unsigned seed) {
+  std::mt19937_64 generator(seed);
+  std::uniform_real_distribution<double> distribution(lo,hi);
+  std::vector<double> v(n);
+  for(size_t i=0; i < n; ++i) v[i] = distribution(generator);
+  return v;
+}
+
+// Stands in for gjl::image::DataImage
+struct TestImage {
+  size_t h = 0, w = 0;
+  double max_val = 0;
+  std::vector<double> hue;
+  void set_dims(size_t height, size_t width) { h = height; w = width; hue.assign(h * w, -2); }
+  void set_max_trans_val(double m) { max_val = m; }
+  void set_pixel_hue_scaled_data(size_t x, size_t y, double v) { hue[y * w + x] = v / max_val; }
+  void set_pixel_grey(size_t x, size_t y, unsigned char) { hue[y * w + x] = -1; }
+};
+
+// Each axis bins as HistPdf does, including out of range samples
+bool test_1 () {
+  auto x = sample_data(20000, -1, 11, 1);
+  auto y = sample_data(20000, 0.05, 120, 2);
+  hist2_t h(30, 0, 10, 20, 0.1, 100, false, true);
+  h.add_counts(x.begin(), x.end(), y.begin());
+  hist_t hx(30, 0, 10);
+  hist_t hy(20, 0.1, 100, true);
+  hx.add_counts(x.begin(), x.end());
+  hy.add_counts(y.begin(), y.end());
+  for(size_t i=0; i < 30; ++i) {
+    double s = 0;
+    for(size_t j=0; j < 20; ++j) s += h.count(i,j);
+    if (s != hx.count(i) || h.center_x(i) != hx.center(i)) return false;
+  }
+  for(size_t j=0; j < 20; ++j) {
+    double s = 0;
+    for(size_t i=0; i < 30; ++i) s += h.count(i,j);
+    if (s != hy.count(j) || std::abs(h.center_y(j) / hy.center(j) - 1) > 1e-14) return false;
+  }
+  return ( h.n_counts() == 20000 && h.x_tally().n_greater_than_max == hx.n_greater_than_max()
+           && h.y_tally().n_less_than_min == hy.n_less_than_min()
+           && h.data_max_x() == hx.data_max() && h.data_min_y() == hy.data_min() );
+}
+
+// add_count, add_counts, add_counts_parallel and merge agree
+bool test_2 () {
+  auto x = sample_data(100003, 0, 1, 3);
+  auto y = sample_data(100003, -2, 2, 4);
+  hist2_t a(16, 0, 1, 24, -2, 2);
+  hist2_t b = a;
+  for(size_t i=0; i < x.size(); ++i) a.add_count(x[i], y[i]);
+  b.add_counts(x.begin(), x.end(), y.begin());
+  if (a != b || a.n_counts() != b.n_counts() || a.data_min_y() != b.data_min_y()) return false;
+  for(int n_threads = 1; n_threads <= 5; ++n_threads) {
+    hist2_t c(16, 0, 1, 24, -2, 2);
+    c.add_counts_parallel(x.begin(), x.end(), y.begin(), n_threads);
+    if (c != a || c.n_counts() != a.n_counts() || c.data_max_x() != a.data_max_x()) return false;
+  }
+  hist2_t d(16, 0, 1, 24, -2, 2);
+  hist2_t e(16, 0, 1, 24, -2, 2);
+  d.add_counts(x.begin(), x.begin() + 50000, y.begin());
+  e.add_counts(x.begin() + 50000, x.end(), y.begin() + 50000);
+  d.merge(e);
+  return d == a && d.n_counts() == a.n_counts() && d.num_merged_hists() == 1;
+}
+
+// The pdf integrates to one, on log axes too
+bool test_3 () {
+  auto x = sample_data(5000, 0, 3, 5);
+  auto y = sample_data(5000, -1, 1, 6);
+  for(size_t i=0; i < x.size(); ++i) {
+    x[i] = pow(10, x[i]);
+    y[i] = pow(10, y[i]);
+  }
+  hist2_t h(12, 1, 1000, 8, 0.1, 10, true, true);
+  h.add_counts(x.begin(), x.end(), y.begin());
+  double s = 0;
+  for(size_t i=0; i < 12; ++i)
+    for(size_t j=0; j < 8; ++j)
+      s += h.pdf(i,j) * h.x_axis().bin_width(i) * h.y_axis().bin_width(j);
+  return std::abs(s - 1) < 1e-12;
+}
+
+// Text output and heat map
+bool test_4 () {
+  hist2_t h(3, 0, 3, 2, 0, 2);
+  h.add_count(0.5, 0.5);
+  h.add_count(0.5, 0.5);
+  h.add_count(2.5, 1.5);
+  std::ostringstream out;
+  h.print_pdf(out);
+  const std::string s = out.str();
+  const bool text_ok = s.find("# Nbins y 2\n") != std::string::npos
+    && s.find("\n0.5 0.5 0.666667 2\n\n\n2.5 1.5 0.333333 1\n\n") != std::string::npos;
+  std::ostringstream out2;
+  h.zero_printing_on();
+  h.print_pdf(out2);
+  const bool zeros_ok = out2.str().find("\n1.5 0.5 0 0\n") != std::string::npos;
+  TestImage im;
+  h.to_image(im);
+  // y is up, so bin (0,0) is pixel (0,1)
+  return text_ok && zeros_ok && im.h == 2 && im.w == 3 && im.hue[1 * 3 + 0] == 1
+    && im.hue[0 * 3 + 2] == 0.5 && im.hue[0] == -1;
+}
+
+// Parallel fill is complete when fewer threads start than were asked for.
+// Inside an active parallel region a nested one gets a single thread.
+bool test_5 () {
+  auto x = sample_data(100003, 0, 1, 7);
+  auto y = sample_data(100003, 0.01, 10, 8);
+  hist2_t a(16, 0, 1, 24, 0.01, 10, false, true);
+  a.add_counts(x.begin(), x.end(), y.begin());
+#ifdef _OPENMP
+  omp_set_max_active_levels(1);
+#endif
+  bool ok = false;
+#pragma omp parallel num_threads(2)
+  {
+#pragma omp single
+    {
+      hist2_t b(16, 0, 1, 24, 0.01, 10, false, true);
+      b.add_counts_parallel(x.begin(), x.end(), y.begin(), 8);
+      ok = a == b && a.n_counts() == b.n_counts() && a.data_min_y() == b.data_min_y();
+    }
+  }
+  return ok;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  dotest(test_4,4);
+  dotest(test_5,5);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
@@ -0,0 +1,179 @@
+#include <random>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include "gjl/simple_linear_regression.h"
+
+typedef linear_regression_accumulator<double> acc_t;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+bool close (double a, double b, double tol) { return std::abs(a - b) <= tol * std::abs(b); }
+
+void line_data (size_t n, double x0, double m, double b, unsigned seed,
+                std::vector<double>& x, std::vector<double>& y, std::vector<double>& w) {
+  std::mt19937_64 generator(seed);
+  std::uniform_real_distribution<double> noise(-1, 1);
+  x.resize(n);
+  y.resize(n);
+  w.resize(n);
+  for(size_t i=0; i < n; ++i) {
+    x[i] = x0 + i * 0.01;
+    y[i] = m * x[i] + b + noise(generator);
+    w[i] = 1 + (i % 7);
+  }
+}
+
+// add, add_range and fit_range agree
+bool test_1 () {
+  std::vector<double> x, y, w;
+  line_data(10007, 0, 3.4, 2.1, 1, x, y, w);
+  simple_linear_regression<double> fit;
+  fit.fit_range(x.begin(), x.end(), y.begin());
+  acc_t a, b;
+  for(size_t i=0; i < x.size(); ++i) a.add(x[i], y[i]);
+  b.add_range(x.begin(), x.end(), y.begin());
+  return a.n() == 10007 && b.n() == 10007 && a.sum_weights() == 10007
+    && close(a.slope(), fit.slope(), 1e-10) && close(a.intercept(), fit.intercept(), 1e-8)
+    && close(a.r(), fit.r(), 1e-10) && close(b.slope(), a.slope(), 1e-12)
+    && close(b.intercept(), a.intercept(), 1e-10) && close(b.r(), a.r(), 1e-12);
+}
+
+// Weighted, and merging pieces
+bool test_2 () {
+  std::vector<double> x, y, w;
+  line_data(5000, 10, -1.5, 7, 2, x, y, w);
+  simple_linear_regression<double> fit;
+  fit.fit_range_weighted(x.begin(), x.end(), y.begin(), w.begin());
+  acc_t a, b, c;
+  for(size_t i=0; i < x.size(); ++i) a.add(x[i], y[i], w[i]);
+  b.add_range_weighted(x.begin(), x.end(), y.begin(), w.begin());
+  for(size_t p=0; p < 5; ++p) {
+    acc_t part;
+    part.add_range_weighted(x.begin() + p * 1000, x.begin() + (p + 1) * 1000, y.begin() + p * 1000, w.begin() + p * 1000);
+    c += part;
+  }
+  c.merge(acc_t());
+  return close(a.slope(), fit.slope(), 1e-10) && close(a.intercept(), fit.intercept(), 1e-9)
+    && close(b.slope(), a.slope(), 1e-12) && close(c.slope(), a.slope(), 1e-12)
+    && close(c.intercept(), a.intercept(), 1e-12) && close(c.r(), a.r(), 1e-12) && c.n() == 5000;
+}
+
+// Large offsets in x and y do not spoil the fit
+bool test_3 () {
+  std::vector<double> x, y, w;
+  line_data(100000, 1e8, 2, 1e9, 3, x, y, w);
+  acc_t a, b;
+  for(size_t i=0; i < x.size(); ++i) a.add(x[i], y[i]);
+  b.add_range(x.begin(), x.end(), y.begin());
+  return std::abs(a.slope() - 2) < 1e-3 && std::abs(b.slope() - 2) < 1e-3;
+}
+
+// The window fits the last points only
+bool test_4 () {
+  std::vector<double> x, y, w;
+  line_data(2345, 0, 1, 0, 4, x, y, w);
+  for(size_t i=1000; i < x.size(); ++i) y[i] = 5 * x[i] - 3;
+  windowed_linear_regression<double> win(300);
+  for(size_t i=0; i < x.size(); ++i) {
+    win.add(x[i], y[i]);
+    if (i == 100 && win.n() != 101) return false;
+  }
+  acc_t last;
+  last.add_range(x.end() - 300, x.end(), y.end() - 300);
+  acc_t removed;
+  removed.add(1, 2);
+  removed.add(2, 5);
+  removed.add(3, 6);
+  removed.remove(2, 5);
+  std::ostringstream out;
+  win.report(out);
+  return win.n() == 300 && close(win.slope(), 5, 1e-9) && close(win.intercept(), last.intercept(), 1e-9)
+    && close(removed.slope(), 2, 1e-14) && std::abs(removed.intercept()) < 1e-13
+    && out.str().find("Fit 300 points") == 0;
+}
+
+// Standard errors agree among the fits, and with the spread of fitted slopes
+bool test_5 () {
+  std::vector<double> x, y, w;
+  line_data(200, 5, 2, 1, 5, x, y, w);
+  simple_linear_regression<double> fit, wfit;
+  fit.fit_range(x.begin(), x.end(), y.begin());
+  std::vector<double> ones(x.size(), 3);
+  wfit.fit_range_weighted(x.begin(), x.end(), y.begin(), ones.begin());
+  acc_t a;
+  a.add_range(x.begin(), x.end(), y.begin());
+  if (! (close(a.slope_error(), fit.slope_error(), 1e-8) && close(a.intercept_error(), fit.intercept_error(), 1e-8)
+         && close(wfit.slope_error(), fit.slope_error(), 1e-8)
+         && close(wfit.intercept_error(), fit.intercept_error(), 1e-8)))
+    return false;
+  acc_t b;
+  b.add_range_weighted(x.begin(), x.end(), y.begin(), w.begin());
+  wfit.fit_range_weighted(x.begin(), x.end(), y.begin(), w.begin());
+  if (! (close(b.slope_error(), wfit.slope_error(), 1e-8) && close(b.intercept_error(), wfit.intercept_error(), 1e-8)))
+    return false;
+  double s = 0, s2 = 0, se = 0;
+  const int n_rep = 2000;
+  for(int rep=0; rep < n_rep; ++rep) {
+    line_data(200, 5, 2, 1, 100 + rep, x, y, w);
+    fit.fit_range(x.begin(), x.end(), y.begin());
+    s += fit.slope();
+    s2 += fit.slope() * fit.slope();
+    se += fit.slope_error();
+  }
+  const double sd = sqrt(s2 / n_rep - (s / n_rep) * (s / n_rep));
+  return close(se / n_rep, sd, 0.05);
+}
+
+// Fitting many series against one x, in rows or columns
+bool test_6 () {
+  const size_t n_series = 13, n = 1001;
+  std::vector<double> x, y, w;
+  std::vector<std::vector<double> > cols(n_series);
+  std::vector<double> rows(n * n_series);
+  for(size_t k=0; k < n_series; ++k) {
+    line_data(n, 100, 0.5 * k - 2, 1e6 * k, 10 + k, x, cols[k], w);
+    for(size_t i=0; i < n; ++i) rows[i * n_series + k] = cols[k][i];
+  }
+  multi_linear_regression<double> mr, mc;
+  mr.fit_rows(x.begin(), x.end(), rows.begin(), n_series);
+  mc.fit_columns(x.begin(), x.end(), cols);
+  if (mr.n() != n || mr.n_series() != n_series || mc.n_series() != n_series) return false;
+  for(size_t k=0; k < n_series; ++k) {
+    acc_t a;
+    a.add_range(x.begin(), x.end(), cols[k].begin());
+    for (auto *m : { &mr, &mc })
+      if (! (std::abs(m->slope(k) - a.slope()) < 1e-8 && close(m->intercept(k), a.intercept(), 1e-9)
+             && close(m->slope_error(k), a.slope_error(), 1e-6) && close(m->intercept_error(k), a.intercept_error(), 1e-6)
+             && close(m->r(k), a.r(), 1e-6)))
+        return false;
+  }
+  std::ostringstream out;
+  mr.report(out);
+  return out.str().find("Fit 1001 points, 13 series\n") == 0;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  dotest(test_4,4);
+  dotest(test_5,5);
+  dotest(test_6,6);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
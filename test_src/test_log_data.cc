@@ -0,0 +1,107 @@
+#include <random>
+#include <string>
+#include <cstdio>
+#include <iostream>
+#include "gjl/log_data.h"
+
+namespace ld = gjl::log_data;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+bool parses (const std::string& s, double& x) { return ld::parse_number(s.data(), s.data() + s.size(), x); }
+
+// What looks like a number, as Perl's looks_like_number decides
+bool test_1 () {
+  const char *yes[] = { "1", "1.", ".5", "+1", "-1e5", "+.5e-3", "inf", "Infinity", "-INF", "nan", "NaN", "nanq", "007" };
+  const char *no[] = { ".", "1e", "1e+", "0x10", "1_000", "1.5.5", "infinit", "-", "+", "", "e5", "1,5" };
+  double x;
+  for (const char *s : yes) if (! parses(s, x)) return false;
+  for (const char *s : no) if (parses(s, x)) return false;
+  return parses("-1e5", x) && x == -1e5 && parses("+.5e-3", x) && x == 0.5e-3
+    && parses("-INF", x) && x == -HUGE_VAL && parses("1.", x) && x == 1;
+}
+
+// Conversion agrees with strtod, on the fast path and off it
+bool test_2 () {
+  std::mt19937_64 generator(1);
+  std::uniform_real_distribution<double> mant(-10, 10);
+  std::uniform_int_distribution<int> ex(-320, 300);
+  char s[64];
+  for(int i=0; i < 200000; ++i) {
+    const double v = mant(generator) * pow(10, ex(generator) % (i % 2 ? 25 : 320));
+    snprintf(s, sizeof(s), i % 3 ? "%.17g" : "%.6g", v);
+    double x;
+    if (! parses(s, x) || x != strtod(s, nullptr)) return false;
+  }
+  double x;
+  return parses("12345678901234567890123", x) && x == strtod("12345678901234567890123", nullptr)
+    && parses("0.000000000000000000000000123", x) && x == 1.23e-25;
+}
+
+// Lines, as scripts/log_data_file writes them
+bool test_3 () {
+  const std::string in =
+    "# comment 10 100\n"
+    "10 100 1000\n"
+    "  1e3\t2   \n"
+    "\n"
+    "0 -1 inf\n"
+    "1.5 x 3\n"
+    "100 1e20";
+  const std::string want =
+    "# comment 10 100\n"
+    "1 2 3\n"
+    "3 0.301029995663981\n"
+    "\n"
+    "-Inf NaN Inf\n"
+    "1.5 x 3\n"
+    "2 20\n";
+  ld::LogTransform lt;
+  gjl::TextBuffer buf;
+  lt.transform(in.data(), in.data() + in.size(), buf);
+  if (buf.str() != want) return false;
+  std::vector<int> linear = { 0, 2 };
+  lt.set_linear(linear);
+  buf.clear();
+  const std::string in2 = "10 100 1e3 1e4\n# 1 2\n";
+  lt.transform(in2.data(), in2.data() + in2.size(), buf);
+  return buf.str() == "10 2 1e3 4\n# 1 2\n";
+}
+
+// Many lines, across batches
+bool test_4 () {
+  std::string in, want;
+  for(int i=1; i <= 5000; ++i) {
+    in += std::to_string(i) + " 1000\n";
+    char s[64];
+    snprintf(s, sizeof(s), "%.15g 3\n", log10((double) i));
+    want += s;
+  }
+  ld::LogTransform lt;
+  gjl::TextBuffer buf;
+  lt.transform(in.data(), in.data() + in.size(), buf);
+  return buf.str() == want;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  dotest(test_4,4);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
@@ -0,0 +1,77 @@
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include "gjl/log_space.h"
+#include "gjl/arr_irreg.h"
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+// The table holds exactly the values computed with pow, in and out of range
+bool test_1 () {
+  const double xs[][2] = { {1, 1e6}, {100, 5000}, {0.5, 1e9}, {3, 3.5} };
+  const size_t ns[] = { 2, 30, 300, 1001 };
+  for (auto& x : xs)
+    for (size_t n : ns)
+      for (int lowest : { 0, 5 }) {
+        gjl::LogSpace<> s(x[0], x[1], n);
+        s.set_lowest_index_fixed_n(lowest);
+        for(int i = lowest - 3; i < lowest + (int) n + 3; ++i)
+          if (s[i] != s.compute_val(i) || s[i] != x[0] * pow(s.fac(), i - lowest)) return false;
+      }
+  gjl::LogSpace<float> f(1, 1e4, 50);
+  for(int i=0; i < 50; ++i)
+    if (f[i] != f.compute_val(i)) return false;
+  return true;
+}
+
+// next_threshold follows get_next_time and is infinite once full
+bool test_2 () {
+  ArrIrreg<> arr(1, 100, 10);
+  if (arr.next_threshold() != arr.get_next_time() || arr.next_threshold() != 1) return false;
+  for(int i=0; i < 10; ++i) {
+    if (arr.next_threshold() != arr.get_time(i)) return false;
+    arr.record_arr(i);
+  }
+  if (! std::isinf(arr.next_threshold()) || ! arr.over_max_ind()) return false;
+  arr.reset_index();
+  return arr.next_threshold() == 1 && arr.counts(9) == 1;
+}
+
+// ARR_IRREG_CHECK_RECORD records at the same steps as before
+bool test_3 () {
+  ArrIrreg<> arr(1, 1000, 37);
+  std::vector<int> want(37, 0);
+  for(int pass=0; pass < 2; ++pass) {
+    arr.reset_index();
+    size_t k = 0;
+    for(int step=1; step <= 2000; ++step) {
+      ARR_IRREG_CHECK_RECORD(arr, step, step);
+      while (k < 37 && step + 1e-10 >= arr.time()[k]) want[k++] += step;
+    }
+  }
+  for(int i=0; i < 37; ++i)
+    if (arr.arrsum(i) != want[i] || arr.counts(i) != 2) return false;
+  return true;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
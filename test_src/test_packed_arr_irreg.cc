@@ -0,0 +1,121 @@
+#include <random>
+#include <vector>
+#include <iostream>
+#include "gjl/arr_irreg.h"
+#include "gjl/packed_arr_irreg.h"
+
+typedef PackedArrIrreg<> packed_t;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+// Walks with random step times. times and values are walker after walker.
+void make_walks (size_t n_walkers, size_t n_steps, unsigned seed, std::vector<double>& times, std::vector<double>& values) {
+  std::mt19937_64 generator(seed);
+  std::exponential_distribution<double> dt(1.0);
+  std::uniform_int_distribution<int> step(0, 1);
+  times.resize(n_walkers * n_steps);
+  values.resize(n_walkers * n_steps);
+  for(size_t w=0; w < n_walkers; ++w) {
+    double t = 0, x = 0;
+    for(size_t i=0; i < n_steps; ++i) {
+      t += dt(generator);
+      x += step(generator) ? 1 : -1;
+      times[w * n_steps + i] = t;
+      values[w * n_steps + i] = x * x;
+    }
+  }
+}
+
+bool same (const packed_t& p, const ArrIrreg<>& a) {
+  for(int i=0; i < a.number_of_elements(); ++i)
+    if (p.arrsum(i) != a.arrsum_data()[i] || p.counts(i) != a.counts_data()[i]) return false;
+  return true;
+}
+
+// record_stream, record_arr and ArrIrreg with the macro record the same
+bool test_1 () {
+  const size_t n_walkers = 50, n_steps = 3000;
+  std::vector<double> t, v;
+  make_walks(n_walkers, n_steps, 1, t, v);
+  ArrIrreg<> a(1, 2000, 40);
+  packed_t p(1, 2000, 40), q(1, 2000, 40);
+  for(size_t w=0; w < n_walkers; ++w) {
+    a.reset_index();
+    q.reset_index();
+    for(size_t i=0; i < n_steps; ++i) {
+      ARR_IRREG_CHECK_RECORD(a, t[w * n_steps + i], v[w * n_steps + i]);
+      ARR_IRREG_CHECK_RECORD(q, t[w * n_steps + i], v[w * n_steps + i]);
+    }
+    p.record_stream(t.begin() + w * n_steps, t.begin() + (w + 1) * n_steps, v.begin() + w * n_steps);
+  }
+  ArrIrreg<> b;
+  p.to_arr_irreg(b);
+  return same(p, a) && same(q, a) && b.counts(0) == n_walkers && b.arrsum(7) == a.arrsum(7)
+    && p.get_arr(10) == a.get_arr(10);
+}
+
+// Parallel record_streams and merge_tree agree with serial
+bool test_2 () {
+  const size_t n_walkers = 301, n_steps = 500;
+  std::vector<double> t, v;
+  make_walks(n_walkers, n_steps, 2, t, v);
+  packed_t serial(1, 400, 25);
+  serial.record_streams(t.data(), v.data(), n_walkers, n_steps, 1);
+  for(int n_threads = 2; n_threads <= 5; ++n_threads) {
+    packed_t par(1, 400, 25);
+    par.record_streams(t.data(), v.data(), n_walkers, n_steps, n_threads);
+    for(int i=0; i < 25; ++i)
+      if (par.counts(i) != serial.counts(i) || std::abs(par.arrsum(i) - serial.arrsum(i)) > 1e-9 * serial.arrsum(i))
+        return false;
+  }
+  for(size_t n_parts : { 1, 2, 7, 16 }) {
+    std::vector<packed_t> parts(n_parts, packed_t(1, 400, 25));
+    for(size_t w=0; w < n_walkers; ++w)
+      parts[w % n_parts].record_stream(t.begin() + w * n_steps, t.begin() + (w + 1) * n_steps, v.begin() + w * n_steps);
+    packed_t::merge_tree(parts, 3);
+    for(int i=0; i < 25; ++i)
+      if (parts[0].counts(i) != serial.counts(i)
+          || std::abs(parts[0].arrsum(i) - serial.arrsum(i)) > 1e-9 * serial.arrsum(i))
+        return false;
+  }
+  return serial.counts(0) == n_walkers;
+}
+
+// ArrIrreg merge, and merging an ArrIrreg into a packed one
+bool test_3 () {
+  ArrIrreg<> a(1, 100, 5), b(1, 100, 5);
+  packed_t p(1, 100, 5);
+  for(int i=0; i < 5; ++i) {
+    a.arrsum(i) = i;
+    a.counts(i) = 1;
+    b.arrsum(i) = 10 * i;
+    b.counts(i) = 2;
+  }
+  const ArrIrreg<>& cb = b;
+  a.merge(cb);
+  p.merge_arr_irreg(a);
+  p.merge_arr_irreg(a);
+  return a.arrsum(3) == 33 && a.counts(4) == 3 && p.arrsum(3) == 66 && p.counts(4) == 6;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
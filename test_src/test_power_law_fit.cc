@@ -0,0 +1,117 @@
+#include <random>
+#include <sstream>
+#include <iostream>
+#include "gjl/power_law_fit.h"
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+// An exact power law in an ArrIrreg, with a different one outside the window
+bool test_1 () {
+  ArrIrreg<> arr(1, 1e6, 61);
+  for(int i=0; i < arr.number_of_elements(); ++i) {
+    const double t = arr.get_time(i);
+    const double v = t < 1e2 ? 7 : 3 * pow(t, -1.5);
+    arr.arrsum(i) = 4 * v;
+    arr.counts(i) = 4;
+  }
+  arr.counts(arr.number_of_elements() - 1) = 0;  // not recorded, skipped
+  gjl::PowerLawFit<> plf;
+  const size_t n = plf.fit(arr, 1e2, 1e7);
+  std::ostringstream out;
+  plf.report(out);
+  return n == 40 && plf.n() == 40 && std::abs(plf.exponent() + 1.5) < 1e-12
+    && std::abs(plf.amplitude() / 3 - 1) < 1e-10 && plf.exponent_error() < 1e-12
+    && out.str().find("Power law fit to 40 points") == 0;
+}
+
+// Weights come from the counts
+bool test_2 () {
+  ArrIrreg<> arr(1, 1000, 4);
+  const double vals[] = { 1, 10, 100, 1000 };
+  const size_t counts[] = { 1, 1, 1000, 1000 };
+  for(int i=0; i < 4; ++i) {
+    arr.arrsum(i) = vals[i] * counts[i] * (i == 0 ? 10 : 1);
+    arr.counts(i) = counts[i];
+  }
+  gjl::PowerLawFit<> w, u;
+  w.fit(arr, 0, 1e4);
+  u.fit(arr, 0, 1e4, false);
+  return std::abs(w.exponent() - 1) < std::abs(u.exponent() - 1) && w.n() == 4 && u.n() == 4;
+}
+
+// The tail of a Pareto distribution in a log-binned HistPdf, pdf ~ x^-(alpha+1)
+bool test_3 () {
+  const double alpha = 1.5;
+  std::mt19937_64 generator(1);
+  std::uniform_real_distribution<double> u(0, 1);
+  std::vector<double> v(1000000);
+  for(double& x : v) x = pow(1 - u(generator), -1 / alpha);
+  gjl::HistPdf<> h(60, 1, 1e4, true);
+  h.add_counts(v.begin(), v.end());
+  gjl::PowerLawFit<> plf;
+  plf.fit(h, 2, 1e3);
+  return std::abs(plf.exponent() + alpha + 1) < 4 * plf.exponent_error()
+    && plf.exponent_error() < 0.02 && std::abs(plf.amplitude() / alpha - 1) < 0.05;
+}
+
+// With sums of squares, points are weighted by their error bars
+bool test_4 () {
+  ArrIrreg<> arr(1, 1e4, 5);
+  arr.keep_sum_squares();
+  const double vals[] = { 1, 10, 100, 3000, 1e4 };
+  const double rel_err[] = { 0.01, 0.01, 0.01, 1, 0 };  // the last has no spread, skipped
+  const size_t c = 10;
+  for(int i=0; i < 5; ++i) {
+    const double var = pow(vals[i] * rel_err[i], 2) * c;  // stderr is vals * rel_err
+    arr.arrsum(i) = vals[i] * c;
+    arr.counts(i) = c;
+    arr.arrsum2(i) = (c - 1) * var + vals[i] * vals[i] * c;
+  }
+  gjl::PowerLawFit<> w, u;
+  w.fit(arr, 0, 1e5);
+  u.fit(arr, 0, 1e5, false);
+  return std::abs(arr.get_stderr(3) / 3000 - 1) < 1e-12 && w.n() == 4 && u.n() == 5
+    && std::abs(w.exponent() - 1) < 0.01 && std::abs(u.exponent() - 1) > 0.03;
+}
+
+// A weighted HistPdf is fit to its weighted pdf, whatever the size of the weights
+bool test_5 () {
+  const double alpha = 1.5;
+  std::mt19937_64 generator(5);
+  std::uniform_real_distribution<double> u(0, 1);
+  gjl::HistPdf<> h(60, 1, 1e4, true), w(60, 1, 1e4, true);
+  for(size_t i=0; i < 1000000; ++i) {
+    const double x = pow(1 - u(generator), -1 / alpha);
+    h.add_count(x);
+    w.add_weighted_count(x, 3.5);
+  }
+  gjl::PowerLawFit<> ph, pw;
+  ph.fit(h, 2, 1e3);
+  pw.fit(w, 2, 1e3);
+  return std::abs(pw.amplitude() / ph.amplitude() - 1) < 1e-10
+    && std::abs(pw.exponent() - ph.exponent()) < 1e-10 && pw.n() == ph.n();
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  dotest(test_4,4);
+  dotest(test_5,5);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
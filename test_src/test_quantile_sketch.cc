@@ -0,0 +1,111 @@
+#include <random>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include "gjl/quantile_sketch.h"
+
+typedef gjl::QuantileSketch<> sketch_t;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+std::vector<double> sample_data (size_t n, unsigned seed) {
+  std::mt19937_64 generator(seed);
+  std::exponential_distribution<double> distribution(1.0);
+  std::vector<double> v(n);
+  for(size_t i=0; i < n; ++i) v[i] = distribution(generator);
+  return v;
+}
+
+// Largest error in rank of the estimated quantiles, as a fraction of N
+double max_rank_error (const sketch_t& s, std::vector<double> v) {
+  std::sort(v.begin(), v.end());
+  double worst = 0;
+  for(double q = 0.001; q < 1; q += 0.001) {
+    const double x = s.quantile(q);
+    const double r = (double) (std::upper_bound(v.begin(), v.end(), x) - v.begin()) / v.size();
+    worst = std::max(worst, std::abs(r - q));
+  }
+  return worst;
+}
+
+// Quantiles are within the rank error, min and max are exact, memory is bounded
+bool test_1 () {
+  auto v = sample_data(1000000, 1);
+  sketch_t s;
+  s.record(v.begin(), v.end());
+  const double err = max_rank_error(s, v);
+  return err < 0.01 && s.N() == v.size() && s.size() < 3 * s.k() + 100
+    && s.min() == *std::min_element(v.begin(), v.end())
+    && s.max() == *std::max_element(v.begin(), v.end())
+    && s.quantile(0) == s.min() && s.quantile(1) == s.max()
+    && std::abs(s.rank(s.quantile(0.5)) - 0.5) < 0.01;
+}
+
+// Small streams are exact
+bool test_2 () {
+  sketch_t s;
+  for(int i=100; i >= 1; --i) s.record(i);
+  return s.quantile(0.5) == 50 && s.quantile(0.01) == 1 && s.quantile(0.995) == 100
+    && s.rank(25) == 0.25;
+}
+
+// Merging pieces is about as accurate as one sketch of everything
+bool test_3 () {
+  auto v = sample_data(400000, 2);
+  sketch_t all, part;
+  for(int p=0; p < 8; ++p) {
+    sketch_t s;
+    s.record(v.begin() + p * 50000, v.begin() + (p + 1) * 50000);
+    all.merge(s);
+  }
+  part += sketch_t();
+  return all.N() == v.size() && max_rank_error(all, v) < 0.01
+    && all.size() < 3 * all.k() + 100 && part.N() == 0;
+}
+
+// Serialize round trip, and rejection of bad data
+bool test_4 () {
+  auto v = sample_data(100000, 3);
+  sketch_t s(64);
+  s.record(v.begin(), v.end());
+  std::string buf;
+  s.serialize(buf);
+  sketch_t t;
+  if (! t.deserialize(buf)) return false;
+  if (t.k() != 64 || t.N() != s.N() || t.size() != s.size() || t.min() != s.min()) return false;
+  for(double q = 0.01; q < 1; q += 0.01)
+    if (t.quantile(q) != s.quantile(q)) return false;
+  // Both continue identically
+  s.record(v.begin(), v.begin() + 10000);
+  t.record(v.begin(), v.begin() + 10000);
+  std::string b1, b2;
+  s.serialize(b1);
+  t.serialize(b2);
+  sketch_t u;
+  return b1 == b2 && buf.size() < 8 * (t.size() + 32)
+    && ! u.deserialize(buf.substr(0, buf.size() - 1), true) && ! u.deserialize("GJLKLL0", true)
+    && u.N() == 0;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  dotest(test_4,4);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
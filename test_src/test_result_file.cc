@@ -0,0 +1,191 @@
+#include <random>
+#include <cstdio>
+#include <unistd.h>
+#include "gjl/hist_pdf.h"
+#include "gjl/arr_irreg.h"
+#include "gjl/result_file.h"
+
+typedef gjl::HistPdf<> hist_t;
+namespace rf = gjl::result_file;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+std::string tmp_name (const char *stem) {
+  return std::string("/tmp/") + stem + "." + std::to_string(getpid()) + ".gjlr";
+}
+
+std::vector<double> sample_data (size_t n, double lo, double hi, unsigned seed) {
+  std::mt19937_64 generator(seed);
+  std::uniform_real_distribution<double> distribution(lo,hi);
+  std::vector<double> v(n);
+  for(size_t i=0; i < n; ++i) v[i] = distribution(generator);
+  return v;
+}
+
+bool same_hists (const hist_t& a, const hist_t& b) {
+  return ( a == b && a.n_counts() == b.n_counts()
+           && a.n_greater_than_max() == b.n_greater_than_max()
+           && a.n_less_than_min() == b.n_less_than_min()
+           && a.data_min() == b.data_min() && a.data_max() == b.data_max()
+           && a.num_trials() == b.num_trials()
+           && a.num_merged_hists() == b.num_merged_hists() );
+}
+
+// write and read back linear, log and custom histograms
+bool test_1 () {
+  std::vector<hist_t> hs;
+  hs.push_back(hist_t(100,0,10));
+  hs.push_back(hist_t(100,0.1,1e3,true));
+  hs.push_back(hist_t(std::vector<double>{0, 0.5, 2, 3, 7}));
+  hs[1].set_hist_name("log hist");
+  auto fname = tmp_name("test_result_file_1");
+  bool ok = true;
+  for(size_t i=0; i < hs.size(); ++i) {
+    auto v = sample_data(1000, -1, 12, i);
+    hs[i].add_counts(v.begin(), v.end());
+    hs[i].increment_num_trials();
+    hist_t b;
+    ok = ok && rf::write(hs[i], fname) && rf::read(fname, b) && same_hists(hs[i], b)
+      && b.hist_name() == hs[i].hist_name() && b.using_log() == hs[i].using_log();
+  }
+  remove(fname.c_str());
+  return ok;
+}
+
+// merging mapped files is the same as merging in memory
+bool test_2 () {
+  auto fname = tmp_name("test_result_file_2");
+  hist_t total(50,0.1,1e3,true);
+  hist_t from_files(50,0.1,1e3,true);
+  for(unsigned i=0; i < 4; ++i) {
+    hist_t h(50,0.1,1e3,true);
+    auto v = sample_data(1000, 0, 2000, i);
+    h.add_counts(v.begin(), v.end());
+    h.increment_num_trials();
+    total.merge(h);
+    if (! rf::write(h, fname)) return false;
+    rf::MappedResult m(fname);
+    if (! (m.is_open() && rf::merge(m, from_files))) return false;
+  }
+  remove(fname.c_str());
+  return same_hists(total, from_files);
+}
+
+// shape mismatches and bad files are refused
+bool test_3 () {
+  auto fname = tmp_name("test_result_file_3");
+  hist_t a(50,0,10);
+  hist_t b(51,0,10);
+  hist_t c(50,0,10,true);
+  if (! rf::write(a, fname)) return false;
+  rf::MappedResult m(fname);
+  bool ok = m.is_open() && rf::is_same_shape(m, a) && ! rf::is_same_shape(m, b, true)
+    && ! rf::is_same_shape(m, c, true);
+  FILE *fp = fopen(fname.c_str(), "w");
+  fputs("1 2 3\n", fp);
+  fclose(fp);
+  rf::MappedResult bad;
+  bad.open(fname, true);
+  remove(fname.c_str());
+  return ok && ! bad.is_open() && bad.error() == "too short to be a result file";
+}
+
+// ArrIrreg round trip and merge
+bool test_4 () {
+  auto fname = tmp_name("test_result_file_4");
+  ArrIrreg<> a(1,1000,30);
+  ArrIrreg<> b(1,1000,30);
+  for(int i=0; i < 30; ++i) {
+    a.record_arr(i * 0.5);
+    b.arrsum(i) = i;
+    b.counts(i) = 2;
+  }
+  if (! rf::write(a, fname)) return false;
+  ArrIrreg<> c;
+  if (! rf::read(fname, c)) return false;
+  rf::MappedResult m(fname);
+  b.merge(a);
+  if (! rf::merge(m, c) || ! rf::merge(m, a)) return false;
+  remove(fname.c_str());
+  for(int i=0; i < 30; ++i)
+    if (c.arrsum(i) != a.arrsum(i) || c.counts(i) != 2 || a.counts(i) != 2
+        || b.arrsum(i) != i * 1.5 || c.get_time(i) != a.get_time(i))
+      return false;
+  return c.number_of_elements() == 30;
+}
+
+// ArrIrreg with sums of squares
+bool test_5 () {
+  auto fname = tmp_name("test_result_file_5");
+  auto fname2 = tmp_name("test_result_file_5b");
+  ArrIrreg<> a(1,1000,7), plain(1,1000,7);
+  a.keep_sum_squares();
+  for(int j=0; j < 3; ++j) {
+    a.reset_index();
+    for(int i=0; i < 7; ++i) a.record_arr(i + j);
+  }
+  if (! rf::write(a, fname) || ! rf::write(plain, fname2)) return false;
+  ArrIrreg<> c;
+  if (! rf::read(fname, c)) return false;
+  rf::MappedResult m(fname), m2(fname2);
+  const bool merged = rf::merge(m, c);
+  const bool refused = ! rf::is_same_shape(m2, c, true);
+  remove(fname.c_str());
+  remove(fname2.c_str());
+  if (! merged || ! refused || ! c.has_sum_squares()) return false;
+  for(int i=0; i < 7; ++i)
+    if (c.arrsum2(i) != 2 * a.arrsum2(i) || c.counts(i) != 6 || c.get_variance(i) != 0.8)
+      return false;
+  return true;
+}
+
+// Weighted histograms keep their sums of squared weights, through read and merge
+bool test_6 () {
+  auto fname = tmp_name("test_result_file_6");
+  hist_t h(20,0,10), plain(20,0,10);
+  auto v = sample_data(1000, 0, 10, 6);
+  for(size_t i=0; i < v.size(); ++i) h.add_weighted_count(v[i], 0.5 + (i % 4));
+  plain.add_counts(v.begin(), v.end());
+  hist_t b;
+  if (! rf::write(h, fname) || ! rf::read(fname, b)) return false;
+  rf::MappedResult m(fname);
+  const bool merged = rf::merge(m, b);
+  const bool weights_in_file = (m.header().flags & rf::sum_weights_squared_flag) != 0;
+  m.close();
+  hist_t c;
+  const bool plain_ok = rf::write(plain, fname) && rf::read(fname, c) && ! c.has_weights();
+  remove(fname.c_str());
+  if (! merged || ! weights_in_file || ! plain_ok || ! b.has_weights()) return false;
+  for(size_t i=0; i < h.n_bins(); ++i) {
+    const double e = h.weighted_pdf_error(i);
+    if (b.sum_weights_squared(i) != 2 * h.sum_weights_squared(i) || e == 0
+        || std::abs(b.weighted_pdf_error(i) * std::sqrt(2.0) - e) > 1e-12 * e)
+      return false;
+  }
+  return true;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  dotest(test_4,4);
+  dotest(test_5,5);
+  dotest(test_6,6);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
@@ -0,0 +1,105 @@
+#include <random>
+#include <vector>
+#include <iostream>
+#include "gjl/simp_stat.h"
+
+typedef gjl::SimpStat<> stat_t;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+bool close (double a, double b, double tol) { return std::abs(a - b) <= tol * std::abs(b); }
+
+std::vector<double> sample_data (size_t n, double offset, unsigned seed) {
+  std::mt19937_64 generator(seed);
+  std::exponential_distribution<double> distribution(1.0);
+  std::vector<double> v(n);
+  for(size_t i=0; i < n; ++i) v[i] = offset + distribution(generator);
+  return v;
+}
+
+// Exact moments, by two passes in long double
+void exact_moments (const std::vector<double>& v, double& mean, double& var, double& skew, double& kurt) {
+  long double s = 0;
+  for(double x : v) s += x;
+  const long double m = s / v.size();
+  long double s2 = 0, s3 = 0, s4 = 0;
+  for(double x : v) {
+    const long double d = x - m;
+    s2 += d * d;
+    s3 += d * d * d;
+    s4 += d * d * d * d;
+  }
+  const long double n = v.size();
+  mean = m;
+  var = s2 / n;
+  skew = sqrtl(n) * s3 / powl(s2, 1.5);
+  kurt = n * s4 / (s2 * s2) - 3;
+}
+
+// A large mean does not spoil the variance
+bool test_1 () {
+  auto v = sample_data(1000000, 1e9, 1);
+  stat_t s;
+  for(double x : v) s.record(x);
+  double mean, var, skew, kurt;
+  exact_moments(v, mean, var, skew, kurt);
+  return s.N() == v.size() && close(s.mean(), mean, 1e-13) && close(s.variance(), var, 1e-6)
+    && close(s.sample_variance(), var * v.size() / (v.size() - 1), 1e-6)
+    && close(s.skewness(), skew, 1e-3) && close(s.kurtosis(), kurt, 1e-3);
+}
+
+// The batched record and merge agree with recording one at a time
+bool test_2 () {
+  auto v = sample_data(100003, 50, 2);
+  stat_t a, b, c;
+  for(double x : v) a.record(x);
+  b.record(v.begin(), v.end());
+  for(int p=0; p < 7; ++p) {
+    stat_t part;
+    const size_t lo = p * v.size() / 7, hi = (p + 1) * v.size() / 7;
+    for(size_t i=lo; i < hi; ++i) part.record(v[i]);
+    c += part;
+  }
+  c.merge(stat_t());
+  return b.N() == a.N() && c.N() == a.N()
+    && close(b.mean(), a.mean(), 1e-13) && close(c.mean(), a.mean(), 1e-13)
+    && close(b.variance(), a.variance(), 1e-12) && close(c.variance(), a.variance(), 1e-12)
+    && close(b.skewness(), a.skewness(), 1e-10) && close(c.skewness(), a.skewness(), 1e-10)
+    && close(b.kurtosis(), a.kurtosis(), 1e-10) && close(c.kurtosis(), a.kurtosis(), 1e-10);
+}
+
+// Small exact case, and the moments of the exponential distribution
+bool test_3 () {
+  stat_t s;
+  const double xs[] = { 2, 4, 4, 4, 5, 5, 7, 9 };
+  s.record(xs, xs + 8);
+  auto v = sample_data(4000000, 0, 3);
+  stat_t e;
+  e.record(v.begin(), v.end());
+  s.clear();
+  s.record(xs, xs + 8);
+  return s.mean() == 5 && s.variance() == 4 && s.std_dev() == 2 && s.error() == sqrt(0.5)
+    && std::abs(e.skewness() - 2) < 0.05 && std::abs(e.kurtosis() - 6) < 0.5;
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
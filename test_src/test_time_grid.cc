@@ -0,0 +1,107 @@
+#include <random>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include "gjl/log_space.h"
+#include "gjl/time_grid.h"
+#include "gjl/arr_irreg.h"
+
+typedef gjl::TimeGrid<> grid_t;
+typedef ArrIrreg<double, grid_t> grid_arr_t;
+
+static size_t n_fail = 0;
+static size_t n_tests = 0;
+
+void fail_msg(int c) {
+  std::cerr << "*** test " << c << " failed.\n";
+}
+
+template <typename T>
+void dotest(T func, int c) {
+  if( ! func() ) {
+    ++n_fail;
+    fail_msg(c);
+  }
+  ++ n_tests;
+}
+
+// Linear then log pieces, and set_xa_xb_n is LogSpace value for value
+bool test_1 () {
+  grid_t g;
+  g.append_linear(1, 10, 10);
+  g.append_log(10, 1e4, 31);
+  if (g.number_of_elements() != 40 || g[0] != 1 || g[9] != 10 || g.xa() != 1
+      || std::abs(g.xb() / 1e4 - 1) > 1e-12 || ! std::isinf(g[40]) || g.highest_index() != 39)
+    return false;
+  for(int i=1; i < 40; ++i)
+    if (! (g[i] > g[i-1])) return false;
+  for(size_t n : { 2, 30, 300 }) {
+    gjl::LogSpace<> s(3, 2e5, n);
+    grid_t t(3, 2e5, n);
+    if (t.number_of_elements() != n) return false;
+    for(int i=0; i < (int) n; ++i)
+      if (t[i] != s[i]) return false;
+  }
+  grid_t u(std::vector<double>{ 0.5, 2, 7 });
+  return u.number_of_elements() == 3 && u[2] == 7;
+}
+
+// ARR_IRREG_CHECK_RECORD on a mixed grid records at the first step at or after each time
+bool test_2 () {
+  grid_t g;
+  g.append_linear(1, 20, 20);
+  g.append_log(20, 5000, 25);
+  grid_arr_t arr(g), other(g);
+  std::mt19937_64 generator(1);
+  std::exponential_distribution<double> dt(0.7);
+  const int n = g.number_of_elements();
+  std::vector<double> want(n, 0);
+  for(int w=0; w < 20; ++w) {
+    grid_arr_t& a = w % 2 ? arr : other;
+    a.reset_index();
+    double t = 0;
+    int k = 0;
+    for(int step=0; step < 8000; ++step) {
+      t += dt(generator);
+      ARR_IRREG_CHECK_RECORD(a, t, t * 3);
+      while (k < n && t + 1e-10 >= g[k]) want[k++] += t * 3;
+    }
+  }
+  arr.merge(other);
+  for(int i=0; i < n; ++i)
+    if (std::abs(arr.arrsum(i) - want[i]) > 1e-9 * want[i] || arr.counts(i) != 20) return false;
+  return true;
+}
+
+// With the same times, merge and printing match the LogSpace version
+bool test_3 () {
+  ArrIrreg<> a(1, 1000, 20), b(1, 1000, 20);
+  grid_arr_t c(grid_t(1, 1000, 20)), d;
+  d.set_xa_xb_n(1, 1000, 20);
+  for(int step=1; step <= 1200; ++step) {
+    ARR_IRREG_CHECK_RECORD(a, step, step * 0.5);
+    ARR_IRREG_CHECK_RECORD(c, step, step * 0.5);
+    ARR_IRREG_CHECK_RECORD(b, step / 2.0, step);
+    ARR_IRREG_CHECK_RECORD(d, step / 2.0, step);
+  }
+  a.merge(b);
+  c.merge(d);
+  std::ostringstream oa, oc;
+  a.print_arr_with_counts(oa);
+  a.print_log_arr(oa);
+  c.print_arr_with_counts(oc);
+  c.print_log_arr(oc);
+  // b and d stop at time 600, so the counts are full only up to there
+  return oa.str() == oc.str() && a.max_time_with_full_counts() == c.max_time_with_full_counts()
+    && c.max_time_with_full_counts() < 600 && ! c.are_all_count_numbers_same()
+    && a.highest_index() == c.highest_index();
+}
+
+int main () {
+  dotest(test_1,1);
+  dotest(test_2,2);
+  dotest(test_3,3);
+  std::cout << n_fail << "/" << n_tests << " tests failed.\n";
+  return n_fail > 0;
+}
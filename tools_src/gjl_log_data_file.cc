@@ -0,0 +1,191 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "gjl/text_buffer.h"
+#include "gjl/log_data.h"
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+ * gjl_log_data_file -- take log10 of the numbers in data files. The same
+ * as scripts/log_data_file, but much faster.
+ *
+ *   gjl_log_data_file < linearfile.dat > logfile.dat
+ *   gjl_log_data_file [-j nthreads] [--linear n1 n2 ...] path1/infile1 path2/infile2 ...
+ *
+ * Lines of numbers are written as the log10 of each number. Other lines,
+ * such as comments, are copied. Columns given to --linear, numbered
+ * from 1, are copied as read. Each input file path/name is written to
+ * path/log_name, and the name of the output file is printed.
+ *
+ * Input files are read through mmap, and stdin in fixed chunks, output
+ * is formatted into a large buffer and written in big pieces, and files
+ * are done in parallel, one per thread.
+ */
+
+const size_t chunk_size = 16 << 20;
+
+void usage () {
+  std::cerr << "usage: gjl_log_data_file [-j nthreads] [--linear n1 [n2 ...]] [infile1 ...]\n";
+  exit(2);
+}
+
+// As File::Basename::fileparse, a name with no directory gets the path "./"
+std::string make_output_fname (const std::string& infname) {
+  const size_t slash = infname.rfind('/');
+  if (slash == std::string::npos) return "./log_" + infname;
+  return infname.substr(0, slash + 1) + "log_" + infname.substr(slash + 1);
+}
+
+// Transform [b,e) in chunks that end at a newline, writing each to fd
+bool transform_to_fd (const char *b, const char *e, gjl::log_data::LogTransform& lt, gjl::TextBuffer& buf, int fd) {
+  while (b < e) {
+    const char *ce = e;
+    if (e - b > (ptrdiff_t) chunk_size) {
+      // A line longer than a chunk is done whole
+      const char *nl = (const char *) memrchr(b, '\n', chunk_size);
+      if (nl) ce = nl + 1;
+    }
+    buf.clear();
+    lt.transform(b, ce, buf);
+    if (! buf.write(fd)) return false;
+    b = ce;
+  }
+  return true;
+}
+
+bool process_file (const std::string& infname, const std::vector<int>& linear) {
+  const std::string outfname = make_output_fname(infname);
+  int fd = open(infname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "*** gjl_log_data_file: can't open '" << infname << "' for reading.\n";
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    std::cerr << "*** gjl_log_data_file: " << infname << ": " << strerror(errno) << "\n";
+    return false;
+  }
+  const char *data = nullptr;
+  if (st.st_size > 0) {
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      std::cerr << "*** gjl_log_data_file: " << infname << ": " << strerror(errno) << "\n";
+      return false;
+    }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    data = (const char *) p;
+  }
+  close(fd);
+  bool ok = true;
+  int ofd = open(outfname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (ofd < 0) {
+    std::cerr << "*** gjl_log_data_file: can't open '" << outfname << "' for writing.\n";
+    ok = false;
+  }
+  else {
+    gjl::log_data::LogTransform lt;
+    lt.set_linear(linear);
+    gjl::TextBuffer buf(chunk_size + chunk_size / 2);
+    ok = transform_to_fd(data, data + st.st_size, lt, buf, ofd);
+    if (close(ofd) != 0 || ! ok) {
+      std::cerr << "*** gjl_log_data_file: error writing '" << outfname << "'.\n";
+      ok = false;
+    }
+  }
+  if (data) munmap((void *) data, st.st_size);
+  return ok;
+}
+
+/*
+  Fill a chunk from stdin, transform it up to its last newline, and carry
+  the partial line over to the next chunk. A line longer than a chunk
+  doubles the chunk.
+*/
+bool process_stdin (const std::vector<int>& linear) {
+  gjl::log_data::LogTransform lt;
+  lt.set_linear(linear);
+  gjl::TextBuffer buf(chunk_size + chunk_size / 2);
+  std::vector<char> in(chunk_size);
+  size_t n = 0;
+  bool at_end = false;
+  while (! at_end) {
+    while (n < in.size()) {
+      ssize_t r = read(0, in.data() + n, in.size() - n);
+      if (r < 0) {
+        if (errno == EINTR) continue;
+        std::cerr << "*** gjl_log_data_file: error reading stdin: " << strerror(errno) << "\n";
+        return false;
+      }
+      if (r == 0) {
+        at_end = true;
+        break;
+      }
+      n += r;
+    }
+    size_t done = n;
+    if (! at_end) {
+      const char *nl = (const char *) memrchr(in.data(), '\n', n);
+      if (! nl) {
+        in.resize(2 * in.size());
+        continue;
+      }
+      done = nl + 1 - in.data();
+    }
+    buf.clear();
+    lt.transform(in.data(), in.data() + done, buf);
+    if (! buf.write(1)) return false;
+    memmove(in.data(), in.data() + done, n - done);
+    n -= done;
+  }
+  return true;
+}
+
+int main (int argc, char *argv[]) {
+  std::vector<std::string> infiles;
+  std::vector<int> linear;
+  int n_threads = 0;
+  for(int i=1; i < argc; ++i) {
+    if (strcmp(argv[i], "--linear") == 0) {
+      char *end;
+      size_t n_cols = 0;
+      for(; i + 1 < argc; ++i, ++n_cols) {
+        const long c = strtol(argv[i+1], &end, 10);
+        if (*argv[i+1] == 0 || *end != 0) break;
+        linear.push_back(c - 1);  // to 0-based
+      }
+      if (n_cols == 0) usage();
+    }
+    else if (strcmp(argv[i], "-j") == 0) {
+      if (++i == argc) usage();
+      n_threads = atoi(argv[i]);
+    }
+    else if (argv[i][0] == '-') usage();
+    else infiles.push_back(argv[i]);
+  }
+  if (infiles.empty()) return process_stdin(linear) ? 0 : 1;
+  for(size_t i=0; i < infiles.size(); ++i)
+    std::cout << make_output_fname(infiles[i]) << "\n";
+  std::cout.flush();
+  if (n_threads > 0) omp_set_num_threads(n_threads);
+  int n_fail = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:n_fail)
+  for(size_t i=0; i < infiles.size(); ++i)
+    if (! process_file(infiles[i], linear)) ++n_fail;
+  return n_fail > 0;
+}
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "gjl/hist_pdf.h"
+#include "gjl/arr_irreg.h"
+#include "gjl/result_file.h"
+#include "gjl/hist_merger.h"
+
+/*****************************************************
+* Copyright 2014 John Lapeyre                        *
+*                                                    *
+* You can redistribute this software under the terms *
+* of the GNU General Public License version 3        *
+* or a later version.                                *
+******************************************************/
+
+/*
+ * gjl_merge_results -- merge result files
+ *
+ *   gjl_merge_results [--text] [-j nthreads] -o outfile infile1 infile2 ...
+ *
+ * The input files are histograms, as text written by HistPdf::print_pdf
+ * or in the binary format of gjl/result_file.h, or binary ArrIrreg<>
+ * results. They must all have the same shape. Histograms are merged in
+ * parallel with gjl::HistMerger. The merged result is written in the
+ * binary format, or, with --text, as print_pdf or print_arr_with_counts
+ * would write it.
+ */
+
+namespace rf = gjl::result_file;
+
+void usage () {
+  std::cerr << "usage: gjl_merge_results [--text] [-j nthreads] -o outfile infile1 [infile2 ...]\n";
+  exit(2);
+}
+
+bool open_text_out (std::ofstream& out, const std::string& outfile) {
+  out.open(outfile);
+  if (out) return true;
+  std::cerr << "*** gjl_merge_results: can't open '" << outfile << "' for writing.\n";
+  return false;
+}
+
+int merge_arrs (const std::vector<std::string>& infiles, const std::string& outfile, bool text) {
+  ArrIrreg<> total;
+  if (! rf::read(infiles[0], total)) return 1;
+  rf::MappedResult m;
+  for(size_t i=1; i < infiles.size(); ++i) {
+    if (! m.open(infiles[i])) return 1;
+    if (! rf::merge(m, total)) return 1;
+    m.close();
+  }
+  if (! text) return rf::write(total, outfile) ? 0 : 1;
+  std::ofstream out;
+  if (! open_text_out(out, outfile)) return 1;
+  if (total.has_sum_squares()) total.print_arr_with_errors(out);
+  else total.print_arr_with_counts(out);
+  return 0;
+}
+
+int merge_hists (const std::vector<std::string>& infiles, const std::string& outfile,
+                 bool text, int n_threads) {
+  gjl::HistMerger merger;
+  merger.n_threads(n_threads);
+  gjl::HistPdf<> total;
+  if (! merger.merge(infiles, total)) {
+    std::cerr << "*** gjl_merge_results: " << merger.error() << "\n";
+    return 1;
+  }
+  if (! text) return rf::write(total, outfile) ? 0 : 1;
+  std::ofstream out;
+  if (! open_text_out(out, outfile)) return 1;
+  total.print_pdf(out);
+  return 0;
+}
+
+int main (int argc, char *argv[]) {
+  std::string outfile;
+  std::vector<std::string> infiles;
+  bool text = false;
+  int n_threads = 0;
+  for(int i=1; i < argc; ++i) {
+    if (strcmp(argv[i], "--text") == 0) text = true;
+    else if (strcmp(argv[i], "-o") == 0) {
+      if (++i == argc) usage();
+      outfile = argv[i];
+    }
+    else if (strcmp(argv[i], "-j") == 0) {
+      if (++i == argc) usage();
+      n_threads = atoi(argv[i]);
+    }
+    else if (argv[i][0] == '-') usage();
+    else infiles.push_back(argv[i]);
+  }
+  if (outfile.empty() || infiles.empty()) usage();
+  if (gjl::HistMerger::is_binary_file(infiles[0])) {
+    rf::MappedResult first(infiles[0]);
+    if (! first.is_open()) return 1;
+    if (first.header().kind == rf::arr_irreg_kind) {
+      first.close();
+      return merge_arrs(infiles, outfile, text);
+    }
+  }
+  return merge_hists(infiles, outfile, text, n_threads);
+}